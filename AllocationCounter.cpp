@@ -0,0 +1,59 @@
+//! @file AllocationCounter.cpp
+//! Kept apart from other code so that the replaced allocation functions
+//! are never inlined into their callers.
+#include "Stats.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    std::atomic<bool> tracking(false);
+    std::atomic<unsigned long long> allocation_count(0);
+    std::atomic<unsigned long long> allocation_bytes(0);
+}
+
+// Replacement of the global allocation functions, so that allocations
+// can be counted. The array and nothrow forms forward to these.
+void *operator new(std::size_t size)
+{
+    if (tracking.load(std::memory_order_relaxed))
+    {
+        allocation_count.fetch_add(1, std::memory_order_relaxed);
+        allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    void *p = std::malloc(size ? size : 1);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+namespace svg
+{
+    void AllocationCounter::start()
+    {
+        allocation_count = 0;
+        allocation_bytes = 0;
+        tracking = true;
+    }
+    void AllocationCounter::stop()
+    {
+        tracking = false;
+    }
+    unsigned long long AllocationCounter::count()
+    {
+        return allocation_count;
+    }
+    unsigned long long AllocationCounter::bytes()
+    {
+        return allocation_bytes;
+    }
+}
@@ -0,0 +1,360 @@
+//! @file ElementRegistry.cpp
+#include "ElementRegistry.hpp"
+#include "Stats.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+using namespace tinyxml2;
+
+namespace svg
+{
+    namespace
+    {
+        //! Whether a character separates the parts of a transform list,
+        //! as in "translate(10, 20)" or "150,150".
+        bool separator(char c)
+        {
+            return c == ',' || c == '(' || c == ')' || std::isspace((unsigned char)c);
+        }
+
+        //! Skips separators.
+        //! @param s Position in an attribute value.
+        //! @return The first position that is not a separator.
+        const char *skip_separators(const char *s)
+        {
+            while (separator(*s))
+            {
+                s++;
+            }
+            return s;
+        }
+
+        //! Reads the next number of an attribute value.
+        //! @param s Position in the value, moved past the number.
+        //! @param v Set to the number, or left alone if there is none.
+        void next_double(const char *&s, double &v)
+        {
+            s = skip_separators(s);
+            char *end;
+            const double parsed = std::strtod(s, &end);
+            if (end != s)
+            {
+                v = parsed;
+                s = end;
+            }
+        }
+
+        //! Reads the next integer of an attribute value, stopping at any
+        //! fraction as stream extraction does.
+        //! @param s Position in the value, moved past the integer.
+        //! @param v Set to the integer, or left alone if there is none.
+        void next_int(const char *&s, int &v)
+        {
+            s = skip_separators(s);
+            char *end;
+            const long parsed = std::strtol(s, &end, 10);
+            if (end != s)
+            {
+                v = (int)std::max<long>(std::min<long>(parsed, INT_MAX), INT_MIN);
+                s = end;
+            }
+        }
+
+        //! Gets the transform-origin point.
+        //! @param attributes Attributes of the element.
+        //! @return The transform origin, or {0, 0} if it is not given.
+        FixedPoint getTransformOrigin(const ElementAttributes &attributes)
+        {
+            const char *value = attributes.get(attr::transform_origin);
+            if (value == NULL)
+            {
+                // if there is no "transform-origin" attritube function should return {0,0}
+                return {0, 0};
+            }
+            // ex: "150 150" or "150, 150", read in place
+            double torigin_x = 0, torigin_y = 0;
+            next_double(value, torigin_x);
+            next_double(value, torigin_y);
+            return FixedPoint::from_double(torigin_x, torigin_y);
+        }
+
+        //! Applies transformations to SVGElement.
+        //! @param attributes Attributes of the element.
+        //! @param elem The SVGElement to transform.
+        //! @param stats Statistics to add the transform time to (may be nullptr).
+        void applyTransform(const ElementAttributes &attributes, SVGElement *elem, RenderStats *stats)
+        {
+            const char *value = attributes.get(attr::transform);
+            if (value == NULL)
+            {
+                return;
+            }
+            std::chrono::steady_clock::time_point start;
+            if (stats != nullptr)
+            {
+                start = std::chrono::steady_clock::now();
+            }
+            Tracer *tracer = Tracer::current();
+            double trace_start = tracer != nullptr ? tracer->now_us() : 0;
+            // the operation name runs up to the first separator, and its
+            // arguments are read in place
+            const char *operation = skip_separators(value);
+            const char *s = operation;
+            while (*s != '\0' && !separator(*s))
+            {
+                s++;
+            }
+            const size_t length = s - operation;
+            auto is = [&](const char *name)
+            { return std::strlen(name) == length && std::strncmp(operation, name, length) == 0; };
+            if (is("rotate"))
+            {
+                int v = 0;
+                next_int(s, v);
+                elem->rotate(v);
+            }
+            else if (is("scale"))
+            {
+                int v = 0;
+                next_int(s, v);
+                elem->scale(v);
+            }
+            else if (is("translate"))
+            {
+                double x = 0, y = 0;
+                next_double(s, x);
+                next_double(s, y);
+                elem->translate(x, y);
+            }
+            if (tracer != nullptr)
+            {
+                tracer->phase("transform", trace_start, tracer->now_us());
+            }
+            if (stats != nullptr)
+            {
+                stats->transform_ms += std::chrono::duration<double, std::milli>(
+                                           std::chrono::steady_clock::now() - start)
+                                           .count();
+            }
+        }
+    }
+
+    static_assert(fnv1a_constant("a") == 0xe40c292cu, "fnv1a_constant follows FNV-1a");
+
+    std::uint32_t fnv1a(const char *s)
+    {
+        std::uint32_t hash = 2166136261u;
+        for (; *s != '\0'; s++)
+        {
+            hash = (hash ^ (unsigned char)*s) * 16777619u;
+        }
+        return hash;
+    }
+
+    ElementAttributes::ElementAttributes(const XMLElement *element)
+    {
+        for (const XMLAttribute *a = element->FirstAttribute(); a != nullptr; a = a->Next())
+        {
+            const Entry entry = {fnv1a(a->Name()), a->Name(), a->Value()};
+            if (count < INLINE_ENTRIES)
+            {
+                inline_entries[count] = entry;
+            }
+            else
+            {
+                more_entries.push_back(entry);
+            }
+            count++;
+        }
+    }
+
+    const ElementAttributes::Entry *ElementAttributes::find(const AttributeName &name) const
+    {
+        for (int i = 0; i < count; i++)
+        {
+            const Entry &e = i < INLINE_ENTRIES ? inline_entries[i] : more_entries[i - INLINE_ENTRIES];
+            if (e.hash == name.hash && std::strcmp(e.name, name.name) == 0)
+            {
+                return &e;
+            }
+        }
+        return nullptr;
+    }
+
+    const char *ElementAttributes::get(const AttributeName &name) const
+    {
+        const Entry *e = find(name);
+        return e != nullptr ? e->value : nullptr;
+    }
+
+    int ElementAttributes::get_int(const AttributeName &name, int default_value) const
+    {
+        int value = default_value;
+        const Entry *e = find(name);
+        if (e != nullptr)
+        {
+            XMLUtil::ToInt(e->value, &value);
+        }
+        return value;
+    }
+
+    double ElementAttributes::get_double(const AttributeName &name, double default_value) const
+    {
+        double value = default_value;
+        const Entry *e = find(name);
+        if (e != nullptr)
+        {
+            XMLUtil::ToDouble(e->value, &value);
+        }
+        return value;
+    }
+
+    bool ElementAttributes::equals(const AttributeName &name, const char *value) const
+    {
+        const Entry *e = find(name);
+        return e != nullptr && std::strcmp(e->value, value) == 0;
+    }
+
+    ElementRegistry::ElementRegistry()
+        : slots(16)
+    {
+    }
+
+    void ElementRegistry::add(const std::string &tag, ElementFactory factory)
+    {
+        if (tag.empty() || factory == nullptr)
+        {
+            throw std::runtime_error("An element needs a tag name and a factory");
+        }
+        // keep the table at most half full, so that probe runs stay short
+        if (2 * (used + 1) > slots.size())
+        {
+            std::vector<Slot> old(2 * slots.size());
+            old.swap(slots);
+            used = 0;
+            for (const Slot &slot : old)
+            {
+                if (!slot.tag.empty())
+                {
+                    add(slot.tag, slot.factory);
+                }
+            }
+        }
+        const std::uint32_t hash = fnv1a(tag.c_str());
+        for (size_t i = hash & (slots.size() - 1);; i = (i + 1) & (slots.size() - 1))
+        {
+            Slot &slot = slots[i];
+            if (slot.tag.empty())
+            {
+                slot.hash = hash;
+                slot.tag = tag;
+                slot.factory = factory;
+                used++;
+                return;
+            }
+            if (slot.hash == hash && slot.tag == tag)
+            {
+                slot.factory = factory;
+                return;
+            }
+        }
+    }
+
+    ElementFactory ElementRegistry::find(const char *tag) const
+    {
+        const std::uint32_t hash = fnv1a(tag);
+        for (size_t i = hash & (slots.size() - 1);; i = (i + 1) & (slots.size() - 1))
+        {
+            const Slot &slot = slots[i];
+            if (slot.tag.empty())
+            {
+                return nullptr;
+            }
+            if (slot.hash == hash && slot.tag == tag)
+            {
+                return slot.factory;
+            }
+        }
+    }
+
+    ElementReader::ElementReader(const ElementRegistry &registry, RenderStats *stats, LimitGuard &guard)
+        : registry(registry), stats(stats), limits(guard)
+    {
+    }
+
+    void ElementReader::read(XMLElement *xml, std::vector<SVGElement *> &elements)
+    {
+        ElementFactory factory = registry.find(xml->Name());
+        if (factory == nullptr)
+        {
+            return;
+        }
+        const ElementAttributes attributes(xml);
+        SVGElement *elem = factory(xml, attributes, getTransformOrigin(attributes), *this);
+        if (elem == nullptr)
+        {
+            return;
+        }
+        try
+        {
+            limits.add_element(elem->vertex_count());
+            // check and apply transforms
+            applyTransform(attributes, elem, stats);
+        }
+        catch (...)
+        {
+            delete elem;
+            throw;
+        }
+        // check if the element has an id and add it to elements_with_id
+        const char *id = attributes.get(attr::id);
+        if (id != NULL)
+        {
+            elem->set_id(id);
+            elements_with_id[id] = elem;
+        }
+        elements.push_back(elem);
+    }
+
+    void ElementReader::read_children(XMLElement *xml, std::vector<SVGElement *> &elements)
+    {
+        depth++;
+        limits.check_depth(depth);
+        for (XMLElement *child = xml->FirstChildElement(); child != nullptr; child = child->NextSiblingElement())
+        {
+            read(child, elements);
+        }
+        depth--;
+    }
+
+    SVGElement *ElementReader::element_with_id(const std::string &id) const
+    {
+        auto it = elements_with_id.find(id);
+        if (it == elements_with_id.end())
+        {
+            throw std::runtime_error("No element with id #" + id + " before its use");
+        }
+        return it->second;
+    }
+
+    LimitGuard &ElementReader::guard()
+    {
+        return limits;
+    }
+
+    std::shared_ptr<const Gradient> ElementReader::gradient(XMLElement *xml, const std::string &id)
+    {
+        if (gradients == nullptr)
+        {
+            gradients.reset(new GradientTable(xml->GetDocument()->RootElement()));
+        }
+        return gradients->find(id);
+    }
+}
@@ -0,0 +1,230 @@
+//! @file ElementRegistry.hpp
+#ifndef __svg_ElementRegistry_hpp__
+#define __svg_ElementRegistry_hpp__
+
+#include "Limits.hpp"
+#include "SVGElements.hpp"
+#include "external/tinyxml2/tinyxml2.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace svg
+{
+    struct RenderStats;
+
+    //! 32-bit FNV-1a hash of a string.
+    //! @param s Null-terminated string.
+    //! @return Hash value.
+    std::uint32_t fnv1a(const char *s);
+
+    //! FNV-1a hash usable in constant expressions, equal to fnv1a(s).
+    //! @param s Null-terminated string.
+    //! @param hash Hash of the characters before s.
+    //! @return Hash value.
+    constexpr std::uint32_t fnv1a_constant(const char *s, std::uint32_t hash = 2166136261u)
+    {
+        return *s == '\0' ? hash : fnv1a_constant(s + 1, (hash ^ (unsigned char)*s) * 16777619u);
+    }
+
+    //! An attribute name with its hash. The names read by the built-in
+    //! elements are constants in namespace attr, hashed at compile time;
+    //! other names convert implicitly and are hashed on each lookup.
+    struct AttributeName
+    {
+        //! @param name Null-terminated name, which must outlive this object.
+        constexpr AttributeName(const char *name)
+            : name(name), hash(fnv1a_constant(name))
+        {
+        }
+
+        const char *name;   //!< Name.
+        std::uint32_t hash; //!< fnv1a(name).
+    };
+
+    //! Names of the attributes read by the built-in elements.
+    namespace attr
+    {
+        constexpr AttributeName cx("cx");
+        constexpr AttributeName cy("cy");
+        constexpr AttributeName d("d");
+        constexpr AttributeName fill("fill");
+        constexpr AttributeName fill_rule("fill-rule");
+        constexpr AttributeName height("height");
+        constexpr AttributeName href("href");
+        constexpr AttributeName id("id");
+        constexpr AttributeName points("points");
+        constexpr AttributeName r("r");
+        constexpr AttributeName rx("rx");
+        constexpr AttributeName ry("ry");
+        constexpr AttributeName stroke("stroke");
+        constexpr AttributeName transform("transform");
+        constexpr AttributeName transform_origin("transform-origin");
+        constexpr AttributeName width("width");
+        constexpr AttributeName x("x");
+        constexpr AttributeName x1("x1");
+        constexpr AttributeName x2("x2");
+        constexpr AttributeName y("y");
+        constexpr AttributeName y1("y1");
+        constexpr AttributeName y2("y2");
+    }
+
+    //! Attributes of an XML element, gathered in one pass over the element
+    //! so that each lookup compares hashes instead of names.
+    class ElementAttributes
+    {
+    public:
+        //! Reads the attributes of an element.
+        //! The element must outlive this object.
+        //! @param element The XML element.
+        explicit ElementAttributes(const tinyxml2::XMLElement *element);
+
+        //! Gets an attribute.
+        //! @param name Attribute name.
+        //! @return The value, or nullptr if the attribute is absent.
+        const char *get(const AttributeName &name) const;
+
+        //! Gets an integer attribute, as XMLElement::IntAttribute does.
+        //! @param name Attribute name.
+        //! @param default_value Value if the attribute is absent or invalid.
+        //! @return The value.
+        int get_int(const AttributeName &name, int default_value = 0) const;
+
+        //! Gets a number attribute, as XMLElement::DoubleAttribute does.
+        //! @param name Attribute name.
+        //! @param default_value Value if the attribute is absent or invalid.
+        //! @return The value.
+        double get_double(const AttributeName &name, double default_value = 0) const;
+
+        //! Checks if an attribute has a given value.
+        //! @param name Attribute name.
+        //! @param value Expected value.
+        //! @return True if the attribute is present with that value.
+        bool equals(const AttributeName &name, const char *value) const;
+
+    private:
+        //! An attribute and the hash of its name.
+        struct Entry
+        {
+            std::uint32_t hash; //!< Hash of the name.
+            const char *name;   //!< Name.
+            const char *value;  //!< Value.
+        };
+
+        //! Attributes kept without allocating.
+        static const int INLINE_ENTRIES = 16;
+
+        Entry inline_entries[INLINE_ENTRIES]; //!< First attributes.
+        std::vector<Entry> more_entries;      //!< Attributes past INLINE_ENTRIES.
+        int count = 0;                        //!< Number of attributes.
+
+        //! Finds an attribute.
+        //! @param name Attribute name.
+        //! @return The entry, or nullptr.
+        const Entry *find(const AttributeName &name) const;
+    };
+
+    class ElementReader;
+
+    //! Builds an element from its XML description. The reader then applies
+    //! the transform attribute, records the id and adds the element.
+    //! @param xml The XML element.
+    //! @param attributes Its attributes.
+    //! @param transform_origin Its transform origin.
+    //! @param reader Reader of the document, for elements holding others.
+    //! @return The new element, or nullptr to skip it.
+    typedef SVGElement *(*ElementFactory)(tinyxml2::XMLElement *xml,
+                                          const ElementAttributes &attributes,
+                                          const FixedPoint &transform_origin,
+                                          ElementReader &reader);
+
+    //! Table of element factories by tag name. Tags are hashed once when
+    //! registered; a lookup hashes the tag and compares one or two slots.
+    class ElementRegistry
+    {
+    public:
+        //! Constructs an empty registry.
+        ElementRegistry();
+
+        //! Registers the factory of a tag, replacing any previous one.
+        //! @param tag Tag name.
+        //! @param factory Factory building elements of that tag.
+        void add(const std::string &tag, ElementFactory factory);
+
+        //! Finds the factory of a tag.
+        //! @param tag Tag name.
+        //! @return The factory, or nullptr if the tag is not registered.
+        ElementFactory find(const char *tag) const;
+
+        //! Registry used by readSVG, holding the built-in elements.
+        //! New element types are added here, before documents are read.
+        //! @return The standard registry.
+        static ElementRegistry &standard();
+
+    private:
+        //! A registered tag.
+        struct Slot
+        {
+            std::uint32_t hash = 0;           //!< Hash of the tag.
+            std::string tag;                  //!< Tag name (empty if the slot is free).
+            ElementFactory factory = nullptr; //!< Factory of the tag.
+        };
+
+        std::vector<Slot> slots; //!< Open-addressed table, a power of two in size.
+        size_t used = 0;         //!< Number of registered tags.
+    };
+
+    //! Reads the elements of one document.
+    class ElementReader
+    {
+    public:
+        //! Constructs a reader.
+        //! @param registry Factories to build elements with.
+        //! @param stats Statistics to add transform time to (may be nullptr).
+        //! @param guard Limits to enforce while reading.
+        ElementReader(const ElementRegistry &registry, RenderStats *stats, LimitGuard &guard);
+
+        //! Reads an element and adds it to a vector. Tags without a
+        //! factory are skipped. Throws LimitExceeded if the element goes
+        //! over a limit, after deleting it.
+        //! @param xml The XML element.
+        //! @param elements Vector to add the element to.
+        void read(tinyxml2::XMLElement *xml, std::vector<SVGElement *> &elements);
+
+        //! Reads the children of an element, one level deeper.
+        //! @param xml The XML element.
+        //! @param elements Vector to add the children to.
+        void read_children(tinyxml2::XMLElement *xml, std::vector<SVGElement *> &elements);
+
+        //! Finds an element read earlier by its id.
+        //! Throws std::runtime_error if no element read so far has that id.
+        //! @param id Element id.
+        //! @return The element.
+        SVGElement *element_with_id(const std::string &id) const;
+
+        //! Gets the limits of the document, for factories that copy
+        //! elements.
+        //! @return The guard.
+        LimitGuard &guard();
+
+        //! Finds a gradient of the document by its id, for fills such as
+        //! fill="url(#id)". Gradients are read when first used.
+        //! Throws std::runtime_error if no gradient has that id.
+        //! @param xml An element of the document.
+        //! @param id Gradient id.
+        //! @return The gradient.
+        std::shared_ptr<const Gradient> gradient(tinyxml2::XMLElement *xml, const std::string &id);
+
+    private:
+        const ElementRegistry &registry;                       //!< Element factories.
+        RenderStats *stats;                                    //!< Statistics, or nullptr.
+        LimitGuard &limits;                                    //!< Limits to enforce.
+        int depth = 0;                                         //!< Nesting depth of the elements read.
+        std::map<std::string, SVGElement *> elements_with_id; //!< Elements read with an id.
+        std::unique_ptr<GradientTable> gradients;              //!< Gradients, once one is used.
+    };
+}
+#endif
@@ -0,0 +1,106 @@
+//! @file EllipseCache.cpp
+#include "EllipseCache.hpp"
+#include "PNGImage.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace svg
+{
+    EllipseProfileCache::EllipseProfileCache(size_t capacity, int max_rows)
+        : capacity(std::max<size_t>(capacity, 1)), max_rows(max_rows)
+    {
+    }
+
+    const EllipseProfileCache::Profile *EllipseProfileCache::get(const Point &radius, bool *hit)
+    {
+        // Each thread remembers its last profiles in a few slots, so that
+        // repeated radii skip the lock. Profiles only depend on the radii,
+        // so a slot stays valid after the cache has dropped its profile,
+        // and the slot keeps the returned profile alive.
+        struct Slot
+        {
+            const EllipseProfileCache *owner;
+            Key key;
+            std::shared_ptr<const Profile> profile;
+        };
+        static thread_local Slot slots[THREAD_SLOTS];
+        const Key key(radius.x, radius.y);
+        Slot &slot = slots[((unsigned)radius.x * 31u + (unsigned)radius.y) % THREAD_SLOTS];
+        if (hit != nullptr)
+        {
+            *hit = true;
+        }
+        if (slot.owner == this && slot.key == key)
+        {
+            hit_count.fetch_add(1, std::memory_order_relaxed);
+            return slot.profile.get();
+        }
+
+        std::shared_ptr<const Profile> profile;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = index.find(key);
+            if (it != index.end())
+            {
+                entries.splice(entries.begin(), entries, it->second);
+                profile = it->second->second;
+            }
+        }
+        if (profile)
+        {
+            hit_count.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            miss_count.fetch_add(1, std::memory_order_relaxed);
+            if (hit != nullptr)
+            {
+                *hit = false;
+            }
+            if (radius.y > max_rows)
+            {
+                return nullptr;
+            }
+            // Computed outside the lock; a thread racing on the same radii
+            // computes the same profile and keeps the one already stored.
+            profile.reset(new Profile(PNGImage::axis_ellipse_profile(radius)));
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = index.find(key);
+            if (it != index.end())
+            {
+                profile = it->second->second;
+            }
+            else
+            {
+                entries.emplace_front(key, profile);
+                index[key] = entries.begin();
+                if (entries.size() > capacity)
+                {
+                    index.erase(entries.back().first);
+                    entries.pop_back();
+                }
+            }
+        }
+        slot.owner = this;
+        slot.key = key;
+        slot.profile = std::move(profile);
+        return slot.profile.get();
+    }
+
+    unsigned long long EllipseProfileCache::hits() const
+    {
+        return hit_count.load(std::memory_order_relaxed);
+    }
+
+    unsigned long long EllipseProfileCache::misses() const
+    {
+        return miss_count.load(std::memory_order_relaxed);
+    }
+
+    EllipseProfileCache &EllipseProfileCache::shared()
+    {
+        static EllipseProfileCache cache;
+        return cache;
+    }
+}
@@ -0,0 +1,75 @@
+//! @file EllipseCache.hpp
+#ifndef __svg_EllipseCache_hpp__
+#define __svg_EllipseCache_hpp__
+
+#include "Point.hpp"
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace svg
+{
+    //! Thread-safe cache of the row half-widths of axis-aligned ellipses,
+    //! keyed by radii. Scatter plots and icon sheets draw many ellipses
+    //! with a handful of radii; the profile of each is computed once and
+    //! then replayed as spans at every center. Profiles taller than a
+    //! limit are not cached, and the least recently used ones are dropped
+    //! when the cache is full. Each thread also keeps its last few
+    //! profiles, so repeated radii are found without taking the lock.
+    class EllipseProfileCache
+    {
+    public:
+        //! Half-width of each row, from the center row down.
+        typedef std::vector<int> Profile;
+
+        //! Constructs an empty cache.
+        //! @param capacity Maximum number of profiles kept.
+        //! @param max_rows Tallest profile kept, in rows.
+        explicit EllipseProfileCache(size_t capacity = 256, int max_rows = 4096);
+
+        //! Gets the profile of an axis-aligned ellipse.
+        //! @param radius Radius in X and Y axis.
+        //! @param hit Set to whether the profile came from the cache (may
+        //! be nullptr), for callers counting their own lookups.
+        //! @return The profile, or nullptr if it is too tall to cache. It
+        //! stays valid until the next call from the same thread.
+        const Profile *get(const Point &radius, bool *hit = nullptr);
+
+        //! Number of requests answered from the cache, from all threads.
+        //! @return Hit count.
+        unsigned long long hits() const;
+
+        //! Number of requests that computed a profile, including those
+        //! too tall to cache.
+        //! @return Miss count.
+        unsigned long long misses() const;
+
+        //! Cache used by PNGImage::draw_ellipse.
+        //! @return The process-wide cache.
+        static EllipseProfileCache &shared();
+
+    private:
+        EllipseProfileCache(const EllipseProfileCache &) = delete;
+        EllipseProfileCache &operator=(const EllipseProfileCache &) = delete;
+
+        typedef std::pair<int, int> Key;
+        typedef std::list<std::pair<Key, std::shared_ptr<const Profile>>> EntryList;
+
+        //! Profiles remembered by each thread in front of the shared ones.
+        static const unsigned THREAD_SLOTS = 16;
+
+        size_t capacity;                               //!< Maximum number of profiles.
+        int max_rows;                                  //!< Tallest profile kept.
+        std::atomic<unsigned long long> hit_count{0};  //!< Requests answered from the cache.
+        std::atomic<unsigned long long> miss_count{0}; //!< Requests that computed a profile.
+        std::mutex mutex;                              //!< Guards everything below.
+        EntryList entries;                             //!< Profiles, most recently used first.
+        std::map<Key, EntryList::iterator> index;      //!< Position of each key in entries.
+    };
+}
+#endif
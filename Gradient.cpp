@@ -0,0 +1,643 @@
+//! @file Gradient.cpp
+#include "Gradient.hpp"
+#include "external/tinyxml2/tinyxml2.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace tinyxml2;
+
+namespace svg
+{
+    namespace
+    {
+        //! Longest chain of gradients referring to templates.
+        const int MAX_TEMPLATE_DEPTH = 32;
+        //! Largest offset magnitude kept before spreading, so that
+        //! offsets convert to 32-bit integers exactly.
+        const float MAX_OFFSET = 4194304.0f;
+        //! Largest distance of the focal point from the center, as a
+        //! fraction of the radius, so that the offset stays defined.
+        const double MAX_FOCAL_DISTANCE = 0.99;
+
+        //! Length attribute, which may be a percentage.
+        struct Length
+        {
+            double value;
+            bool percent;
+        };
+
+        //! Parses a length such as "10", "0.5" or "50%".
+        //! @param value The attribute (may be nullptr).
+        //! @param length Receives the length.
+        //! @return True if the attribute is present and starts with a number.
+        bool parse_length(const char *value, Length &length)
+        {
+            if (value == nullptr)
+            {
+                return false;
+            }
+            char *end;
+            double v = std::strtod(value, &end);
+            if (end == value)
+            {
+                return false;
+            }
+            length.percent = *end == '%';
+            length.value = length.percent ? v / 100 : v;
+            return true;
+        }
+
+        //! Gets an href attribute, plain or in the xlink namespace.
+        const char *get_href(const XMLElement *xml)
+        {
+            const char *href = xml->Attribute("href");
+            return href != nullptr ? href : xml->Attribute("xlink:href");
+        }
+
+        //! Reads the arguments of a transform function.
+        //! @param s Position after the opening parenthesis; moved past the
+        //! closing one.
+        //! @param args Receives up to 6 arguments.
+        //! @return Number of arguments.
+        int parse_arguments(const char *&s, double args[6])
+        {
+            int n = 0;
+            for (;;)
+            {
+                while (*s == ',' || std::isspace((unsigned char)*s))
+                {
+                    s++;
+                }
+                if (*s == ')' || *s == '\0')
+                {
+                    break;
+                }
+                char *end;
+                double v = std::strtod(s, &end);
+                if (end == s)
+                {
+                    throw std::runtime_error("Invalid number in gradientTransform");
+                }
+                if (n < 6)
+                {
+                    args[n] = v;
+                }
+                n++;
+                s = end;
+            }
+            if (*s == ')')
+            {
+                s++;
+            }
+            return n;
+        }
+
+        //! Parses a transform list such as "rotate(45 0.5 0.5) scale(2)".
+        //! Functions apply right to left, as in SVG.
+        //! @param value The transform list.
+        //! @return The transform.
+        Affine parse_transform_list(const char *value)
+        {
+            Affine result = Affine::identity();
+            const char *s = value;
+            for (;;)
+            {
+                while (*s == ',' || std::isspace((unsigned char)*s))
+                {
+                    s++;
+                }
+                if (*s == '\0')
+                {
+                    return result;
+                }
+                const char *name = s;
+                while (std::isalpha((unsigned char)*s))
+                {
+                    s++;
+                }
+                std::string function(name, s);
+                while (std::isspace((unsigned char)*s))
+                {
+                    s++;
+                }
+                if (*s != '(')
+                {
+                    throw std::runtime_error("Invalid gradientTransform: " + std::string(value));
+                }
+                s++;
+                double args[6] = {0, 0, 0, 0, 0, 0};
+                const int n = parse_arguments(s, args);
+                Affine t = Affine::identity();
+                if (function == "matrix" && n == 6)
+                {
+                    t = {args[0], args[1], args[2], args[3], args[4], args[5]};
+                }
+                else if (function == "translate" && (n == 1 || n == 2))
+                {
+                    t = t.translate(args[0], args[1]);
+                }
+                else if (function == "scale" && (n == 1 || n == 2))
+                {
+                    t = {args[0], 0, 0, n == 2 ? args[1] : args[0], 0, 0};
+                }
+                else if (function == "rotate" && (n == 1 || n == 3))
+                {
+                    t = t.rotate({args[1], args[2]}, args[0]);
+                }
+                else if (function == "skewX" && n == 1)
+                {
+                    t = {1, 0, std::tan(M_PI * args[0] / 180.0), 1, 0, 0};
+                }
+                else if (function == "skewY" && n == 1)
+                {
+                    t = {1, std::tan(M_PI * args[0] / 180.0), 0, 1, 0, 0};
+                }
+                else
+                {
+                    throw std::runtime_error("Invalid gradientTransform: " + std::string(value));
+                }
+                // the function applies before those to its left
+                result = t.then(result);
+            }
+        }
+
+        //! Gets the stop color of a stop element, from its stop-color
+        //! attribute or its style.
+        Color stop_color(const XMLElement *stop)
+        {
+            std::string value;
+            const char *attribute = stop->Attribute("stop-color");
+            const char *style = stop->Attribute("style");
+            const char *in_style = style != nullptr ? std::strstr(style, "stop-color:") : nullptr;
+            if (in_style != nullptr)
+            {
+                in_style += std::strlen("stop-color:");
+                const char *end = std::strchr(in_style, ';');
+                value.assign(in_style, end != nullptr ? end : in_style + std::strlen(in_style));
+            }
+            else if (attribute != nullptr)
+            {
+                value = attribute;
+            }
+            value.erase(0, value.find_first_not_of(" \t"));
+            value.erase(value.find_last_not_of(" \t") + 1);
+            return value.empty() ? Color{0, 0, 0} : parse_color(value);
+        }
+
+        //! Clamps offsets to [-MAX_OFFSET, MAX_OFFSET]; NaN becomes the lower bound.
+        inline float clamp_offset(float t)
+        {
+            t = t > -MAX_OFFSET ? t : -MAX_OFFSET;
+            return t < MAX_OFFSET ? t : MAX_OFFSET;
+        }
+
+        //! Largest whole number not above t, for |t| <= MAX_OFFSET.
+        inline float floor_offset(float t)
+        {
+            float f = (float)(std::int32_t)t;
+            return f > t ? f - 1.0f : f;
+        }
+
+        //! Ramp index of an offset. The SSE2 version below computes the
+        //! same float operations, so both give the same pixels.
+        inline int ramp_index(float t, SpreadMethod spread)
+        {
+            t = clamp_offset(t);
+            switch (spread)
+            {
+            case SpreadMethod::Pad:
+                t = t > 0.0f ? t : 0.0f;
+                t = t < 1.0f ? t : 1.0f;
+                break;
+            case SpreadMethod::Repeat:
+                t = t - floor_offset(t);
+                break;
+            case SpreadMethod::Reflect:
+            {
+                float u = t * 0.5f;
+                u = u - floor_offset(u);
+                t = 1.0f - std::fabs(u * 2.0f - 1.0f);
+                break;
+            }
+            }
+            return (int)std::nearbyint(t * (float)(GRADIENT_RAMP_SIZE - 1));
+        }
+
+#if defined(__SSE2__)
+        //! Largest whole numbers not above four offsets.
+        inline __m128 floor_offsets(__m128 t)
+        {
+            __m128 f = _mm_cvtepi32_ps(_mm_cvttps_epi32(t));
+            return _mm_sub_ps(f, _mm_and_ps(_mm_cmpgt_ps(f, t), _mm_set1_ps(1.0f)));
+        }
+
+        //! Ramp indices of four offsets.
+        inline __m128i ramp_indices(__m128 t, SpreadMethod spread)
+        {
+            const __m128 one = _mm_set1_ps(1.0f);
+            t = _mm_max_ps(t, _mm_set1_ps(-MAX_OFFSET));
+            t = _mm_min_ps(t, _mm_set1_ps(MAX_OFFSET));
+            switch (spread)
+            {
+            case SpreadMethod::Pad:
+                t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), one);
+                break;
+            case SpreadMethod::Repeat:
+                t = _mm_sub_ps(t, floor_offsets(t));
+                break;
+            case SpreadMethod::Reflect:
+            {
+                __m128 u = _mm_mul_ps(t, _mm_set1_ps(0.5f));
+                u = _mm_sub_ps(u, floor_offsets(u));
+                __m128 v = _mm_sub_ps(_mm_mul_ps(u, _mm_set1_ps(2.0f)), one);
+                t = _mm_sub_ps(one, _mm_andnot_ps(_mm_set1_ps(-0.0f), v));
+                break;
+            }
+            }
+            return _mm_cvtps_epi32(_mm_mul_ps(t, _mm_set1_ps((float)(GRADIENT_RAMP_SIZE - 1))));
+        }
+
+        //! Writes the ramp colors of four indices.
+        inline void store_colors(Pixel *out, const Pixel *ramp, __m128i indices)
+        {
+            alignas(16) std::int32_t i[4];
+            _mm_store_si128(reinterpret_cast<__m128i *>(i), indices);
+            out[0] = ramp[i[0]];
+            out[1] = ramp[i[1]];
+            out[2] = ramp[i[2]];
+            out[3] = ramp[i[3]];
+        }
+#endif
+    }
+
+    void Gradient::build_ramp()
+    {
+        for (int i = 0; i < GRADIENT_RAMP_SIZE; i++)
+        {
+            const double t = (double)i / (GRADIENT_RAMP_SIZE - 1);
+            Color c = {0, 0, 0};
+            if (!stops.empty())
+            {
+                // the first stop past t, so that equal offsets make a hard edge
+                size_t k = 0;
+                while (k < stops.size() && stops[k].offset <= t)
+                {
+                    k++;
+                }
+                if (k == 0 || k == stops.size())
+                {
+                    c = stops[k == 0 ? 0 : k - 1].color;
+                }
+                else
+                {
+                    const GradientStop &a = stops[k - 1], &b = stops[k];
+                    const double f = (t - a.offset) / (b.offset - a.offset);
+                    c = {(rgb_value)std::lround(a.color.red + f * (b.color.red - a.color.red)),
+                         (rgb_value)std::lround(a.color.green + f * (b.color.green - a.color.green)),
+                         (rgb_value)std::lround(a.color.blue + f * (b.color.blue - a.color.blue))};
+                }
+            }
+            for (int format = 0; format < 4; format++)
+            {
+                ramps[format][i] = pack_pixel(c, (PixelFormat)format);
+            }
+        }
+    }
+
+    const Pixel *Gradient::ramp(PixelFormat format) const
+    {
+        return ramps[(int)format];
+    }
+
+    GradientTable::GradientTable(const XMLElement *root)
+    {
+        // user space is the viewBox if there is one, else the canvas
+        viewport_width = root->DoubleAttribute("width");
+        viewport_height = root->DoubleAttribute("height");
+        const char *view_box = root->Attribute("viewBox");
+        if (view_box != nullptr)
+        {
+            double box[4];
+            const char *s = view_box;
+            int n = 0;
+            for (; n < 4; n++)
+            {
+                while (*s == ',' || std::isspace((unsigned char)*s))
+                {
+                    s++;
+                }
+                char *end;
+                box[n] = std::strtod(s, &end);
+                if (end == s)
+                {
+                    break;
+                }
+                s = end;
+            }
+            if (n == 4 && box[2] > 0 && box[3] > 0)
+            {
+                viewport_width = box[2];
+                viewport_height = box[3];
+            }
+        }
+        std::vector<const XMLElement *> pending(1, root);
+        while (!pending.empty())
+        {
+            const XMLElement *xml = pending.back();
+            pending.pop_back();
+            const char *id = xml->Attribute("id");
+            if (id != nullptr && (std::strcmp(xml->Name(), "linearGradient") == 0 ||
+                                  std::strcmp(xml->Name(), "radialGradient") == 0))
+            {
+                elements.insert({id, xml});
+            }
+            for (const XMLElement *child = xml->FirstChildElement(); child != nullptr;
+                 child = child->NextSiblingElement())
+            {
+                pending.push_back(child);
+            }
+        }
+    }
+
+    std::shared_ptr<const Gradient> GradientTable::find(const std::string &id)
+    {
+        auto it = gradients.find(id);
+        if (it != gradients.end())
+        {
+            return it->second;
+        }
+        auto xml = elements.find(id);
+        if (xml == elements.end())
+        {
+            throw std::runtime_error("Unknown gradient #" + id);
+        }
+        std::shared_ptr<const Gradient> gradient = read(xml->second);
+        gradients[id] = gradient;
+        return gradient;
+    }
+
+    std::shared_ptr<const Gradient> GradientTable::read(const XMLElement *xml) const
+    {
+        // the element, then the templates it inherits unset attributes
+        // and stops from
+        std::vector<const XMLElement *> chain(1, xml);
+        for (const char *href = get_href(xml); href != nullptr && href[0] == '#'; href = get_href(chain.back()))
+        {
+            auto it = elements.find(href + 1);
+            if (it == elements.end())
+            {
+                throw std::runtime_error("Unknown gradient " + std::string(href));
+            }
+            if (std::find(chain.begin(), chain.end(), it->second) != chain.end() ||
+                (int)chain.size() >= MAX_TEMPLATE_DEPTH)
+            {
+                throw std::runtime_error("Gradient reference loop at " + std::string(href));
+            }
+            chain.push_back(it->second);
+        }
+        auto attribute = [&](const char *name) -> const char *
+        {
+            for (const XMLElement *e : chain)
+            {
+                const char *value = e->Attribute(name);
+                if (value != nullptr)
+                {
+                    return value;
+                }
+            }
+            return nullptr;
+        };
+
+        std::shared_ptr<Gradient> g = std::make_shared<Gradient>();
+        g->radial = std::strcmp(xml->Name(), "radialGradient") == 0;
+        const char *units = attribute("gradientUnits");
+        g->bounding_box_units = units == nullptr || std::strcmp(units, "userSpaceOnUse") != 0;
+        const char *transform = attribute("gradientTransform");
+        if (transform != nullptr)
+        {
+            g->transform = parse_transform_list(transform);
+        }
+        const char *spread = attribute("spreadMethod");
+        if (spread != nullptr && std::strcmp(spread, "reflect") == 0)
+        {
+            g->spread = SpreadMethod::Reflect;
+        }
+        else if (spread != nullptr && std::strcmp(spread, "repeat") == 0)
+        {
+            g->spread = SpreadMethod::Repeat;
+        }
+
+        // lengths default to fractions of the box, or of the viewport in
+        // user space, where percentages are too
+        const double diagonal = std::sqrt((viewport_width * viewport_width + viewport_height * viewport_height) / 2);
+        auto length = [&](const char *name, double fraction, double extent)
+        {
+            Length l = {fraction, true};
+            parse_length(attribute(name), l);
+            return l.percent && !g->bounding_box_units ? l.value * extent : l.value;
+        };
+        if (g->radial)
+        {
+            g->cx = length("cx", 0.5, viewport_width);
+            g->cy = length("cy", 0.5, viewport_height);
+            g->r = length("r", 0.5, diagonal);
+            g->fx = attribute("fx") != nullptr ? length("fx", 0.5, viewport_width) : g->cx;
+            g->fy = attribute("fy") != nullptr ? length("fy", 0.5, viewport_height) : g->cy;
+        }
+        else
+        {
+            g->x1 = length("x1", 0, viewport_width);
+            g->y1 = length("y1", 0, viewport_height);
+            g->x2 = length("x2", 1, viewport_width);
+            g->y2 = length("y2", 0, viewport_height);
+        }
+
+        // stops come from the first element of the chain that has any
+        for (const XMLElement *e : chain)
+        {
+            for (const XMLElement *stop = e->FirstChildElement("stop"); stop != nullptr;
+                 stop = stop->NextSiblingElement("stop"))
+            {
+                Length offset = {0, false};
+                parse_length(stop->Attribute("offset"), offset);
+                double o = std::min(std::max(offset.value, 0.0), 1.0);
+                // offsets never decrease
+                if (!g->stops.empty())
+                {
+                    o = std::max(o, g->stops.back().offset);
+                }
+                g->stops.push_back({o, stop_color(stop)});
+            }
+            if (!g->stops.empty())
+            {
+                break;
+            }
+        }
+        g->build_ramp();
+        return g;
+    }
+
+    Paint::Paint(const Color &color)
+        : color(color), transform(Affine::identity())
+    {
+    }
+
+    Paint::Paint(const std::shared_ptr<const Gradient> &gradient,
+                 double x, double y, double width, double height)
+        : color(gradient->stops.empty() ? Color{0, 0, 0} : gradient->stops.back().color),
+          gradient(gradient), transform(gradient->transform)
+    {
+        if (gradient->bounding_box_units)
+        {
+            transform = transform.then({width, 0, 0, height, x, y});
+        }
+    }
+
+    void Paint::translate(double x, double y)
+    {
+        if (gradient != nullptr)
+        {
+            transform = transform.translate(x, y);
+        }
+    }
+
+    void Paint::rotate(const PathPoint &origin, int degrees)
+    {
+        if (gradient != nullptr)
+        {
+            transform = transform.rotate(origin, degrees);
+        }
+    }
+
+    void Paint::scale(const PathPoint &origin, int v)
+    {
+        if (gradient != nullptr)
+        {
+            transform = transform.scale(origin, v);
+        }
+    }
+
+    void Paint::fit(double v, double dx, double dy)
+    {
+        if (gradient != nullptr)
+        {
+            transform = transform.scale({0, 0}, v).translate(dx, dy);
+        }
+    }
+
+    GradientShader::GradientShader(const Paint &paint, PixelFormat format)
+        : ramp_(paint.gradient->ramp(format)), spread_(paint.gradient->spread)
+    {
+        const Gradient &g = *paint.gradient;
+        valid_ = !g.stops.empty() && paint.transform.invert(inverse_);
+        if (!valid_)
+        {
+            return;
+        }
+        const Affine &m = inverse_;
+        if (g.radial && g.r > 0)
+        {
+            // the offset t of a point p is where p lies on the circle of
+            // center f + t (c - f) and radius t r, f being the focal point
+            radial_ = true;
+            double fx = g.fx, fy = g.fy;
+            const double distance = std::hypot(fx - g.cx, fy - g.cy);
+            if (distance > g.r * MAX_FOCAL_DISTANCE)
+            {
+                fx = g.cx + (fx - g.cx) * g.r * MAX_FOCAL_DISTANCE / distance;
+                fy = g.cy + (fy - g.cy) * g.r * MAX_FOCAL_DISTANCE / distance;
+            }
+            focal_x_ = fx;
+            focal_y_ = fy;
+            ex_ = (float)(g.cx - fx);
+            ey_ = (float)(g.cy - fy);
+            inv_a_ = (float)(1.0 / ((g.cx - fx) * (g.cx - fx) + (g.cy - fy) * (g.cy - fy) - g.r * g.r));
+        }
+        else if (!g.radial && (g.x1 != g.x2 || g.y1 != g.y2))
+        {
+            // t = (p - p1) . (p2 - p1) / |p2 - p1|^2, p being the inverse
+            // image of the pixel, which is affine in the pixel's coordinates
+            const double vx = g.x2 - g.x1, vy = g.y2 - g.y1;
+            const double l2 = vx * vx + vy * vy;
+            ax_ = (m.a * vx + m.b * vy) / l2;
+            ay_ = (m.c * vx + m.d * vy) / l2;
+            a0_ = ((m.e - g.x1) * vx + (m.f - g.y1) * vy) / l2;
+        }
+        else
+        {
+            // a zero radius or length paints the last stop
+            spread_ = SpreadMethod::Pad;
+        }
+    }
+
+    bool GradientShader::valid() const
+    {
+        return valid_;
+    }
+
+    void GradientShader::shade(Pixel *out, int x, int y, int n) const
+    {
+        int i = 0;
+        if (!radial_)
+        {
+            const float t0 = (float)(ax_ * x + ay_ * y + a0_);
+            const float dt = (float)ax_;
+#if defined(__SSE2__)
+            const __m128 t0_4 = _mm_set1_ps(t0), dt_4 = _mm_set1_ps(dt), four = _mm_set1_ps(4.0f);
+            __m128 k = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+            for (; i + 4 <= n; i += 4)
+            {
+                store_colors(out + i, ramp_, ramp_indices(_mm_add_ps(t0_4, _mm_mul_ps(k, dt_4)), spread_));
+                k = _mm_add_ps(k, four);
+            }
+#endif
+            for (; i < n; i++)
+            {
+                out[i] = ramp_[ramp_index(t0 + (float)i * dt, spread_)];
+            }
+            return;
+        }
+        // position relative to the focal point, in gradient coordinates
+        const Affine &m = inverse_;
+        const float dx0 = (float)(m.a * x + m.c * y + m.e - focal_x_);
+        const float dy0 = (float)(m.b * x + m.d * y + m.f - focal_y_);
+        const float step_x = (float)m.a, step_y = (float)m.b;
+#if defined(__SSE2__)
+        const __m128 dx0_4 = _mm_set1_ps(dx0), dy0_4 = _mm_set1_ps(dy0);
+        const __m128 step_x4 = _mm_set1_ps(step_x), step_y4 = _mm_set1_ps(step_y);
+        const __m128 ex = _mm_set1_ps(ex_), ey = _mm_set1_ps(ey_), inv_a = _mm_set1_ps(inv_a_);
+        const __m128 a4 = _mm_set1_ps(1.0f / inv_a_), four = _mm_set1_ps(4.0f);
+        __m128 k = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+        for (; i + 4 <= n; i += 4)
+        {
+            const __m128 dx = _mm_add_ps(dx0_4, _mm_mul_ps(k, step_x4));
+            const __m128 dy = _mm_add_ps(dy0_4, _mm_mul_ps(k, step_y4));
+            const __m128 de = _mm_add_ps(_mm_mul_ps(dx, ex), _mm_mul_ps(dy, ey));
+            const __m128 dd = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+            const __m128 root = _mm_sqrt_ps(_mm_sub_ps(_mm_mul_ps(de, de), _mm_mul_ps(a4, dd)));
+            store_colors(out + i, ramp_, ramp_indices(_mm_mul_ps(_mm_sub_ps(de, root), inv_a), spread_));
+            k = _mm_add_ps(k, four);
+        }
+#endif
+        const float a = 1.0f / inv_a_;
+        for (; i < n; i++)
+        {
+            const float dx = dx0 + (float)i * step_x;
+            const float dy = dy0 + (float)i * step_y;
+            const float de = dx * ex_ + dy * ey_;
+            const float dd = dx * dx + dy * dy;
+            const float root = std::sqrt(de * de - a * dd);
+            out[i] = ramp_[ramp_index((de - root) * inv_a_, spread_)];
+        }
+    }
+}
@@ -0,0 +1,185 @@
+//! @file Gradient.hpp
+#ifndef __svg_Gradient_hpp__
+#define __svg_Gradient_hpp__
+
+#include "Color.hpp"
+#include "PNGImage.hpp"
+#include "Path.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tinyxml2
+{
+    class XMLElement;
+}
+
+namespace svg
+{
+    //! How a gradient paints past its ends.
+    enum class SpreadMethod
+    {
+        Pad,     //!< The end colors extend outwards.
+        Reflect, //!< The gradient repeats, mirrored every other time.
+        Repeat   //!< The gradient repeats.
+    };
+
+    //! Color of a gradient at an offset.
+    struct GradientStop
+    {
+        //! Offset along the gradient, from 0 to 1.
+        double offset;
+        //! Color at the offset.
+        Color color;
+    };
+
+    //! Number of entries of a gradient's color ramp.
+    const int GRADIENT_RAMP_SIZE = 256;
+
+    //! A linearGradient or radialGradient, with its href templates
+    //! resolved and its colors sampled into a ramp.
+    struct Gradient
+    {
+        //! Whether the gradient is radial rather than linear.
+        bool radial = false;
+        //! Whether coordinates are fractions of the element's bounding box
+        //! (gradientUnits="objectBoundingBox", the default) rather than
+        //! user space coordinates.
+        bool bounding_box_units = true;
+        //! Start of a linear gradient.
+        double x1 = 0, y1 = 0;
+        //! End of a linear gradient.
+        double x2 = 1, y2 = 0;
+        //! Center of the end circle of a radial gradient.
+        double cx = 0.5, cy = 0.5;
+        //! Radius of the end circle of a radial gradient.
+        double r = 0.5;
+        //! Focal point of a radial gradient.
+        double fx = 0.5, fy = 0.5;
+        //! The gradientTransform, from gradient to bounding box or user space.
+        Affine transform = Affine::identity();
+        //! The spreadMethod.
+        SpreadMethod spread = SpreadMethod::Pad;
+        //! Stops, by increasing offset.
+        std::vector<GradientStop> stops;
+
+        //! Samples the stops into the ramps, once the stops are set.
+        void build_ramp();
+        //! Gets the color ramp: the colors at offsets i / 255.
+        //! @param format Pixel format of the ramp.
+        //! @return GRADIENT_RAMP_SIZE packed pixels.
+        const Pixel *ramp(PixelFormat format) const;
+
+    private:
+        //! Ramps packed in each pixel format.
+        Pixel ramps[4][GRADIENT_RAMP_SIZE];
+    };
+
+    //! The gradients of a document, by id. Gradients may be defined
+    //! anywhere in the document, usually in defs, and are read when they
+    //! are first used.
+    class GradientTable
+    {
+    public:
+        //! Finds the gradient elements of a document.
+        //! @param root The root element.
+        explicit GradientTable(const tinyxml2::XMLElement *root);
+
+        //! Gets a gradient.
+        //! @param id Its id.
+        //! @return The gradient.
+        std::shared_ptr<const Gradient> find(const std::string &id);
+
+    private:
+        //! Reads a gradient element and the templates it refers to.
+        //! @param xml The gradient element.
+        //! @return The gradient.
+        std::shared_ptr<const Gradient> read(const tinyxml2::XMLElement *xml) const;
+
+        std::map<std::string, const tinyxml2::XMLElement *> elements;    //!< Gradient elements by id.
+        std::map<std::string, std::shared_ptr<const Gradient>> gradients; //!< Gradients read so far.
+        double viewport_width = 0;                                        //!< Width of the user space.
+        double viewport_height = 0;                                       //!< Height of the user space.
+    };
+
+    //! Fill of an element: a solid color, or a gradient with the transform
+    //! from gradient to image coordinates. The transform follows the
+    //! element's transforms.
+    struct Paint
+    {
+        //! Solid paint.
+        //! @param color The color.
+        Paint(const Color &color = {0, 0, 0});
+        //! Gradient paint.
+        //! @param gradient The gradient.
+        //! @param x Left of the element's bounding box, in user space.
+        //! @param y Top of the bounding box.
+        //! @param width Width of the bounding box.
+        //! @param height Height of the bounding box.
+        Paint(const std::shared_ptr<const Gradient> &gradient,
+              double x, double y, double width, double height);
+
+        //! Translates the gradient with its element.
+        //! @param x The x-coordinate translation.
+        //! @param y The y-coordinate translation.
+        void translate(double x, double y);
+        //! Rotates the gradient with its element.
+        //! @param origin Rotation origin.
+        //! @param degrees Degrees of rotation.
+        void rotate(const PathPoint &origin, int degrees);
+        //! Scales the gradient with its element.
+        //! @param origin Scaling origin.
+        //! @param v Scale amount.
+        void scale(const PathPoint &origin, int v);
+        //! Maps the gradient from document to image coordinates.
+        //! @param v The scaling factor.
+        //! @param dx The x-coordinate translation, after scaling.
+        //! @param dy The y-coordinate translation, after scaling.
+        void fit(double v, double dx, double dy);
+
+        //! Color of a solid paint.
+        Color color;
+        //! Gradient, or nullptr for a solid paint.
+        std::shared_ptr<const Gradient> gradient;
+        //! Transform from gradient to image coordinates.
+        Affine transform;
+    };
+
+    //! Computes the colors of a gradient paint along spans of an image.
+    //! Offsets are interpolated four pixels at a time with SSE2 (when
+    //! available) and looked up in the gradient's ramp.
+    class GradientShader
+    {
+    public:
+        //! Prepares a gradient paint for drawing.
+        //! @param paint The paint (with a gradient).
+        //! @param format Pixel format of the image.
+        GradientShader(const Paint &paint, PixelFormat format);
+
+        //! Checks if the paint draws anything: a gradient without stops,
+        //! or mapped to a degenerate box, paints nothing.
+        //! @return True if the paint is drawn.
+        bool valid() const;
+
+        //! Shades pixels of a row.
+        //! @param out First pixel to write.
+        //! @param x Canvas column of the first pixel.
+        //! @param y Canvas row.
+        //! @param n Number of pixels.
+        void shade(Pixel *out, int x, int y, int n) const;
+
+    private:
+        const Pixel *ramp_ = nullptr;      //!< Ramp in the image's pixel format.
+        bool valid_ = false;               //!< Result of valid().
+        bool radial_ = false;              //!< Whether the gradient is radial.
+        SpreadMethod spread_;              //!< How the gradient paints past its ends.
+        Affine inverse_;                   //!< Transform from image to gradient coordinates.
+        double ax_ = 0, ay_ = 0, a0_ = 1;  //!< Linear offset at (x, y): ax_ * x + ay_ * y + a0_.
+        double focal_x_ = 0, focal_y_ = 0; //!< Focal point of a radial gradient.
+        float ex_ = 0, ey_ = 0;            //!< From the focal point to the center.
+        float inv_a_ = 0;                  //!< 1 / (|e|^2 - r^2), which is negative.
+    };
+}
+#endif
@@ -0,0 +1,147 @@
+//! @file Limits.cpp
+#include "Limits.hpp"
+#include "SVGElements.hpp"
+
+#include <climits>
+#include <sstream>
+
+namespace svg
+{
+    namespace
+    {
+        //! Throws LimitExceeded if a count is over a limit.
+        //! @param code The limit.
+        //! @param count The count.
+        //! @param limit The limit (0 for none).
+        void check(LimitCode code, double count, double limit)
+        {
+            if (limit > 0 && count > limit)
+            {
+                std::ostringstream message;
+                message.precision(15);
+                message << "Limit exceeded (" << limit_name(code) << "): " << count
+                        << " is over the limit of " << limit;
+                throw LimitExceeded(code, message.str());
+            }
+        }
+
+        //! Counts the elements and vertices of an element and its members.
+        void count_tree(const SVGElement &elem, unsigned long long &elements, unsigned long long &vertices)
+        {
+            elements++;
+            vertices += elem.vertex_count();
+            if (elem.children() != nullptr)
+            {
+                for (const SVGElement *child : *elem.children())
+                {
+                    count_tree(*child, elements, vertices);
+                }
+            }
+        }
+    }
+
+    ResourceLimits ResourceLimits::untrusted()
+    {
+        ResourceLimits limits;
+        limits.max_canvas_pixels = 100000000;
+        limits.max_elements = 1000000;
+        limits.max_vertices = 10000000;
+        limits.max_depth = 64;
+        limits.max_use_expansions = 100000;
+        limits.max_wall_ms = 10000;
+        return limits;
+    }
+
+    const char *limit_name(LimitCode code)
+    {
+        switch (code)
+        {
+        case LimitCode::CanvasPixels:
+            return "canvas_pixels";
+        case LimitCode::Elements:
+            return "elements";
+        case LimitCode::Vertices:
+            return "vertices";
+        case LimitCode::Depth:
+            return "depth";
+        case LimitCode::UseExpansions:
+            return "use_expansions";
+        case LimitCode::WallTime:
+            return "wall_time";
+        case LimitCode::EmptyCanvas:
+            return "empty_canvas";
+        }
+        return "unknown";
+    }
+
+    LimitExceeded::LimitExceeded(LimitCode code, const std::string &message)
+        : std::runtime_error(message), code_(code)
+    {
+    }
+
+    LimitCode LimitExceeded::code() const
+    {
+        return code_;
+    }
+
+    LimitGuard::LimitGuard(const ResourceLimits &limits)
+        : limits(limits), start(std::chrono::steady_clock::now())
+    {
+    }
+
+    void LimitGuard::add_element(unsigned long long element_vertices)
+    {
+        elements++;
+        vertices += element_vertices;
+        check(LimitCode::Elements, elements, limits.max_elements);
+        check(LimitCode::Vertices, vertices, limits.max_vertices);
+        // reading the clock costs about as much as a small element
+        if (elements % 64 == 0)
+        {
+            check_time();
+        }
+    }
+
+    void LimitGuard::add_use_copy(const SVGElement &elem)
+    {
+        unsigned long long copy_elements = 0, copy_vertices = 0;
+        count_tree(elem, copy_elements, copy_vertices);
+        use_copies += copy_elements;
+        check(LimitCode::UseExpansions, use_copies, limits.max_use_expansions);
+        // the copy itself is counted by add_element, like other elements
+        elements += copy_elements - 1;
+        vertices += copy_vertices - elem.vertex_count();
+        check(LimitCode::Elements, elements, limits.max_elements);
+        check(LimitCode::Vertices, vertices, limits.max_vertices);
+        check_time();
+    }
+
+    void LimitGuard::check_depth(int depth) const
+    {
+        check(LimitCode::Depth, depth, limits.max_depth);
+    }
+
+    void LimitGuard::check_canvas(double width, double height) const
+    {
+        if (!(width > 0 && height > 0))
+        {
+            throw LimitExceeded(LimitCode::EmptyCanvas, "Document has no width or height");
+        }
+        check(LimitCode::CanvasPixels, width * height, (double)limits.max_canvas_pixels);
+        // whatever the limits, sides must fit in pixel coordinates
+        if (width > INT_MAX || height > INT_MAX)
+        {
+            throw LimitExceeded(LimitCode::CanvasPixels, "Canvas side over the largest pixel coordinate");
+        }
+    }
+
+    void LimitGuard::check_time() const
+    {
+        if (limits.max_wall_ms > 0)
+        {
+            check(LimitCode::WallTime,
+                  std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+                  limits.max_wall_ms);
+        }
+    }
+}
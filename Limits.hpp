@@ -0,0 +1,112 @@
+//! @file Limits.hpp
+#ifndef __svg_Limits_hpp__
+#define __svg_Limits_hpp__
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+namespace svg
+{
+    class SVGElement;
+
+    //! Limits on the resources a conversion may use, so that untrusted
+    //! documents are rejected while they are read, before any large
+    //! allocation. A limit of 0 means no limit.
+    struct ResourceLimits
+    {
+        //! Largest output canvas, in pixels (width times height).
+        unsigned long long max_canvas_pixels = 0;
+        //! Most elements, counting group members and use copies.
+        unsigned long long max_elements = 0;
+        //! Most vertices (points, centers and control points).
+        unsigned long long max_vertices = 0;
+        //! Deepest nesting of groups.
+        int max_depth = 0;
+        //! Most elements created by use references, counting members of
+        //! copied groups.
+        unsigned long long max_use_expansions = 0;
+        //! Longest conversion, in milliseconds.
+        double max_wall_ms = 0;
+
+        //! Limits suited to user uploads: a 100 megapixel canvas, a million
+        //! elements, ten million vertices, 64 nested groups, 100000 use
+        //! copies and ten seconds.
+        //! @return The limits.
+        static ResourceLimits untrusted();
+    };
+
+    //! Resource that went over its limit.
+    enum class LimitCode
+    {
+        CanvasPixels = 1,
+        Elements,
+        Vertices,
+        Depth,
+        UseExpansions,
+        WallTime,
+        EmptyCanvas
+    };
+
+    //! Gets the name of a limit, as used in error messages.
+    //! @param code The limit.
+    //! @return Name such as "canvas_pixels".
+    const char *limit_name(LimitCode code);
+
+    //! Error thrown when a conversion goes over one of its limits.
+    class LimitExceeded : public std::runtime_error
+    {
+    public:
+        //! Constructor.
+        //! @param code The limit that was exceeded.
+        //! @param message Description of the overrun.
+        LimitExceeded(LimitCode code, const std::string &message);
+
+        //! Gets the limit that was exceeded.
+        //! @return The limit.
+        LimitCode code() const;
+
+    private:
+        LimitCode code_; //!< The limit that was exceeded.
+    };
+
+    //! Keeps count of the resources used while a document is read and
+    //! throws LimitExceeded as soon as one goes over its limit.
+    class LimitGuard
+    {
+    public:
+        //! Starts counting; the wall time is measured from now.
+        //! @param limits The limits to enforce.
+        explicit LimitGuard(const ResourceLimits &limits);
+
+        //! Counts an element and its vertices.
+        //! @param vertices Vertices of the element.
+        void add_element(unsigned long long vertices);
+
+        //! Counts the copy of an element made by a use reference, with
+        //! the members of a copied group, before the copy is made.
+        //! @param elem The referenced element.
+        void add_use_copy(const SVGElement &elem);
+
+        //! Checks the nesting depth of a group's members.
+        //! @param depth Depth of the members (1 for top-level elements).
+        void check_depth(int depth) const;
+
+        //! Checks the size of the output canvas, which must also have a
+        //! positive width and height.
+        //! @param width Canvas width.
+        //! @param height Canvas height.
+        void check_canvas(double width, double height) const;
+
+        //! Checks the wall time.
+        void check_time() const;
+
+    private:
+        ResourceLimits limits;                       //!< The limits.
+        std::chrono::steady_clock::time_point start; //!< Start of the conversion.
+        unsigned long long elements = 0;             //!< Elements so far.
+        unsigned long long vertices = 0;             //!< Vertices so far.
+        unsigned long long use_copies = 0;           //!< Elements copied by use so far.
+    };
+}
+#endif
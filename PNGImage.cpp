@@ -1,10 +1,15 @@
 #include "PNGImage.hpp"
+#include "EllipseCache.hpp"
+#include "Gradient.hpp"
 
 #include <stdexcept>
 #include <cmath>
+#include <cstddef>
 #include <cstring>
 #include <algorithm>
 #include <cassert>
+#include <cstdlib>
+#include <new>
 
 #define STBI_ONLY_PNG
 #define STB_IMAGE_IMPLEMENTATION
@@ -17,36 +22,158 @@ namespace svg
     PNGImage::PNGImage(const std::string &png_file_name)
     {
         int dummy;
-        pixels_ = (Color *)::stbi_load(png_file_name.c_str(),
-                                       &width_, &height_,
-                                       &dummy, 3);
-        if (pixels_ == nullptr)
+        unsigned char *rgba = ::stbi_load(png_file_name.c_str(),
+                                          &width_, &height_,
+                                          &dummy, 4);
+        if (rgba == nullptr)
         {
             throw std::runtime_error(png_file_name + ": could not load image!");
         }
+        allocate(0);
+        for (int y = 0; y < height_; y++)
+        {
+            Pixel *dst = row(y);
+            const unsigned char *src = rgba + (size_t)y * width_ * 4;
+            for (int x = 0; x < width_; x++, src += 4)
+            {
+                dst[x] = pack_pixel({src[0], src[1], src[2]});
+            }
+        }
+        stbi_image_free(rgba);
     }
-    PNGImage::PNGImage(int w, int h)
+    PNGImage::PNGImage(int w, int h, int stride)
     {
-        assert(w > 0 && h > 0);
-        size_t sz = w * h * sizeof(Color);
-        pixels_ = (Color *)::stbi__malloc(sz);
+        if (w <= 0 || h <= 0)
+        {
+            throw std::runtime_error("Image dimensions must be positive");
+        }
+        assert(stride == 0 || stride >= w);
         width_ = w;
         height_ = h;
-        ::memset(pixels_, 0xFF, sz);
+        allocate(stride);
+        fill({255, 255, 255});
+    }
+    PNGImage::PNGImage(void *pixels, int w, int h, int stride_bytes, PixelFormat format)
+        : width_(w), height_(h), pixels_((Pixel *)pixels), owns_pixels_(false), format_(format)
+    {
+        if (w <= 0 || h <= 0)
+        {
+            throw std::runtime_error("Image dimensions must be positive");
+        }
+        if ((std::uintptr_t)pixels % alignof(Pixel) != 0 ||
+            stride_bytes % (int)sizeof(Pixel) != 0 ||
+            stride_bytes / (int)sizeof(Pixel) < w)
+        {
+            throw std::runtime_error("Pixel memory must be 4-byte aligned, with a stride of at least 4 * width bytes");
+        }
+        stride_ = stride_bytes / (int)sizeof(Pixel);
+    }
+    void PNGImage::fill(const Color &c)
+    {
+        const Pixel p = pack_pixel(c, format_);
+        for (int y = 0; y < height_; y++)
+        {
+            std::fill_n(row(y), width_, p);
+        }
+    }
+    void PNGImage::set_top(int top)
+    {
+        top_ = top;
+    }
+    int PNGImage::top() const
+    {
+        return top_;
+    }
+    void PNGImage::set_left(int left)
+    {
+        left_ = left;
+    }
+    int PNGImage::left() const
+    {
+        return left_;
+    }
+    void PNGImage::allocate(int stride)
+    {
+        const int per_line = ROW_ALIGNMENT / (int)sizeof(Pixel);
+        if (stride == 0)
+        {
+            stride = width_;
+        }
+        stride_ = (stride + per_line - 1) / per_line * per_line;
+        size_t sz = (size_t)stride_ * (size_t)height_ * sizeof(Pixel);
+        void *mem = nullptr;
+        if (::posix_memalign(&mem, ROW_ALIGNMENT, sz) != 0)
+        {
+            throw std::bad_alloc();
+        }
+        pixels_ = (Pixel *)mem;
+    }
+    std::vector<unsigned char> PNGImage::to_rgb() const
+    {
+        std::vector<unsigned char> rgb((size_t)width_ * height_ * 3);
+        unsigned char *dst = rgb.data();
+        for (int y = 0; y < height_; y++)
+        {
+            const Pixel *src = row(y);
+            if (format_ == PixelFormat::RGBX)
+            {
+                for (int x = 0; x < width_; x++, dst += 3)
+                {
+                    std::memcpy(dst, &src[x], 3);
+                }
+                continue;
+            }
+            for (int x = 0; x < width_; x++, dst += 3)
+            {
+                Color c = unpack_pixel(src[x], format_);
+                dst[0] = c.red;
+                dst[1] = c.green;
+                dst[2] = c.blue;
+            }
+        }
+        return rgb;
     }
     void PNGImage::save(const std::string &png_file_name) const
     {
-        ::stbi_write_png(png_file_name.c_str(),
-                         width_,
-                         height_,
-                         3,
-                         pixels_,
-                         width_ * 3);
+        std::vector<unsigned char> rgb = to_rgb();
+        if (::stbi_write_png(png_file_name.c_str(),
+                             width_,
+                             height_,
+                             3,
+                             rgb.data(),
+                             width_ * 3) == 0)
+        {
+            throw std::runtime_error("Unable to write " + png_file_name);
+        }
+    }
+    namespace
+    {
+        //! stb_image_write callback appending to a byte vector.
+        void append_bytes(void *context, void *data, int size)
+        {
+            std::vector<unsigned char> *png = (std::vector<unsigned char> *)context;
+            png->insert(png->end(), (unsigned char *)data, (unsigned char *)data + size);
+        }
+    }
+    void PNGImage::encode(std::vector<unsigned char> &png) const
+    {
+        std::vector<unsigned char> rgb = to_rgb();
+        png.clear();
+        ::stbi_write_png_to_func(append_bytes,
+                                 &png,
+                                 width_,
+                                 height_,
+                                 3,
+                                 rgb.data(),
+                                 width_ * 3);
     }
 
     PNGImage::~PNGImage()
     {
-        stbi_image_free(pixels_);
+        if (owns_pixels_)
+        {
+            ::free(pixels_);
+        }
     }
 
     int PNGImage::width() const
@@ -57,19 +184,329 @@ namespace svg
     {
         return height_;
     }
-    Color &PNGImage::at(int x, int y)
+    int PNGImage::stride() const
+    {
+        return stride_;
+    }
+    PixelFormat PNGImage::format() const
+    {
+        return format_;
+    }
+    unsigned long long PNGImage::pixels_written() const
+    {
+        return pixels_written_;
+    }
+    unsigned long long PNGImage::ellipse_profile_hits() const
+    {
+        return ellipse_profile_hits_;
+    }
+    unsigned long long PNGImage::ellipse_profile_misses() const
+    {
+        return ellipse_profile_misses_;
+    }
+    void PNGImage::track_overdraw()
+    {
+        overdraw_.assign((size_t)width_ * height_, 0);
+    }
+    bool PNGImage::tracks_overdraw() const
+    {
+        return !overdraw_.empty();
+    }
+    std::uint32_t PNGImage::overdraw(int x, int y) const
+    {
+        assert(x >= 0 && x < width_ && y >= 0 && y < height_);
+        return overdraw_.empty() ? 0 : overdraw_[(size_t)y * width_ + x];
+    }
+    Pixel *PNGImage::row(int y)
     {
-        assert(x >= 0 && x < width_);
         assert(y >= 0 && y < height_);
-        return pixels_[y * width_ + x];
+        return pixels_ + (size_t)y * stride_;
+    }
+    const Pixel *PNGImage::row(int y) const
+    {
+        assert(y >= 0 && y < height_);
+        return pixels_ + (size_t)y * stride_;
+    }
+    void PNGImage::set(int x, int y, const Color &c)
+    {
+        assert(x >= 0 && x < width_);
+        row(y)[x] = pack_pixel(c, format_);
     }
     Color PNGImage::at(int x, int y) const
     {
         assert(x >= 0 && x < width_);
-        assert(y >= 0 && y < height_);
-        return pixels_[y * width_ + x];
+        return unpack_pixel(row(y)[x], format_);
     }
+    void PNGImage::set_shader(const GradientShader *shader)
+    {
+        shader_ = shader;
+    }
+    Pixel PNGImage::shade_pixel(int x, int y) const
+    {
+        Pixel p;
+        shader_->shade(&p, x, y, 1);
+        return p;
+    }
+    void PNGImage::draw_span(int y, int x_from, int x_to, const Color &c)
+    {
+        if (x_from > x_to)
+        {
+            std::swap(x_from, x_to);
+        }
+        x_from -= left_;
+        x_to -= left_;
+        y -= top_;
+        if (y < 0 || y >= height_ || x_to < 0 || x_from >= width_)
+        {
+            return;
+        }
+        x_from = std::max(x_from, 0);
+        x_to = std::min(x_to, width_ - 1);
+        if (shader_ != nullptr)
+        {
+            shader_->shade(row(y) + x_from, x_from + left_, y + top_, x_to - x_from + 1);
+        }
+        else
+        {
+            std::fill_n(row(y) + x_from, x_to - x_from + 1, pack_pixel(c, format_));
+        }
+        pixels_written_ += x_to - x_from + 1;
+        if (!overdraw_.empty())
+        {
+            std::uint32_t *counts = &overdraw_[(size_t)y * width_];
+            for (int x = x_from; x <= x_to; x++)
+            {
+                counts[x]++;
+            }
+        }
+    }
+    void PNGImage::draw_rect(const Point &a, const Point &b, const Color &c)
+    {
+        const int x_from = std::max(std::min(a.x, b.x) - left_, 0);
+        const int x_to = std::min(std::max(a.x, b.x) - left_, width_ - 1);
+        const int y_from = std::max(std::min(a.y, b.y) - top_, 0);
+        const int y_to = std::min(std::max(a.y, b.y) - top_, height_ - 1);
+        if (x_from > x_to || y_from > y_to)
+        {
+            return;
+        }
+        const Pixel p = pack_pixel(c, format_);
+        const int n = x_to - x_from + 1;
+        for (int y = y_from; y <= y_to; y++)
+        {
+            if (shader_ != nullptr)
+            {
+                shader_->shade(row(y) + x_from, x_from + left_, y + top_, n);
+            }
+            else
+            {
+                std::fill_n(row(y) + x_from, n, p);
+            }
+        }
+        pixels_written_ += (unsigned long long)n * (y_to - y_from + 1);
+        if (!overdraw_.empty())
+        {
+            for (int y = y_from; y <= y_to; y++)
+            {
+                std::uint32_t *counts = &overdraw_[(size_t)y * width_];
+                for (int x = x_from; x <= x_to; x++)
+                {
+                    counts[x]++;
+                }
+            }
+        }
+    }
+    namespace
+    {
+        //! Floor of a / b, for b > 0.
+        long long floor_div(long long a, long long b)
+        {
+            return a >= 0 ? a / b : -((-a + b - 1) / b);
+        }
+
+        //! Narrows [t_lo, t_hi] to the steps t where c0 + step * t is in
+        //! [0, size - 1].
+        //! @param c0 Coordinate at step 0.
+        //! @param step Coordinate change per step (-1, 0 or 1).
+        //! @param size Number of valid coordinates.
+        //! @param t_lo First step, updated.
+        //! @param t_hi Last step, updated.
+        void clip_steps(long long c0, int step, int size, long long &t_lo, long long &t_hi)
+        {
+            if (step == 0)
+            {
+                if (c0 < 0 || c0 >= size)
+                {
+                    t_hi = t_lo - 1;
+                }
+            }
+            else if (step > 0)
+            {
+                t_lo = std::max(t_lo, -c0);
+                t_hi = std::min(t_hi, size - 1 - c0);
+            }
+            else
+            {
+                t_lo = std::max(t_lo, c0 - (size - 1));
+                t_hi = std::min(t_hi, c0);
+            }
+        }
+
+        //! Whether a subpixel point lies on whole pixel coordinates.
+        bool whole_pixel(const FixedPoint &p)
+        {
+            return p.x % SUBPIXEL_ONE == 0 && p.y % SUBPIXEL_ONE == 0;
+        }
+    }
+
     void PNGImage::draw_line(const Point &a, const Point &b, const Color &c)
+    {
+        // Bresenham lines, with a kernel per kind of line chosen once:
+        // horizontal lines are spans, vertical and 45 degree lines are
+        // strided stores, and other lines are clipped to the image before
+        // an unchecked stepping loop. All draw the pixels of the plotted
+        // loop, which is kept for overdraw tracking and shading.
+        const Pixel p = pack_pixel(c, format_);
+        if (!overdraw_.empty() || shader_ != nullptr)
+        {
+            draw_line_plotted(a, b, p);
+        }
+        else if (a.y == b.y)
+        {
+            draw_span(a.y, a.x, b.x, c);
+        }
+        else if (a.x == b.x || std::abs((long long)b.x - a.x) == std::abs((long long)b.y - a.y))
+        {
+            draw_run(a, b, p);
+        }
+        else
+        {
+            draw_sloped_line(a, b, p);
+        }
+    }
+
+    void PNGImage::draw_line(const FixedPoint &a, const FixedPoint &b, const Color &c)
+    {
+        if (whole_pixel(a) && whole_pixel(b))
+        {
+            draw_line(a.round(), b.round(), c);
+            return;
+        }
+        // One pixel per column (or row, for steep lines) between the rounded
+        // endpoints, at the line's exact position over that pixel center.
+        // Coordinates are clamped to 2^30 subpixels, so the products below
+        // stay within 63 bits.
+        const Pixel p = pack_pixel(c, format_);
+        const bool steep = std::abs((long long)b.y - a.y) > std::abs((long long)b.x - a.x);
+        const bool reverse = steep ? b.y < a.y : b.x < a.x;
+        const FixedPoint &from = reverse ? b : a, &to = reverse ? a : b;
+        const long long m0 = steep ? from.y : from.x, n0 = steep ? from.x : from.y;
+        const long long dm = (steep ? to.y : to.x) - m0, dn = (steep ? to.x : to.y) - n0;
+        const Point first = from.round(), last = to.round();
+        const int n_first = steep ? first.x : first.y, n_last = steep ? last.x : last.y;
+        const int n_min = std::min(n_first, n_last), n_max = std::max(n_first, n_last);
+        // columns (or rows) outside the image would be clipped anyway
+        const int lo = steep ? top_ : left_, hi = lo + (steep ? height_ : width_) - 1;
+        const int m_first = std::max(steep ? first.y : first.x, lo);
+        const int m_last = std::min(steep ? last.y : last.x, hi);
+        for (int m = m_first; m <= m_last; m++)
+        {
+            int n = n_first;
+            if (dm != 0)
+            {
+                // nearest pixel, halves up, kept within the endpoints' pixels
+                const long long num = n0 * dm + ((long long)m * SUBPIXEL_ONE - m0) * dn;
+                n = (int)floor_div(num + dm * (SUBPIXEL_ONE / 2), dm * SUBPIXEL_ONE);
+                n = std::min(std::max(n, n_min), n_max);
+            }
+            if (steep)
+            {
+                plot(n, m, p);
+            }
+            else
+            {
+                plot(m, n, p);
+            }
+        }
+    }
+
+    void PNGImage::draw_run(const Point &a, const Point &b, Pixel p)
+    {
+        const int step_x = b.x > a.x ? 1 : (b.x < a.x ? -1 : 0);
+        const int step_y = b.y > a.y ? 1 : -1;
+        const long long x0 = (long long)a.x - left_;
+        const long long y0 = (long long)a.y - top_;
+        long long t_lo = 0, t_hi = std::abs((long long)b.y - a.y);
+        clip_steps(x0, step_x, width_, t_lo, t_hi);
+        clip_steps(y0, step_y, height_, t_lo, t_hi);
+        if (t_lo > t_hi)
+        {
+            return;
+        }
+        const std::ptrdiff_t step = step_x + (std::ptrdiff_t)step_y * stride_;
+        Pixel *q = row((int)(y0 + step_y * t_lo)) + (x0 + step_x * t_lo);
+        for (long long t = t_lo; t <= t_hi; t++, q += step)
+        {
+            *q = p;
+        }
+        pixels_written_ += t_hi - t_lo + 1;
+    }
+
+    void PNGImage::draw_sloped_line(const Point &a, const Point &b, Pixel p)
+    {
+        // Along the major axis, step k moves the minor coordinate by
+        // floor((n + 2 k q) / 2 n), n and q being the major and minor
+        // distances: this is where the Bresenham error term crosses zero,
+        // so the steps inside the image are found without walking to them.
+        long long dx = (long long)b.x - a.x, dy = (long long)b.y - a.y;
+        const int step_x = dx < 0 ? -1 : 1, step_y = dy < 0 ? -1 : 1;
+        dx = std::abs(dx);
+        dy = std::abs(dy);
+        const bool x_major = dx > dy;
+        const long long n = x_major ? dx : dy, q = x_major ? dy : dx;
+        const long long major0 = x_major ? (long long)a.x - left_ : (long long)a.y - top_;
+        const long long minor0 = x_major ? (long long)a.y - top_ : (long long)a.x - left_;
+        const int major_step = x_major ? step_x : step_y, minor_step = x_major ? step_y : step_x;
+        const int major_size = x_major ? width_ : height_, minor_size = x_major ? height_ : width_;
+
+        long long k_lo = 0, k_hi = n;
+        clip_steps(major0, major_step, major_size, k_lo, k_hi);
+        // minor moves m in [m_lo, m_hi] keep the minor coordinate inside;
+        // the line only makes moves 0 to q
+        const long long m_lo = std::max(minor_step > 0 ? -minor0 : minor0 - (minor_size - 1), 0LL);
+        const long long m_hi = std::min(minor_step > 0 ? minor_size - 1 - minor0 : minor0, q);
+        if (m_lo > m_hi)
+        {
+            return;
+        }
+        k_lo = std::max(k_lo, -floor_div(n - 2 * n * m_lo, 2 * q));
+        k_hi = std::min(k_hi, -floor_div(-(2 * n * m_hi + n), 2 * q) - 1);
+        if (k_lo > k_hi)
+        {
+            return;
+        }
+
+        const long long m = floor_div(n + 2 * k_lo * q, 2 * n);
+        long long error = n + 2 * k_lo * q - 2 * n * m;
+        const long long major = major0 + major_step * k_lo, minor = minor0 + minor_step * m;
+        Pixel *r = x_major ? row((int)minor) + major : row((int)major) + minor;
+        const std::ptrdiff_t major_stride = x_major ? major_step : (std::ptrdiff_t)major_step * stride_;
+        const std::ptrdiff_t minor_stride = x_major ? (std::ptrdiff_t)minor_step * stride_ : minor_step;
+        for (long long k = k_lo; k <= k_hi; k++)
+        {
+            *r = p;
+            r += major_stride;
+            error += 2 * q;
+            if (error >= 2 * n)
+            {
+                error -= 2 * n;
+                r += minor_stride;
+            }
+        }
+        pixels_written_ += k_hi - k_lo + 1;
+    }
+
+    void PNGImage::draw_line_plotted(const Point &a, const Point &b, Pixel p)
     {
         //  Bresenham Algorithm.
         int x_from = a.x;
@@ -91,7 +528,7 @@ namespace svg
         }
         dy *= 2;
         dx *= 2;
-        at(x_from, y_from) = c;
+        plot(x_from, y_from, p);
         if (dx > dy)
         {
             int fraction = dy - (dx / 2);
@@ -104,7 +541,7 @@ namespace svg
                 }
                 x_from += step_x;
                 fraction += dy;
-                at(x_from, y_from) = c;
+                plot(x_from, y_from, p);
             }
         }
         else
@@ -119,7 +556,7 @@ namespace svg
                 }
                 y_from += step_y;
                 fraction += dx;
-                at(x_from, y_from) = c;
+                plot(x_from, y_from, p);
             }
         }
     }
@@ -135,7 +572,14 @@ namespace svg
             y_max = std::max(y_max, p.y);
         }
 
-        std::vector<double> seg;
+        // rows outside the image would be clipped anyway
+        y_min = std::max(y_min, top_);
+        y_max = std::min(y_max, top_ + height_);
+
+        // scratch buffers are kept per thread, so drawing does not allocate
+        // once they have grown to the largest shape
+        static thread_local std::vector<double> seg;
+        seg.clear();
         for (int y = y_min; y < y_max; y++)
         {
             for (size_t i = 0; i < points.size(); i++)
@@ -156,15 +600,15 @@ namespace svg
             size_t i_s = 0;
             while ((i_s + 1) < seg.size())
             {
-                Point a = {(int)round(seg.at(i_s)), y};
-                Point b = {(int)round(seg.at(i_s + 1)), y};
-                if (a.x == b.x)
+                int x_a = (int)round(seg.at(i_s));
+                int x_b = (int)round(seg.at(i_s + 1));
+                if (x_a == x_b)
                 {
                     i_s++;
                 }
                 else
                 {
-                    draw_line(a, b, c);
+                    draw_span(y, x_a, x_b, c);
                     i_s += 2;
                 }
             }
@@ -176,35 +620,676 @@ namespace svg
         }
     }
 
-    void PNGImage::draw_ellipse(const Point &center, const Point &radius, const Color &fill)
+    bool PNGImage::is_convex(const std::vector<Point> &points)
+    {
+        const size_t n = points.size();
+        if (n < 3)
+        {
+            return false;
+        }
+        int turn = 0, first_dir = 0, dir = 0, dir_changes = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            const Point &a = points[i];
+            const Point &b = points[(i + 1) % n];
+            const Point &c = points[(i + 2) % n];
+            long long cross = (long long)(b.x - a.x) * (c.y - b.y) - (long long)(b.y - a.y) * (c.x - b.x);
+            if (cross == 0)
+            {
+                return false;
+            }
+            int sign = cross > 0 ? 1 : -1;
+            if (turn != 0 && sign != turn)
+            {
+                return false;
+            }
+            turn = sign;
+            if (b.y != a.y)
+            {
+                int d = b.y > a.y ? 1 : -1;
+                if (dir == 0)
+                {
+                    first_dir = d;
+                }
+                else if (d != dir)
+                {
+                    dir_changes++;
+                }
+                dir = d;
+            }
+        }
+        // A polygon turning one way that winds more than once (like a
+        // pentagram) goes down and up more than once.
+        if (dir != first_dir)
+        {
+            dir_changes++;
+        }
+        return dir_changes == 2;
+    }
+
+    void PNGImage::draw_convex_polygon(const std::vector<Point> &points, const Color &c)
     {
-        draw_line(center.translate({-radius.x, 0}),
-                  center.translate({+radius.x, 0}),
-                  fill);
+        // Each row of a convex polygon meets the outline at its left and
+        // right ends only, and vertices are met exactly, so the crossings
+        // draw_polygon sorts always pair into one span, from the leftmost
+        // to the rightmost, unless both round to the same pixel. Crossings
+        // are computed with the same expression, over the edge in outline
+        // order, so that they round the same way.
+        const size_t n = points.size();
+        size_t top = 0, bottom = 0;
+        for (size_t i = 1; i < n; i++)
+        {
+            if (points[i].y < points[top].y)
+            {
+                top = i;
+            }
+            if (points[i].y > points[bottom].y)
+            {
+                bottom = i;
+            }
+        }
+        // draw_polygon starts its row range at 0, so it also fills the
+        // bottom row of polygons that lie entirely above row 0
+        const int y_min = std::max(points[top].y, top_);
+        const int y_max = std::min(points[bottom].y < 0 ? points[bottom].y + 1 : points[bottom].y,
+                                   top_ + height_);
+        // edge i runs from points[i] to points[i + 1]; one chain walks
+        // forward from the top vertex and the other backward
+        size_t fwd = top;
+        size_t back = (top + n - 1) % n;
+        auto skip = [&](size_t i, int y)
+        {
+            const Point &a = points[i];
+            const Point &b = points[(i + 1) % n];
+            return a.y == b.y || std::max(a.y, b.y) < y;
+        };
+        auto cross = [&](size_t i, int y)
+        {
+            const Point &a = points[i];
+            const Point &b = points[(i + 1) % n];
+            return (double)(y - a.y) * (b.x - a.x) / (double)(b.y - a.y) + a.x;
+        };
+        for (int y = y_min; y < y_max; y++)
+        {
+            while (skip(fwd, y))
+            {
+                fwd = (fwd + 1) % n;
+            }
+            while (skip(back, y))
+            {
+                back = (back + n - 1) % n;
+            }
+            double x_fwd = cross(fwd, y), x_back = cross(back, y);
+            int x_a = (int)round(std::min(x_fwd, x_back));
+            int x_b = (int)round(std::max(x_fwd, x_back));
+            if (x_a != x_b)
+            {
+                draw_span(y, x_a, x_b, c);
+            }
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            draw_line(points[i], points[(i + 1) % n], c);
+        }
+    }
+
+    void PNGImage::draw_contours(const std::vector<Point> &points,
+                                 const std::vector<size_t> &contour_ends,
+                                 const Color &fill,
+                                 bool even_odd)
+    {
+        // Edges are oriented top to bottom and cover rows y_top <= y < y_bottom.
+        struct Edge
+        {
+            int y_top, y_bottom;
+            double x_top, slope;
+            int winding;
+        };
+        static thread_local std::vector<Edge> edges;
+        edges.clear();
+        size_t begin = 0;
+        for (size_t end : contour_ends)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                Point a = points[i];
+                Point b = points[i + 1 < end ? i + 1 : begin];
+                if (a.y == b.y)
+                {
+                    continue;
+                }
+                int winding = 1;
+                if (a.y > b.y)
+                {
+                    std::swap(a, b);
+                    winding = -1;
+                }
+                edges.push_back({a.y, b.y, (double)a.x,
+                                 (double)(b.x - a.x) / (double)(b.y - a.y), winding});
+            }
+            begin = end;
+        }
+        if (edges.empty())
+        {
+            return;
+        }
+        std::sort(edges.begin(), edges.end(), [](const Edge &l, const Edge &r)
+                  { return l.y_top < r.y_top; });
+        int y_end = top_ + height_;
+        int y = std::max(edges.front().y_top, top_);
+        static thread_local std::vector<const Edge *> active;
+        static thread_local std::vector<std::pair<double, int>> crossings;
+        active.clear();
+        size_t next = 0;
+        for (; y < y_end; y++)
+        {
+            active.erase(std::remove_if(active.begin(), active.end(), [y](const Edge *e)
+                                        { return e->y_bottom <= y; }),
+                         active.end());
+            for (; next < edges.size() && edges[next].y_top <= y; next++)
+            {
+                if (edges[next].y_bottom > y)
+                {
+                    active.push_back(&edges[next]);
+                }
+            }
+            if (active.empty())
+            {
+                if (next == edges.size())
+                {
+                    break;
+                }
+                y = std::max(y, edges[next].y_top - 1);
+                continue;
+            }
+            crossings.clear();
+            for (const Edge *e : active)
+            {
+                crossings.push_back({e->x_top + (y - e->y_top) * e->slope, e->winding});
+            }
+            std::sort(crossings.begin(), crossings.end());
+            int winding = 0;
+            for (size_t i = 0; i + 1 < crossings.size(); i++)
+            {
+                winding += even_odd ? 1 : crossings[i].second;
+                bool inside = even_odd ? (winding & 1) != 0 : winding != 0;
+                if (inside)
+                {
+                    int x_from = (int)::ceil(crossings[i].first);
+                    int x_to = (int)::ceil(crossings[i + 1].first) - 1;
+                    if (x_from <= x_to)
+                    {
+                        draw_span(y, x_from, x_to, fill);
+                    }
+                }
+            }
+        }
+    }
+
+    namespace
+    {
+        //! Edge of a subpixel outline, stepped one row at a time in exact
+        //! integer arithmetic. At the current row its crossing is the
+        //! subpixel x = q + r / den, with 0 <= r < den.
+        struct SubpixelEdge
+        {
+            int y_first, y_last;    //!< Rows sampled, inclusive.
+            int winding;            //!< 1 if the edge runs down, -1 if up.
+            FixedPoint top;         //!< End with the smaller y.
+            long long dx, den;      //!< Run and rise, in subpixels (den > 0).
+            long long step_q;       //!< Whole subpixels crossed per row.
+            long long step_r;       //!< Remainder crossed per row.
+            long long q, r;         //!< Crossing at the current row.
+
+            //! Moves the crossing to the center of row y.
+            void start(int y)
+            {
+                const long long n = ((long long)y * SUBPIXEL_ONE - top.y) * dx;
+                const long long f = floor_div(n, den);
+                q = top.x + f;
+                r = n - f * den;
+            }
+
+            //! Moves the crossing one row down.
+            void advance()
+            {
+                q += step_q;
+                r += step_r;
+                if (r >= den)
+                {
+                    r -= den;
+                    q++;
+                }
+            }
+
+            //! Nearest pixel column, with halves away from zero.
+            int round_x() const
+            {
+                const int half = SUBPIXEL_ONE / 2;
+                return q >= 0 ? (int)floor_div(q + half, SUBPIXEL_ONE)
+                              : -(int)floor_div(half - q - (r > 0), SUBPIXEL_ONE);
+            }
+
+            //! First pixel column whose center is at or right of the crossing.
+            int ceil_x() const
+            {
+                return (int)floor_div(q - (r == 0), SUBPIXEL_ONE) + 1;
+            }
+        };
+
+        //! Ceiling of a / b, for b > 0.
+        long long ceil_div(long long a, long long b)
+        {
+            return -floor_div(-a, b);
+        }
+
+        //! Sets up an edge from a to b, if it is not horizontal.
+        //! @param inclusive Whether the row of the lower end is sampled.
+        //! @return True if the edge samples at least one row.
+        bool make_edge(FixedPoint a, FixedPoint b, bool inclusive, SubpixelEdge &e)
+        {
+            if (a.y == b.y)
+            {
+                return false;
+            }
+            e.winding = 1;
+            if (a.y > b.y)
+            {
+                std::swap(a, b);
+                e.winding = -1;
+            }
+            e.y_first = (int)ceil_div(a.y, SUBPIXEL_ONE);
+            e.y_last = inclusive ? (int)floor_div(b.y, SUBPIXEL_ONE) : (int)ceil_div(b.y, SUBPIXEL_ONE) - 1;
+            if (e.y_first > e.y_last)
+            {
+                return false;
+            }
+            e.top = a;
+            e.dx = (long long)b.x - a.x;
+            e.den = (long long)b.y - a.y;
+            e.step_q = floor_div(e.dx * SUBPIXEL_ONE, e.den);
+            e.step_r = e.dx * SUBPIXEL_ONE - e.step_q * e.den;
+            return true;
+        }
+
+        //! Sorts a short list of integers.
+        void sort_crossings(std::vector<int> &xs)
+        {
+            if (xs.size() > 16)
+            {
+                std::sort(xs.begin(), xs.end());
+                return;
+            }
+            for (size_t i = 1; i < xs.size(); i++)
+            {
+                const int v = xs[i];
+                size_t j = i;
+                for (; j > 0 && xs[j - 1] > v; j--)
+                {
+                    xs[j] = xs[j - 1];
+                }
+                xs[j] = v;
+            }
+        }
+
+        //! Gathers the edges sampled by rows [y_begin, y_end), sorted by
+        //! their first row.
+        void gather_edges(std::vector<SubpixelEdge> &edges, int y_begin, int y_end)
+        {
+            edges.erase(std::remove_if(edges.begin(), edges.end(), [&](const SubpixelEdge &e)
+                                       { return e.y_last < y_begin || e.y_first >= y_end; }),
+                        edges.end());
+            std::sort(edges.begin(), edges.end(), [](const SubpixelEdge &l, const SubpixelEdge &r)
+                      { return l.y_first < r.y_first; });
+        }
+    }
+
+    void PNGImage::draw_polygon(const std::vector<FixedPoint> &points, const Color &c)
+    {
+        // Same rules as the integer version, with rows sampled at pixel
+        // centers: an edge meets every row from its top end to its bottom
+        // end, both included, and each crossing rounds to the nearest
+        // column. Crossings are stepped exactly, so whole-pixel points
+        // give the same pixels as the integer version.
+        if (points.empty())
+        {
+            return;
+        }
+        int y_min = points[0].y, y_max = points[0].y;
+        for (const FixedPoint &p : points)
+        {
+            y_min = std::min(y_min, p.y);
+            y_max = std::max(y_max, p.y);
+        }
+        const int y_begin = std::max((int)std::min((long long)height(), ceil_div(y_min, SUBPIXEL_ONE)), top_);
+        const int y_end = (int)std::min(std::max(0LL, ceil_div(y_max, SUBPIXEL_ONE)), (long long)top_ + height_);
+
+        static thread_local std::vector<SubpixelEdge> edges;
+        static thread_local std::vector<SubpixelEdge *> active;
+        static thread_local std::vector<int> seg;
+        edges.clear();
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            SubpixelEdge e;
+            if (make_edge(points[i], points[(i + 1) % points.size()], true, e))
+            {
+                edges.push_back(e);
+            }
+        }
+        gather_edges(edges, y_begin, y_end);
+        active.clear();
+        size_t next = 0;
+        for (int y = y_begin; y < y_end; y++)
+        {
+            active.erase(std::remove_if(active.begin(), active.end(), [y](const SubpixelEdge *e)
+                                        { return e->y_last < y; }),
+                         active.end());
+            for (; next < edges.size() && edges[next].y_first <= y; next++)
+            {
+                edges[next].start(y);
+                active.push_back(&edges[next]);
+            }
+            if (active.empty())
+            {
+                if (next == edges.size())
+                {
+                    break;
+                }
+                y = edges[next].y_first - 1;
+                continue;
+            }
+            seg.clear();
+            for (SubpixelEdge *e : active)
+            {
+                seg.push_back(e->round_x());
+                e->advance();
+            }
+            sort_crossings(seg);
+            size_t i_s = 0;
+            while ((i_s + 1) < seg.size())
+            {
+                if (seg[i_s] == seg[i_s + 1])
+                {
+                    i_s++;
+                }
+                else
+                {
+                    draw_span(y, seg[i_s], seg[i_s + 1], c);
+                    i_s += 2;
+                }
+            }
+        }
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            draw_line(points[i], points[(i + 1) % points.size()], c);
+        }
+    }
+
+    void PNGImage::draw_contours(const std::vector<FixedPoint> &points,
+                                 const std::vector<size_t> &contour_ends,
+                                 const Color &fill,
+                                 bool even_odd)
+    {
+        // Edges sample the rows whose centers are in [top, bottom).
+        static thread_local std::vector<SubpixelEdge> edges;
+        static thread_local std::vector<SubpixelEdge *> active;
+        static thread_local std::vector<std::pair<int, int>> crossings;
+        edges.clear();
+        size_t begin = 0;
+        for (size_t end : contour_ends)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                SubpixelEdge e;
+                if (make_edge(points[i], points[i + 1 < end ? i + 1 : begin], false, e))
+                {
+                    edges.push_back(e);
+                }
+            }
+            begin = end;
+        }
+        gather_edges(edges, top_, top_ + height_);
+        if (edges.empty())
+        {
+            return;
+        }
+        active.clear();
+        size_t next = 0;
+        for (int y = std::max(edges.front().y_first, top_); y < top_ + height_; y++)
+        {
+            active.erase(std::remove_if(active.begin(), active.end(), [y](const SubpixelEdge *e)
+                                        { return e->y_last < y; }),
+                         active.end());
+            for (; next < edges.size() && edges[next].y_first <= y; next++)
+            {
+                edges[next].start(y);
+                active.push_back(&edges[next]);
+            }
+            if (active.empty())
+            {
+                if (next == edges.size())
+                {
+                    break;
+                }
+                y = edges[next].y_first - 1;
+                continue;
+            }
+            // crossings with the same first column bound no pixel between
+            // them, so their order does not matter
+            crossings.clear();
+            for (SubpixelEdge *e : active)
+            {
+                crossings.push_back({e->ceil_x(), e->winding});
+                e->advance();
+            }
+            std::sort(crossings.begin(), crossings.end());
+            int winding = 0;
+            for (size_t i = 0; i + 1 < crossings.size(); i++)
+            {
+                winding += even_odd ? 1 : crossings[i].second;
+                bool inside = even_odd ? (winding & 1) != 0 : winding != 0;
+                if (inside && crossings[i].first < crossings[i + 1].first)
+                {
+                    draw_span(y, crossings[i].first, crossings[i + 1].first - 1, fill);
+                }
+            }
+        }
+    }
+
+    namespace
+    {
+        //! Largest radius handled by the integer ellipse rasterizer
+        //! (keeps rx^2 * ry^2 within 64 bits).
+        const int MAX_INTEGER_RADIUS = 40000;
+
+        //! Inside test of the original floating-point ellipse rasterizer.
+        //! Only consulted on exact boundary ties, where rounding decides
+        //! the outcome, so that output stays identical to earlier versions.
+        bool legacy_inside(int x, int y, const Point &radius)
+        {
+            double vy = (double)y / (double)radius.y;
+            double vx = (double)x / (double)radius.x;
+            return vx * vx + vy * vy <= 1;
+        }
+    }
+
+    void PNGImage::draw_ellipse(const Point &center, const Point &radius, const Color &fill, int orientation)
+    {
+        orientation %= 180;
+        if (orientation < 0)
+        {
+            orientation += 180;
+        }
+        if (orientation == 0 || radius.x == radius.y)
+        {
+            draw_axis_ellipse(center, radius, fill);
+        }
+        else if (orientation == 90)
+        {
+            draw_axis_ellipse(center, {radius.y, radius.x}, fill);
+        }
+        else
+        {
+            draw_rotated_ellipse(center, radius, orientation, fill);
+        }
+    }
+
+    void PNGImage::draw_ellipse(const FixedPoint &center, const FixedPoint &radius, const Color &fill, int orientation)
+    {
+        if (whole_pixel(center) && whole_pixel(radius))
+        {
+            draw_ellipse(center.round(), radius.round(), fill, orientation);
+            return;
+        }
+        orientation %= 180;
+        if (orientation < 0)
+        {
+            orientation += 180;
+        }
+        draw_subpixel_ellipse(center, radius, orientation, fill);
+    }
+
+    std::vector<int> PNGImage::axis_ellipse_profile(const Point &radius)
+    {
+        // Incremental midpoint scan: err holds x^2 ry^2 + y^2 rx^2 - rx^2 ry^2
+        // for the current candidate x, so the point is inside when err <= 0.
+        const long long rx2 = (long long)radius.x * radius.x;
+        const long long ry2 = (long long)radius.y * radius.y;
+        const long long rx2ry2 = rx2 * ry2;
+        std::vector<int> profile(1, radius.x);
+        profile.reserve(std::max(radius.y, 0) + 1);
         int x0 = radius.x;
         int dx = 0;
+        long long y_term = 0;
         for (int y = 1; y <= radius.y; y++)
         {
-            double vy = (double)y / (double)radius.y;
-            vy *= vy;
+            y_term += (2LL * y - 1) * rx2;
+            // the step between rows never shrinks by more than one pixel
             int x1 = x0 - (dx - 1);
-            for (; x1 > 0; x1--)
+            long long err = (long long)x1 * x1 * ry2 + y_term - rx2ry2;
+            while (x1 > 0 && (err > 0 || (err == 0 && !legacy_inside(x1, y, radius))))
             {
-                double vx = (double)x1 / (double)radius.x;
-                vx *= vx;
-                if (vx + vy <= 1)
-                {
-                    break;
-                }
+                err -= (2LL * x1 - 1) * ry2;
+                x1--;
             }
             dx = x0 - x1;
             x0 = x1;
-            draw_line(center.translate({-x0, -y}),
-                      center.translate({+x0, -y}),
-                      fill);
-            draw_line(center.translate({-x0, +y}),
-                      center.translate({+x0, +y}),
-                      fill);
+            profile.push_back(x0);
+        }
+        return profile;
+    }
+
+    void PNGImage::draw_axis_ellipse(const Point &center, const Point &radius, const Color &fill)
+    {
+        if (radius.x > MAX_INTEGER_RADIUS || radius.y > MAX_INTEGER_RADIUS)
+        {
+            draw_rotated_ellipse(center, radius, 0, fill);
+            return;
+        }
+        bool hit = false;
+        const std::vector<int> *cached = EllipseProfileCache::shared().get(radius, &hit);
+        (hit ? ellipse_profile_hits_ : ellipse_profile_misses_)++;
+        std::vector<int> computed;
+        if (cached == nullptr)
+        {
+            computed = axis_ellipse_profile(radius);
+        }
+        const std::vector<int> &profile = cached != nullptr ? *cached : computed;
+        draw_span(center.y, center.x - profile[0], center.x + profile[0], fill);
+        // only the rows inside the image are replayed, above then below the center
+        const int last = (int)profile.size() - 1;
+        const int bottom = top_ + height_ - 1;
+        for (int y = std::max(1, center.y - bottom); y <= std::min(last, center.y - top_); y++)
+        {
+            draw_span(center.y - y, center.x - profile[y], center.x + profile[y], fill);
+        }
+        for (int y = std::max(1, top_ - center.y); y <= std::min(last, bottom - center.y); y++)
+        {
+            draw_span(center.y + y, center.x - profile[y], center.x + profile[y], fill);
+        }
+    }
+
+    void PNGImage::draw_rotated_ellipse(const Point &center, const Point &radius, int degrees, const Color &fill)
+    {
+        const Point r = {std::abs(radius.x), std::abs(radius.y)};
+        if (r.x == 0 || r.y == 0)
+        {
+            // degenerate ellipse: a rotated segment
+            Point tip = r.rotate({0, 0}, degrees);
+            draw_line(center.translate({-tip.x, -tip.y}), center.translate(tip), fill);
+            return;
+        }
+        const double angle = M_PI * degrees / 180.0;
+        // Implicit form A u^2 + B u v + C v^2 <= 1, with (u, v) relative to
+        // the center; each row is solved for its [u_lo, u_hi] span.
+        const double c = ::cos(angle), s = ::sin(angle);
+        const double irx2 = 1.0 / ((double)r.x * r.x);
+        const double iry2 = 1.0 / ((double)r.y * r.y);
+        const double A = c * c * irx2 + s * s * iry2;
+        const double B = 2.0 * c * s * (irx2 - iry2);
+        const double C = s * s * irx2 + c * c * iry2;
+        const double v_max = ::sqrt(4.0 * A / (4.0 * A * C - B * B));
+        const int v_end = (int)::floor(v_max);
+        // rows outside the image would be clipped anyway
+        const int v_first = std::max(-v_end, top_ - center.y);
+        const int v_last = std::min(v_end, top_ + height_ - 1 - center.y);
+        for (int v = v_first; v <= v_last; v++)
+        {
+            double disc = B * B * v * v - 4.0 * A * (C * v * v - 1.0);
+            if (disc < 0)
+            {
+                continue;
+            }
+            double root = ::sqrt(disc);
+            int u_lo = (int)::ceil((-B * v - root) / (2.0 * A));
+            int u_hi = (int)::floor((-B * v + root) / (2.0 * A));
+            if (u_lo <= u_hi)
+            {
+                draw_span(center.y + v, center.x + u_lo, center.x + u_hi, fill);
+            }
+        }
+    }
+
+    void PNGImage::draw_subpixel_ellipse(const FixedPoint &center, const FixedPoint &radius, int degrees, const Color &fill)
+    {
+        const FixedPoint r = {std::abs(radius.x), std::abs(radius.y)};
+        if (r.x == 0 || r.y == 0)
+        {
+            // degenerate ellipse: a rotated segment
+            const FixedPoint tip = r.rotate({0, 0}, degrees);
+            draw_line(center.translate({-tip.x, -tip.y}), center.translate(tip), fill);
+            return;
+        }
+        // Same implicit form as draw_rotated_ellipse, solved at the pixel
+        // centers of each row relative to the fractional center.
+        const double angle = M_PI * degrees / 180.0;
+        const double c = ::cos(angle), s = ::sin(angle);
+        const double cx = (double)center.x / SUBPIXEL_ONE, cy = (double)center.y / SUBPIXEL_ONE;
+        const double rx = (double)r.x / SUBPIXEL_ONE, ry = (double)r.y / SUBPIXEL_ONE;
+        const double irx2 = 1.0 / (rx * rx);
+        const double iry2 = 1.0 / (ry * ry);
+        const double A = c * c * irx2 + s * s * iry2;
+        const double B = 2.0 * c * s * (irx2 - iry2);
+        const double C = s * s * irx2 + c * c * iry2;
+        const double v_max = ::sqrt(4.0 * A / (4.0 * A * C - B * B));
+        // rows outside the image would be clipped anyway
+        const int y_first = std::max((int)::ceil(cy - v_max), top_);
+        const int y_last = std::min((int)::floor(cy + v_max), top_ + height_ - 1);
+        for (int y = y_first; y <= y_last; y++)
+        {
+            const double v = y - cy;
+            double disc = B * B * v * v - 4.0 * A * (C * v * v - 1.0);
+            if (disc < 0)
+            {
+                continue;
+            }
+            double root = ::sqrt(disc);
+            int x_lo = (int)::ceil(cx + (-B * v - root) / (2.0 * A));
+            int x_hi = (int)::floor(cx + (-B * v + root) / (2.0 * A));
+            if (x_lo <= x_hi)
+            {
+                draw_span(y, x_lo, x_hi, fill);
+            }
         }
     }
 
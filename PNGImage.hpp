@@ -5,15 +5,108 @@
 #include "Color.hpp"
 #include "Point.hpp"
 
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 
 namespace svg
 {
+    //! Internal 32-bit pixel: bytes R, G, B, X in memory order.
+    //! The fourth byte is reserved (always 0xFF) so that alpha
+    //! can be supported later without changing the layout.
+    typedef std::uint32_t Pixel;
+
+    //! Pack a color into the internal 32-bit pixel layout.
+    //! @param c Color.
+    //! @return Packed pixel.
+    inline Pixel pack_pixel(const Color &c)
+    {
+        const unsigned char bytes[4] = {c.red, c.green, c.blue, 0xFF};
+        Pixel p;
+        std::memcpy(&p, bytes, sizeof(p));
+        return p;
+    }
+
+    //! Unpack a 32-bit pixel into a color.
+    //! @param p Packed pixel.
+    //! @return Corresponding color.
+    inline Color unpack_pixel(Pixel p)
+    {
+        unsigned char bytes[4];
+        std::memcpy(bytes, &p, sizeof(p));
+        return {bytes[0], bytes[1], bytes[2]};
+    }
+
+    //! Byte order of 32-bit pixels in memory. The X byte is always
+    //! written as 0xFF, so it can also serve as an opaque alpha channel.
+    enum class PixelFormat
+    {
+        RGBX, //!< Bytes R, G, B, X (the internal layout).
+        BGRX, //!< Bytes B, G, R, X.
+        XRGB, //!< Bytes X, R, G, B.
+        XBGR  //!< Bytes X, B, G, R.
+    };
+
+    //! Pack a color into a 32-bit pixel of a given format.
+    //! @param c Color.
+    //! @param format Pixel format.
+    //! @return Packed pixel.
+    inline Pixel pack_pixel(const Color &c, PixelFormat format)
+    {
+        unsigned char bytes[4];
+        switch (format)
+        {
+        case PixelFormat::BGRX:
+            bytes[0] = c.blue, bytes[1] = c.green, bytes[2] = c.red, bytes[3] = 0xFF;
+            break;
+        case PixelFormat::XRGB:
+            bytes[0] = 0xFF, bytes[1] = c.red, bytes[2] = c.green, bytes[3] = c.blue;
+            break;
+        case PixelFormat::XBGR:
+            bytes[0] = 0xFF, bytes[1] = c.blue, bytes[2] = c.green, bytes[3] = c.red;
+            break;
+        default:
+            return pack_pixel(c);
+        }
+        Pixel p;
+        std::memcpy(&p, bytes, sizeof(p));
+        return p;
+    }
+
+    //! Unpack a 32-bit pixel of a given format into a color.
+    //! @param p Packed pixel.
+    //! @param format Pixel format.
+    //! @return Corresponding color.
+    inline Color unpack_pixel(Pixel p, PixelFormat format)
+    {
+        unsigned char bytes[4];
+        std::memcpy(bytes, &p, sizeof(p));
+        switch (format)
+        {
+        case PixelFormat::BGRX:
+            return {bytes[2], bytes[1], bytes[0]};
+        case PixelFormat::XRGB:
+            return {bytes[1], bytes[2], bytes[3]};
+        case PixelFormat::XBGR:
+            return {bytes[3], bytes[2], bytes[1]};
+        default:
+            return {bytes[0], bytes[1], bytes[2]};
+        }
+    }
+
+    class GradientShader;
+
     //! PNG image.
+    //! Pixels are kept in a 32-bit RGBX layout with every row starting
+    //! on a cache line boundary; conversion to packed RGB only happens
+    //! when the image is saved. An image can also draw straight into
+    //! memory owned by the caller, in any PixelFormat.
     class PNGImage
     {
     public:
+        //! Row alignment in bytes.
+        static const int ROW_ALIGNMENT = 64;
         //! Constructor that loads image from a file.
         //! @param png_file_name File name.
         PNGImage(const std::string &png_file_name);
@@ -21,51 +114,283 @@ namespace svg
         //! Initally, all pixels will be white.
         //! @param w Image width.
         //! @param h Image height.
-        PNGImage(int w, int h);
+        //! @param stride Row stride in pixels (0 for the default);
+        //! rounded up so that rows stay aligned.
+        PNGImage(int w, int h, int stride = 0);
+        //! Constructor of an image that draws into caller-owned memory.
+        //! The memory is neither cleared nor freed by the image, and
+        //! must outlive it.
+        //! @param pixels First pixel of the first row (4-byte aligned).
+        //! @param w Image width.
+        //! @param h Image height.
+        //! @param stride_bytes Distance between rows, in bytes (a multiple
+        //! of 4, at least 4 * w).
+        //! @param format Byte order of the pixels.
+        PNGImage(void *pixels, int w, int h, int stride_bytes, PixelFormat format);
         //! Destructor.
         ~PNGImage();
+        //! Fill every pixel with a color.
+        //! This is not counted as drawing (see pixels_written).
+        //! @param c Color.
+        void fill(const Color &c);
+        //! Place the image over a horizontal band of a larger canvas.
+        //! Drawing routines take canvas coordinates and only touch the
+        //! rows from top to top + height() - 1; row(), set(), at() and
+        //! overdraw() keep addressing the stored rows from 0.
+        //! @param top Canvas row of the first image row.
+        void set_top(int top);
+        //! Get canvas row of the first image row.
+        //! @return The top row (0 unless set_top was called).
+        int top() const;
+        //! Place the image over a vertical band of a larger canvas, like
+        //! set_top() does for rows. Together they make the image a window
+        //! (a tile) anywhere on the canvas.
+        //! @param left Canvas column of the first image column.
+        void set_left(int left);
+        //! Get canvas column of the first image column.
+        //! @return The left column (0 unless set_left was called).
+        int left() const;
         //! Get image width.
         //! @return The image width.
         int width() const;
         //! Get image height.
         //! @return The image height.
         int height() const;
-        //! Get mutable reference to image pixel.
+        //! Get row stride.
+        //! @return The distance between rows, in pixels.
+        int stride() const;
+        //! Get pixel format.
+        //! @return Byte order of the pixels in memory.
+        PixelFormat format() const;
+        //! Get number of pixel writes performed by drawing routines.
+        //! @return Pixel write count.
+        unsigned long long pixels_written() const;
+        //! Get number of ellipse profiles drawn from EllipseProfileCache.
+        //! @return Cache hit count of this image's drawing.
+        unsigned long long ellipse_profile_hits() const;
+        //! Get number of ellipse profiles that had to be computed.
+        //! @return Cache miss count of this image's drawing.
+        unsigned long long ellipse_profile_misses() const;
+        //! Start counting writes per pixel in a side buffer.
+        //! All drawing routines update the counts from then on.
+        void track_overdraw();
+        //! Check if writes per pixel are being counted.
+        //! @return True after track_overdraw().
+        bool tracks_overdraw() const;
+        //! Get the number of writes to a pixel since track_overdraw().
+        //! @param x X position
+        //! @param y Y position.
+        //! @return Write count (0 if not tracking).
+        std::uint32_t overdraw(int x, int y) const;
+        //! Paint filled shapes with a gradient instead of their color.
+        //! Spans, rectangles and lines take their pixels from the shader
+        //! until it is reset.
+        //! @param shader The shader (kept by the caller), or nullptr to
+        //! paint solid colors again.
+        void set_shader(const GradientShader *shader);
+        //! Get pointer to the first pixel of a row.
+        //! @param y Y position.
+        //! @return Pointer to row.
+        Pixel *row(int y);
+        //! Get const pointer to the first pixel of a row.
+        //! @param y Y position.
+        //! @return Pointer to row.
+        const Pixel *row(int y) const;
+        //! Set image pixel.
         //! @param x X position
         //! @param y Y position.
-        //! @return Reference to pixel.
-        Color &at(int x, int y);
-        //! Get const reference to image pixel.
+        //! @param c Color.
+        void set(int x, int y, const Color &c);
+        //! Get image pixel.
         //! @param x X position
         //! @param y Y position.
-        //! @return Reference to pixel.
+        //! @return Pixel color.
         Color at(int x, int y) const;
-        //! Save to output file.
+        //! Save to output file. Throws std::runtime_error if it cannot be written.
         //! @param png_file_name Output file name.
         void save(const std::string &png_file_name) const;
+        //! Encode as a PNG file in memory.
+        //! @param png Receives the PNG file contents.
+        void encode(std::vector<unsigned char> &png) const;
+        //! Draw a horizontal span of pixels.
+        //! Parts of the span outside the image are clipped.
+        //! @param y Row.
+        //! @param x_from First column.
+        //! @param x_to Last column (inclusive, may be less than x_from).
+        //! @param c Color to use for the span.
+        void draw_span(int y, int x_from, int x_to, const Color &c);
         //! Draw a line defined by 2 points.
+        //! Parts of the line outside the image are clipped.
         //! @param a First point.
         //! @param b Second point.
         //! @param c Color to use for the line.
         void draw_line(const Point &a, const Point &b, const Color &c);
+        //! Draw a line between subpixel points. Whole-pixel points are drawn
+        //! as by the integer overload; otherwise each column (or row, for
+        //! steep lines) takes the pixel nearest the line at its center.
+        //! @param a First point.
+        //! @param b Second point.
+        //! @param c Color to use for the line.
+        void draw_line(const FixedPoint &a, const FixedPoint &b, const Color &c);
+        //! Fill an axis-aligned rectangle, clipped to the image once and
+        //! filled row by row.
+        //! @param a One corner (inclusive).
+        //! @param b The opposite corner (inclusive).
+        //! @param c Color to use for the rectangle.
+        void draw_rect(const Point &a, const Point &b, const Color &c);
         //! Draw a polygon.
         //! @param points Vector of points defining the polygon.
         //! @param fill Color to use for the polygon fill.
         void draw_polygon(const std::vector<Point> &points, const Color &fill);
+        //! Draw a polygon with subpixel vertices. Rows are sampled at pixel
+        //! centers and edges are stepped in exact integer arithmetic; for
+        //! whole-pixel vertices the pixels are those of the integer version.
+        //! @param points Vector of points defining the polygon.
+        //! @param fill Color to use for the polygon fill.
+        void draw_polygon(const std::vector<FixedPoint> &points, const Color &fill);
+        //! Draw a convex polygon, with the same pixels as draw_polygon.
+        //! Each row is filled between the two edge chains running from the
+        //! top vertex to the bottom one, so no crossings are sorted.
+        //! @param points Vector of points defining the polygon (see is_convex).
+        //! @param fill Color to use for the polygon fill.
+        void draw_convex_polygon(const std::vector<Point> &points, const Color &fill);
+        //! Check if a polygon can be drawn with draw_convex_polygon: every
+        //! corner turns the same way, with no repeated or collinear points,
+        //! and the outline goes down once and up once.
+        //! @param points Vector of points defining the polygon.
+        //! @return True if the polygon is strictly convex.
+        static bool is_convex(const std::vector<Point> &points);
+        //! Fill a set of closed contours, sampling pixel centers.
+        //! @param points Vertices of all contours, one contour after the other.
+        //! @param contour_ends End offset (exclusive) of each contour in points.
+        //! @param fill Color to use for the fill.
+        //! @param even_odd Use the even-odd fill rule instead of nonzero.
+        void draw_contours(const std::vector<Point> &points,
+                           const std::vector<size_t> &contour_ends,
+                           const Color &fill,
+                           bool even_odd);
+        //! Fill a set of closed contours with subpixel vertices, sampling
+        //! pixel centers with exact integer edge stepping.
+        //! @param points Vertices of all contours, one contour after the other.
+        //! @param contour_ends End offset (exclusive) of each contour in points.
+        //! @param fill Color to use for the fill.
+        //! @param even_odd Use the even-odd fill rule instead of nonzero.
+        void draw_contours(const std::vector<FixedPoint> &points,
+                           const std::vector<size_t> &contour_ends,
+                           const Color &fill,
+                           bool even_odd);
         //! Draw an ellipse.
         //! @param center Coordinates for the ellipse center.
         //! @param radius Radius in X and Y axis.
         //! @param fill Color to use for the ellipse fill.
-        //! @param orientation ellipse orientation.
-        void draw_ellipse(const Point &center, const Point &radius, const Color &fill);
+        //! @param orientation ellipse orientation, in degrees.
+        void draw_ellipse(const Point &center, const Point &radius, const Color &fill, int orientation = 0);
+        //! Draw an ellipse with a subpixel center and radii. Whole-pixel
+        //! values are drawn as by the integer overload; otherwise the
+        //! pixels whose centers lie inside the ellipse are filled.
+        //! @param center Coordinates for the ellipse center.
+        //! @param radius Radius in X and Y axis.
+        //! @param fill Color to use for the ellipse fill.
+        //! @param orientation ellipse orientation, in degrees.
+        void draw_ellipse(const FixedPoint &center, const FixedPoint &radius, const Color &fill, int orientation = 0);
+        //! Compute the row half-widths of an axis-aligned ellipse with the
+        //! integer midpoint algorithm, as drawn by draw_ellipse.
+        //! @param radius Radius in X and Y axis (at most 40000).
+        //! @return Half-width of rows 0 to radius.y below (and above) the center.
+        static std::vector<int> axis_ellipse_profile(const Point &radius);
 
     private:
+        PNGImage(const PNGImage &) = delete;
+        PNGImage &operator=(const PNGImage &) = delete;
+        //! Draw an axis-aligned ellipse with the integer midpoint algorithm.
+        //! Row profiles are shared through EllipseProfileCache::shared().
+        //! @param center Coordinates for the ellipse center.
+        //! @param radius Radius in X and Y axis.
+        //! @param fill Color to use for the ellipse fill.
+        void draw_axis_ellipse(const Point &center, const Point &radius, const Color &fill);
+        //! Draw a rotated ellipse by solving each scanline for its span.
+        //! @param center Coordinates for the ellipse center.
+        //! @param radius Radius along the ellipse axes.
+        //! @param degrees Rotation in degrees.
+        //! @param fill Color to use for the ellipse fill.
+        void draw_rotated_ellipse(const Point &center, const Point &radius, int degrees, const Color &fill);
+        //! Draw an ellipse with a fractional center or radii by solving each
+        //! scanline at its pixel centers.
+        //! @param center Coordinates for the ellipse center.
+        //! @param radius Radius along the ellipse axes.
+        //! @param degrees Rotation in degrees.
+        //! @param fill Color to use for the ellipse fill.
+        void draw_subpixel_ellipse(const FixedPoint &center, const FixedPoint &radius, int degrees, const Color &fill);
+        //! Draw a line one pixel at a time, counting overdraw.
+        //! @param a Start point.
+        //! @param b End point.
+        //! @param p Packed pixel.
+        void draw_line_plotted(const Point &a, const Point &b, Pixel p);
+        //! Draw a vertical or 45 degree line as a strided run of pixels.
+        //! @param a Start point.
+        //! @param b End point (not on the same row as a).
+        //! @param p Packed pixel.
+        void draw_run(const Point &a, const Point &b, Pixel p);
+        //! Draw any other line, clipped to the image before stepping.
+        //! @param a Start point.
+        //! @param b End point.
+        //! @param p Packed pixel.
+        void draw_sloped_line(const Point &a, const Point &b, Pixel p);
+        //! Get the shader's color of a pixel.
+        //! @param x Canvas column.
+        //! @param y Canvas row.
+        //! @return Packed pixel.
+        Pixel shade_pixel(int x, int y) const;
+        //! Convert to packed 8-bit RGB, without row padding.
+        //! @return RGB bytes, row after row.
+        std::vector<unsigned char> to_rgb() const;
+        //! Allocate aligned rows for the current dimensions.
+        //! @param stride Requested stride in pixels (0 for default).
+        void allocate(int stride);
+        //! Store a packed pixel.
+        //! @param x X position
+        //! @param y Y position.
+        //! @param p Packed pixel.
+        void plot(int x, int y, Pixel p)
+        {
+            x -= left_;
+            y -= top_;
+            if ((unsigned)x < (unsigned)width_ && (unsigned)y < (unsigned)height_)
+            {
+                row(y)[x] = shader_ == nullptr ? p : shade_pixel(x + left_, y + top_);
+                pixels_written_++;
+                if (!overdraw_.empty())
+                {
+                    overdraw_[(size_t)y * width_ + x]++;
+                }
+            }
+        }
         //! Width.
         int width_;
         //! Height.
         int height_;
+        //! Canvas row of the first row.
+        int top_ = 0;
+        //! Canvas column of the first column.
+        int left_ = 0;
+        //! Row stride, in pixels.
+        int stride_;
         //! Pixels.
-        Color *pixels_;
+        Pixel *pixels_;
+        //! Whether pixels_ was allocated by the image.
+        bool owns_pixels_ = true;
+        //! Byte order of the pixels.
+        PixelFormat format_ = PixelFormat::RGBX;
+        //! Pixel writes performed by drawing routines.
+        unsigned long long pixels_written_ = 0;
+        //! Ellipse profiles found in the shared cache.
+        unsigned long long ellipse_profile_hits_ = 0;
+        //! Ellipse profiles computed.
+        unsigned long long ellipse_profile_misses_ = 0;
+        //! Writes per pixel (row-major, width_ per row), if tracked.
+        std::vector<std::uint32_t> overdraw_;
+        //! Shader of gradient fills, or nullptr for solid colors.
+        const GradientShader *shader_ = nullptr;
     };
 }
 
@@ -0,0 +1,422 @@
+//! @file PNGWriter.cpp
+#include "PNGWriter.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace svg
+{
+    namespace
+    {
+        //! LZ77 window size (the largest distance deflate can encode).
+        const int WINDOW_SIZE = 32768;
+        //! Shortest match worth encoding.
+        const int MIN_MATCH = 3;
+        //! Longest match deflate can encode.
+        const int MAX_MATCH = 258;
+        //! Number of bits in the hash of a 3-byte string.
+        const int HASH_BITS = 15;
+        //! Number of candidates examined per match search.
+        const int MAX_CHAIN = 32;
+        //! Size of IDAT chunks written by PNGWriter.
+        const size_t IDAT_SIZE = 65536;
+        //! Largest Adler-32 modulus.
+        const std::uint32_t ADLER_MOD = 65521;
+        //! Bytes that can be summed before the Adler-32 sums may overflow.
+        const size_t ADLER_BLOCK = 5552;
+
+        //! Base lengths of length symbols 257-285.
+        const int LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                     35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        //! Extra bits of length symbols 257-285.
+        const int LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                      3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        //! Base distances of distance codes 0-29.
+        const int DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                       193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+                                       6145, 8193, 12289, 16385, 24577};
+        //! Extra bits of distance codes 0-29.
+        const int DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                        6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+        //! Hash of the 3-byte string starting at p.
+        inline int hash3(const unsigned char *p)
+        {
+            std::uint32_t v = ((std::uint32_t)p[0] << 16) | ((std::uint32_t)p[1] << 8) | p[2];
+            return (int)((v * 2654435761u) >> (32 - HASH_BITS));
+        }
+
+        //! CRC-32 (as used by PNG) lookup table.
+        std::vector<std::uint32_t> make_crc_table()
+        {
+            std::vector<std::uint32_t> table(256);
+            for (std::uint32_t n = 0; n < 256; n++)
+            {
+                std::uint32_t c = n;
+                for (int k = 0; k < 8; k++)
+                {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                table[n] = c;
+            }
+            return table;
+        }
+
+        //! Update a CRC-32 with more data.
+        std::uint32_t update_crc(std::uint32_t crc, const unsigned char *data, size_t n)
+        {
+            static const std::vector<std::uint32_t> table = make_crc_table();
+            for (size_t i = 0; i < n; i++)
+            {
+                crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+            }
+            return crc;
+        }
+
+        //! Store a 32-bit value in network byte order.
+        void put_u32(unsigned char *dst, std::uint32_t v)
+        {
+            dst[0] = (unsigned char)(v >> 24);
+            dst[1] = (unsigned char)(v >> 16);
+            dst[2] = (unsigned char)(v >> 8);
+            dst[3] = (unsigned char)v;
+        }
+
+        //! Paeth predictor (PNG specification, section 9.4).
+        inline int paeth(int a, int b, int c)
+        {
+            int p = a + b - c;
+            int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+            if (pa <= pb && pa <= pc)
+            {
+                return a;
+            }
+            return pb <= pc ? b : c;
+        }
+    }
+
+    // Deflater
+    Deflater::Deflater()
+        : window(2 * WINDOW_SIZE), head(1 << HASH_BITS, -1), prev(WINDOW_SIZE, -1)
+    {
+        // zlib header: deflate with a 32 KB window, no dictionary
+        out.push_back(0x78);
+        out.push_back(0x01);
+        // one fixed Huffman block holds all the data
+        put_bits(0, 1);
+        put_bits(1, 2);
+    }
+
+    void Deflater::write(const unsigned char *data, size_t n)
+    {
+        while (n > 0)
+        {
+            if (position + lookahead == (int)window.size())
+            {
+                slide();
+            }
+            size_t k = std::min(n, window.size() - (size_t)(position + lookahead));
+            std::memcpy(&window[position + lookahead], data, k);
+            for (size_t done = 0; done < k;)
+            {
+                size_t block = std::min(k - done, ADLER_BLOCK);
+                for (size_t i = 0; i < block; i++)
+                {
+                    adler_a += data[done + i];
+                    adler_b += adler_a;
+                }
+                adler_a %= ADLER_MOD;
+                adler_b %= ADLER_MOD;
+                done += block;
+            }
+            lookahead += (int)k;
+            data += k;
+            n -= k;
+            compress(false);
+        }
+    }
+
+    void Deflater::finish()
+    {
+        compress(true);
+        put_symbol(256);
+        // empty final block
+        put_bits(1, 1);
+        put_bits(1, 2);
+        put_symbol(256);
+        if (bit_count > 0)
+        {
+            out.push_back((unsigned char)bit_buffer);
+            bit_buffer = 0;
+            bit_count = 0;
+        }
+        unsigned char adler[4];
+        put_u32(adler, (adler_b << 16) | adler_a);
+        out.insert(out.end(), adler, adler + 4);
+    }
+
+    std::vector<unsigned char> &Deflater::output()
+    {
+        return out;
+    }
+
+    void Deflater::compress(bool flush)
+    {
+        while (lookahead >= MAX_MATCH || (flush && lookahead > 0))
+        {
+            int best_length = 0, best_distance = 0;
+            if (lookahead >= MIN_MATCH)
+            {
+                const unsigned char *current = &window[position];
+                const int max_length = std::min(MAX_MATCH, lookahead);
+                const int h = hash3(current);
+                // candidates at or before limit have left the window
+                const int limit = position - WINDOW_SIZE;
+                int candidate = head[h];
+                for (int chain = MAX_CHAIN; candidate > limit && candidate >= 0 && chain > 0; chain--)
+                {
+                    const unsigned char *match = &window[candidate];
+                    if (match[best_length] == current[best_length])
+                    {
+                        int length = 0;
+                        while (length < max_length && match[length] == current[length])
+                        {
+                            length++;
+                        }
+                        if (length > best_length)
+                        {
+                            best_length = length;
+                            best_distance = position - candidate;
+                            if (length == max_length)
+                            {
+                                break;
+                            }
+                        }
+                    }
+                    candidate = prev[candidate & (WINDOW_SIZE - 1)];
+                }
+                prev[position & (WINDOW_SIZE - 1)] = head[h];
+                head[h] = position;
+            }
+            if (best_length >= MIN_MATCH)
+            {
+                put_match(best_length, best_distance);
+                for (int i = 1; i < best_length && i + MIN_MATCH <= lookahead; i++)
+                {
+                    insert(position + i);
+                }
+                position += best_length;
+                lookahead -= best_length;
+            }
+            else
+            {
+                put_symbol(window[position]);
+                position++;
+                lookahead--;
+            }
+        }
+    }
+
+    void Deflater::slide()
+    {
+        // only called when the window is full and fewer than MAX_MATCH
+        // bytes are pending, so position is in the second half
+        std::memmove(&window[0], &window[WINDOW_SIZE], WINDOW_SIZE);
+        position -= WINDOW_SIZE;
+        for (int &p : head)
+        {
+            p = p >= WINDOW_SIZE ? p - WINDOW_SIZE : -1;
+        }
+        for (int &p : prev)
+        {
+            p = p >= WINDOW_SIZE ? p - WINDOW_SIZE : -1;
+        }
+    }
+
+    void Deflater::insert(int pos)
+    {
+        const int h = hash3(&window[pos]);
+        prev[pos & (WINDOW_SIZE - 1)] = head[h];
+        head[h] = pos;
+    }
+
+    void Deflater::put_bits(std::uint32_t bits, int count)
+    {
+        bit_buffer |= (std::uint64_t)bits << bit_count;
+        bit_count += count;
+        while (bit_count >= 8)
+        {
+            out.push_back((unsigned char)bit_buffer);
+            bit_buffer >>= 8;
+            bit_count -= 8;
+        }
+    }
+
+    void Deflater::put_code(std::uint32_t code, int length)
+    {
+        std::uint32_t reversed = 0;
+        for (int i = 0; i < length; i++)
+        {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        put_bits(reversed, length);
+    }
+
+    void Deflater::put_symbol(int symbol)
+    {
+        // fixed literal/length code (RFC 1951, section 3.2.6)
+        if (symbol < 144)
+        {
+            put_code(0x30 + symbol, 8);
+        }
+        else if (symbol < 256)
+        {
+            put_code(0x190 + symbol - 144, 9);
+        }
+        else if (symbol < 280)
+        {
+            put_code(symbol - 256, 7);
+        }
+        else
+        {
+            put_code(0xC0 + symbol - 280, 8);
+        }
+    }
+
+    void Deflater::put_match(int length, int distance)
+    {
+        int l = (int)(std::upper_bound(LENGTH_BASE, LENGTH_BASE + 29, length) - LENGTH_BASE) - 1;
+        put_symbol(257 + l);
+        put_bits(length - LENGTH_BASE[l], LENGTH_EXTRA[l]);
+        int d = (int)(std::upper_bound(DISTANCE_BASE, DISTANCE_BASE + 30, distance) - DISTANCE_BASE) - 1;
+        put_code(d, 5);
+        put_bits(distance - DISTANCE_BASE[d], DISTANCE_EXTRA[d]);
+    }
+
+    // PNGWriter
+    PNGWriter::PNGWriter(const std::string &png_file_name, int width, int height)
+        : file(png_file_name, std::ios::binary), file_name(png_file_name),
+          width(width), height(height),
+          previous((size_t)width * 3, 0),
+          filtered((size_t)width * 3 + 1),
+          candidate((size_t)width * 3 + 1)
+    {
+        if (!file)
+        {
+            throw std::runtime_error("Unable to write " + png_file_name);
+        }
+        static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+        file.write((const char *)signature, sizeof(signature));
+        // 8-bit RGB, no interlacing
+        unsigned char header[13] = {0};
+        put_u32(header, (std::uint32_t)width);
+        put_u32(header + 4, (std::uint32_t)height);
+        header[8] = 8;
+        header[9] = 2;
+        write_chunk("IHDR", header, sizeof(header));
+    }
+
+    void PNGWriter::write_row(const unsigned char *rgb)
+    {
+        // Pick the filter with the smallest sum of absolute residuals.
+        const size_t n = previous.size();
+        long best_score = -1;
+        for (int filter = 0; filter < 5; filter++)
+        {
+            unsigned char *dst = candidate.data() + 1;
+            candidate[0] = (unsigned char)filter;
+            long score = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                int a = i >= 3 ? rgb[i - 3] : 0;
+                int b = previous[i];
+                int c = i >= 3 ? previous[i - 3] : 0;
+                int predicted = 0;
+                switch (filter)
+                {
+                case 1:
+                    predicted = a;
+                    break;
+                case 2:
+                    predicted = b;
+                    break;
+                case 3:
+                    predicted = (a + b) >> 1;
+                    break;
+                case 4:
+                    predicted = paeth(a, b, c);
+                    break;
+                }
+                dst[i] = (unsigned char)(rgb[i] - predicted);
+                score += std::abs((int)(signed char)dst[i]);
+            }
+            if (best_score < 0 || score < best_score)
+            {
+                best_score = score;
+                std::swap(candidate, filtered);
+            }
+        }
+        std::memcpy(previous.data(), rgb, n);
+        deflater.write(filtered.data(), filtered.size());
+        flush_idat(false);
+        rows++;
+    }
+
+    void PNGWriter::finish()
+    {
+        if (rows != height)
+        {
+            throw std::runtime_error(file_name + ": image has missing rows");
+        }
+        deflater.finish();
+        flush_idat(true);
+        write_chunk("IEND", nullptr, 0);
+        file.close();
+        if (!file)
+        {
+            throw std::runtime_error("Unable to write " + file_name);
+        }
+    }
+
+    int PNGWriter::rows_written() const
+    {
+        return rows;
+    }
+
+    unsigned long long PNGWriter::memory_bytes(int width)
+    {
+        // three rows, then the window, hash chains and pending output of
+        // the compressor, which flushes once a chunk is full
+        const unsigned long long row = (unsigned long long)width * 3 + 1;
+        return 3 * row + 2 * WINDOW_SIZE + (sizeof(int) << HASH_BITS) + sizeof(int) * WINDOW_SIZE +
+               IDAT_SIZE + row;
+    }
+
+    void PNGWriter::write_chunk(const char *type, const unsigned char *data, size_t n)
+    {
+        unsigned char bytes[4];
+        put_u32(bytes, (std::uint32_t)n);
+        file.write((const char *)bytes, 4);
+        file.write(type, 4);
+        std::uint32_t crc = update_crc(0xFFFFFFFFu, (const unsigned char *)type, 4);
+        if (n > 0)
+        {
+            file.write((const char *)data, n);
+            crc = update_crc(crc, data, n);
+        }
+        put_u32(bytes, crc ^ 0xFFFFFFFFu);
+        file.write((const char *)bytes, 4);
+    }
+
+    void PNGWriter::flush_idat(bool all)
+    {
+        std::vector<unsigned char> &data = deflater.output();
+        if (data.size() >= IDAT_SIZE || (all && !data.empty()))
+        {
+            write_chunk("IDAT", data.data(), data.size());
+            data.clear();
+        }
+    }
+}
@@ -0,0 +1,123 @@
+//! @file PNGWriter.hpp
+#ifndef __svg_PNGWriter_hpp__
+#define __svg_PNGWriter_hpp__
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace svg
+{
+    //! Incremental zlib (RFC 1950) compressor.
+    //! Input is compressed as it arrives, with LZ77 matching over a 32 KB
+    //! sliding window and fixed Huffman codes, so memory use does not
+    //! depend on the size of the stream.
+    class Deflater
+    {
+    public:
+        //! Constructs a compressor and writes the zlib header.
+        Deflater();
+
+        //! Compress more input.
+        //! @param data Input bytes.
+        //! @param n Number of input bytes.
+        void write(const unsigned char *data, size_t n);
+
+        //! Compress pending input and end the stream.
+        void finish();
+
+        //! Compressed bytes not yet taken by the caller.
+        //! @return Output buffer.
+        std::vector<unsigned char> &output();
+
+    private:
+        //! Emit matches and literals while enough lookahead is available.
+        //! @param flush Also consume the last bytes of the input.
+        void compress(bool flush);
+        //! Move the second half of the window to the first half.
+        void slide();
+        //! Add the string at a window position to the hash chains.
+        //! @param pos Window position.
+        void insert(int pos);
+        //! Append bits to the output, least significant bit first.
+        //! @param bits Bit values.
+        //! @param count Number of bits.
+        void put_bits(std::uint32_t bits, int count);
+        //! Append a fixed Huffman code, most significant bit first.
+        //! @param code Code value.
+        //! @param length Code length in bits.
+        void put_code(std::uint32_t code, int length);
+        //! Append a literal or length symbol.
+        //! @param symbol Symbol (0-285).
+        void put_symbol(int symbol);
+        //! Append a back reference.
+        //! @param length Match length (3-258).
+        //! @param distance Match distance (1-32768).
+        void put_match(int length, int distance);
+
+        std::vector<unsigned char> window; //!< Two window sizes of input.
+        std::vector<int> head;             //!< Latest position per hash.
+        std::vector<int> prev;             //!< Previous position with the same hash.
+        int position = 0;                  //!< Next window position to compress.
+        int lookahead = 0;                 //!< Bytes available from position on.
+        std::uint64_t bit_buffer = 0;      //!< Bits not yet in the output.
+        int bit_count = 0;                 //!< Number of bits in bit_buffer.
+        std::uint32_t adler_a = 1;         //!< Adler-32 checksum, low half.
+        std::uint32_t adler_b = 0;         //!< Adler-32 checksum, high half.
+        std::vector<unsigned char> out;    //!< Compressed output.
+    };
+
+    //! PNG file writer that takes RGB rows one at a time.
+    //! Rows are filtered and compressed as they are written, so a whole
+    //! image never needs to be in memory.
+    class PNGWriter
+    {
+    public:
+        //! Opens the file and writes the PNG header.
+        //! @param png_file_name Output file name.
+        //! @param width Image width.
+        //! @param height Image height.
+        PNGWriter(const std::string &png_file_name, int width, int height);
+
+        //! Write the next row.
+        //! @param rgb Row of width * 3 bytes, in R, G, B order.
+        void write_row(const unsigned char *rgb);
+
+        //! Write the end of the image and close the file.
+        //! Throws std::runtime_error if rows are missing or writing fails.
+        void finish();
+
+        //! Number of rows written so far.
+        //! @return Row count.
+        int rows_written() const;
+
+        //! Memory a writer holds for images of a given width.
+        //! @param width Image width.
+        //! @return Approximate size in bytes.
+        static unsigned long long memory_bytes(int width);
+
+    private:
+        PNGWriter(const PNGWriter &) = delete;
+        PNGWriter &operator=(const PNGWriter &) = delete;
+        //! Write a chunk.
+        //! @param type Four-letter chunk type.
+        //! @param data Chunk data.
+        //! @param n Size of the chunk data.
+        void write_chunk(const char *type, const unsigned char *data, size_t n);
+        //! Write compressed data as IDAT chunks.
+        //! @param all Write everything, instead of only full chunks.
+        void flush_idat(bool all);
+
+        std::ofstream file;                   //!< Output file.
+        std::string file_name;                //!< Output file name.
+        int width;                            //!< Image width.
+        int height;                           //!< Image height.
+        int rows = 0;                         //!< Rows written.
+        std::vector<unsigned char> previous;  //!< Previous row, unfiltered.
+        std::vector<unsigned char> filtered;  //!< Filter byte and filtered row.
+        std::vector<unsigned char> candidate; //!< Filter byte and row, being evaluated.
+        Deflater deflater;                    //!< Compressor for the image data.
+    };
+}
+#endif
@@ -0,0 +1,532 @@
+//! @file Path.cpp
+#include "Path.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace svg
+{
+    // Affine
+    Affine Affine::identity()
+    {
+        return {1, 0, 0, 1, 0, 0};
+    }
+    PathPoint Affine::apply(const PathPoint &p) const
+    {
+        return {a * p.x + c * p.y + e, b * p.x + d * p.y + f};
+    }
+    Affine Affine::translate(double x, double y) const
+    {
+        return {a, b, c, d, e + x, f + y};
+    }
+    Affine Affine::rotate(const PathPoint &origin, double degrees) const
+    {
+        double angle = M_PI * degrees / 180.0;
+        double s = ::sin(angle);
+        double co = ::cos(angle);
+        Affine r = translate(-origin.x, -origin.y);
+        return Affine{co * r.a - s * r.b, s * r.a + co * r.b,
+                      co * r.c - s * r.d, s * r.c + co * r.d,
+                      co * r.e - s * r.f, s * r.e + co * r.f}
+            .translate(origin.x, origin.y);
+    }
+    Affine Affine::scale(const PathPoint &origin, double v) const
+    {
+        Affine r = translate(-origin.x, -origin.y);
+        return Affine{r.a * v, r.b * v, r.c * v, r.d * v, r.e * v, r.f * v}
+            .translate(origin.x, origin.y);
+    }
+    Affine Affine::then(const Affine &next) const
+    {
+        return {next.a * a + next.c * b, next.b * a + next.d * b,
+                next.a * c + next.c * d, next.b * c + next.d * d,
+                next.a * e + next.c * f + next.e, next.b * e + next.d * f + next.f};
+    }
+    bool Affine::invert(Affine &inverse) const
+    {
+        double det = a * d - b * c;
+        if (!(std::fabs(det) > 1e-12))
+        {
+            return false;
+        }
+        inverse = {d / det, -b / det, -c / det, a / det,
+                   (c * f - d * e) / det, (b * e - a * f) / det};
+        return true;
+    }
+    double Affine::scale_factor() const
+    {
+        return ::sqrt(::fabs(a * d - b * c));
+    }
+
+    namespace
+    {
+        //! Maximum distance, in output pixels, between a curve and
+        //! its flattened approximation.
+        const double FLATTEN_TOLERANCE = 0.25;
+        //! Subdivision depth limit for a single cubic segment.
+        const int MAX_SUBDIVISION_DEPTH = 16;
+        //! Number of scale buckets kept per path before the cache is reset.
+        const size_t MAX_CACHED_SCALES = 8;
+
+        //! Clamps a whole pixel coordinate to the range of FixedPoint, where
+        //! drawing clamps the path's points too.
+        int clamp_pixel(double v)
+        {
+            const int limit = SUBPIXEL_LIMIT / SUBPIXEL_ONE;
+            // also catches NaN
+            if (!(std::fabs(v) < limit))
+            {
+                return v < 0 ? -limit : limit;
+            }
+            return (int)v;
+        }
+
+        //! Tokenizer for SVG path data. Reads commands, numbers and arc
+        //! flags in place, without copying the input.
+        class PathTokenizer
+        {
+        public:
+            PathTokenizer(const char *s) : s(s) {}
+
+            //! Check whether all input was consumed.
+            bool at_end()
+            {
+                skip_separators();
+                return *s == '\0';
+            }
+            //! Check whether the next token is a command letter.
+            bool at_command()
+            {
+                skip_separators();
+                return std::isalpha((unsigned char)*s) && *s != 'e' && *s != 'E';
+            }
+            //! Read a command letter.
+            char command()
+            {
+                skip_separators();
+                return *s++;
+            }
+            //! Read a number.
+            double number()
+            {
+                skip_separators();
+                // strtod also takes "inf", "nan" and hex floats, which path
+                // data has no syntax for
+                const char *p = (*s == '+' || *s == '-') ? s + 1 : s;
+                const bool digits = std::isdigit((unsigned char)*p) ||
+                                    (*p == '.' && std::isdigit((unsigned char)p[1]));
+                if (!digits || (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')))
+                {
+                    throw std::runtime_error("invalid path data: number expected");
+                }
+                char *end;
+                const double value = std::strtod(s, &end);
+                if (end == s)
+                {
+                    throw std::runtime_error("invalid path data: number expected");
+                }
+                s = end;
+                return value;
+            }
+            //! Read a point (two numbers).
+            PathPoint point()
+            {
+                double x = number();
+                double y = number();
+                return {x, y};
+            }
+            //! Read an arc flag, which may not be followed by a separator.
+            bool flag()
+            {
+                skip_separators();
+                if (*s != '0' && *s != '1')
+                {
+                    throw std::runtime_error("invalid path data: arc flag expected");
+                }
+                return *s++ == '1';
+            }
+
+        private:
+            void skip_separators()
+            {
+                while (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r' || *s == ',')
+                {
+                    s++;
+                }
+            }
+            const char *s; //!< Current position.
+        };
+
+        //! Reflect a control point about the current point.
+        PathPoint reflect(const PathPoint &ctrl, const PathPoint &about)
+        {
+            return {2 * about.x - ctrl.x, 2 * about.y - ctrl.y};
+        }
+
+        //! Signed angle between two vectors.
+        double vector_angle(double ux, double uy, double vx, double vy)
+        {
+            return ::atan2(ux * vy - uy * vx, ux * vx + uy * vy);
+        }
+
+        //! Append a flattened cubic curve, excluding its start point.
+        //! The start point is taken by value: callers pass out.back(),
+        //! which appending may move.
+        void flatten_cubic(PathPoint p0, const PathPoint &p1,
+                           const PathPoint &p2, const PathPoint &p3,
+                           double tolerance, int depth,
+                           std::vector<PathPoint> &out)
+        {
+            // Flatness bound: the curve deviates from its chord by at
+            // most sqrt(max(u^2) + max(v^2)) / 4.
+            double ux = 3 * p1.x - 2 * p0.x - p3.x;
+            double uy = 3 * p1.y - 2 * p0.y - p3.y;
+            double vx = 3 * p2.x - p0.x - 2 * p3.x;
+            double vy = 3 * p2.y - p0.y - 2 * p3.y;
+            double flatness = std::max(ux * ux, vx * vx) + std::max(uy * uy, vy * vy);
+            if (depth >= MAX_SUBDIVISION_DEPTH || flatness <= 16 * tolerance * tolerance)
+            {
+                out.push_back(p3);
+                return;
+            }
+            PathPoint p01 = {(p0.x + p1.x) / 2, (p0.y + p1.y) / 2};
+            PathPoint p12 = {(p1.x + p2.x) / 2, (p1.y + p2.y) / 2};
+            PathPoint p23 = {(p2.x + p3.x) / 2, (p2.y + p3.y) / 2};
+            PathPoint p012 = {(p01.x + p12.x) / 2, (p01.y + p12.y) / 2};
+            PathPoint p123 = {(p12.x + p23.x) / 2, (p12.y + p23.y) / 2};
+            PathPoint mid = {(p012.x + p123.x) / 2, (p012.y + p123.y) / 2};
+            flatten_cubic(p0, p01, p012, mid, tolerance, depth + 1, out);
+            flatten_cubic(mid, p123, p23, p3, tolerance, depth + 1, out);
+        }
+    }
+
+    // PathGeometry
+    std::shared_ptr<const PathGeometry> PathGeometry::parse(const char *d)
+    {
+        std::shared_ptr<PathGeometry> geometry = std::make_shared<PathGeometry>();
+        PathTokenizer tok(d == nullptr ? "" : d);
+        PathPoint current = {0, 0};
+        PathPoint start = {0, 0};
+        PathPoint last_ctrl = {0, 0}; // last cubic or quadratic control point
+        char cmd = 0;
+        char prev = 0;
+        try
+        {
+            while (!tok.at_end())
+            {
+                if (tok.at_command())
+                {
+                    cmd = tok.command();
+                }
+                else if (cmd == 0 || cmd == 'Z' || cmd == 'z')
+                {
+                    throw std::runtime_error("invalid path data: command expected");
+                }
+                if (prev == 0 && cmd != 'M' && cmd != 'm')
+                {
+                    throw std::runtime_error("invalid path data: must start with a move-to");
+                }
+                bool rel = std::islower((unsigned char)cmd);
+                PathPoint base = rel ? current : PathPoint{0, 0};
+                char op = (char)std::toupper((unsigned char)cmd);
+                switch (op)
+                {
+                case 'M':
+                {
+                    PathPoint p = tok.point();
+                    current = start = {base.x + p.x, base.y + p.y};
+                    geometry->move_to(current);
+                    // further coordinate pairs are implicit line-to commands
+                    cmd = rel ? 'l' : 'L';
+                    break;
+                }
+                case 'L':
+                {
+                    PathPoint p = tok.point();
+                    current = {base.x + p.x, base.y + p.y};
+                    geometry->line_to(current);
+                    break;
+                }
+                case 'H':
+                    current.x = base.x + tok.number();
+                    geometry->line_to(current);
+                    break;
+                case 'V':
+                    current.y = base.y + tok.number();
+                    geometry->line_to(current);
+                    break;
+                case 'C':
+                case 'S':
+                {
+                    PathPoint c1;
+                    if (op == 'C')
+                    {
+                        PathPoint p = tok.point();
+                        c1 = {base.x + p.x, base.y + p.y};
+                    }
+                    else
+                    {
+                        char prev_op = (char)std::toupper((unsigned char)prev);
+                        c1 = (prev_op == 'C' || prev_op == 'S') ? reflect(last_ctrl, current) : current;
+                    }
+                    PathPoint c2 = tok.point();
+                    PathPoint p = tok.point();
+                    c2 = {base.x + c2.x, base.y + c2.y};
+                    p = {base.x + p.x, base.y + p.y};
+                    geometry->cubic_to(c1, c2, p);
+                    last_ctrl = c2;
+                    current = p;
+                    break;
+                }
+                case 'Q':
+                case 'T':
+                {
+                    PathPoint q;
+                    if (op == 'Q')
+                    {
+                        PathPoint p = tok.point();
+                        q = {base.x + p.x, base.y + p.y};
+                    }
+                    else
+                    {
+                        char prev_op = (char)std::toupper((unsigned char)prev);
+                        q = (prev_op == 'Q' || prev_op == 'T') ? reflect(last_ctrl, current) : current;
+                    }
+                    PathPoint p = tok.point();
+                    p = {base.x + p.x, base.y + p.y};
+                    // degree elevation: a quadratic is an exact cubic
+                    PathPoint c1 = {current.x + 2.0 / 3.0 * (q.x - current.x),
+                                    current.y + 2.0 / 3.0 * (q.y - current.y)};
+                    PathPoint c2 = {p.x + 2.0 / 3.0 * (q.x - p.x),
+                                    p.y + 2.0 / 3.0 * (q.y - p.y)};
+                    geometry->cubic_to(c1, c2, p);
+                    last_ctrl = q;
+                    current = p;
+                    break;
+                }
+                case 'A':
+                {
+                    double rx = tok.number();
+                    double ry = tok.number();
+                    double degrees = tok.number();
+                    bool large_arc = tok.flag();
+                    bool sweep = tok.flag();
+                    PathPoint p = tok.point();
+                    p = {base.x + p.x, base.y + p.y};
+                    geometry->arc_to(current, rx, ry, degrees, large_arc, sweep, p);
+                    current = p;
+                    break;
+                }
+                case 'Z':
+                    geometry->close();
+                    current = start;
+                    break;
+                default:
+                    throw std::runtime_error(std::string("invalid path data: unknown command ") + cmd);
+                }
+                prev = (op == 'M') ? 'M' : cmd;
+            }
+        }
+        catch (const std::runtime_error &)
+        {
+            // As the SVG spec asks, the path is drawn up to the command
+            // holding the first error. A command adds its segments only
+            // once all its numbers are read, so the geometry is complete.
+        }
+        return geometry;
+    }
+
+    void PathGeometry::move_to(const PathPoint &p)
+    {
+        verbs.push_back(MOVE);
+        points.push_back(p);
+    }
+    void PathGeometry::line_to(const PathPoint &p)
+    {
+        verbs.push_back(LINE);
+        points.push_back(p);
+    }
+    void PathGeometry::cubic_to(const PathPoint &c1, const PathPoint &c2, const PathPoint &p)
+    {
+        verbs.push_back(CUBIC);
+        points.push_back(c1);
+        points.push_back(c2);
+        points.push_back(p);
+    }
+    void PathGeometry::close()
+    {
+        verbs.push_back(CLOSE);
+    }
+    void PathGeometry::arc_to(const PathPoint &from, double rx, double ry, double degrees,
+                              bool large_arc, bool sweep, const PathPoint &to)
+    {
+        // Endpoint to center parameterization (SVG 1.1, appendix F.6.5).
+        if (from.x == to.x && from.y == to.y)
+        {
+            return;
+        }
+        rx = ::fabs(rx);
+        ry = ::fabs(ry);
+        if (rx == 0 || ry == 0)
+        {
+            line_to(to);
+            return;
+        }
+        double phi = M_PI * degrees / 180.0;
+        double cos_phi = ::cos(phi), sin_phi = ::sin(phi);
+        double dx2 = (from.x - to.x) / 2, dy2 = (from.y - to.y) / 2;
+        double x1p = cos_phi * dx2 + sin_phi * dy2;
+        double y1p = -sin_phi * dx2 + cos_phi * dy2;
+        double lambda = (x1p * x1p) / (rx * rx) + (y1p * y1p) / (ry * ry);
+        if (lambda > 1)
+        {
+            rx *= ::sqrt(lambda);
+            ry *= ::sqrt(lambda);
+        }
+        double rx2 = rx * rx, ry2 = ry * ry;
+        double num = rx2 * ry2 - rx2 * y1p * y1p - ry2 * x1p * x1p;
+        double den = rx2 * y1p * y1p + ry2 * x1p * x1p;
+        double coef = ::sqrt(std::max(0.0, num / den)) * (large_arc == sweep ? -1 : 1);
+        double cxp = coef * rx * y1p / ry;
+        double cyp = -coef * ry * x1p / rx;
+        double cx = cos_phi * cxp - sin_phi * cyp + (from.x + to.x) / 2;
+        double cy = sin_phi * cxp + cos_phi * cyp + (from.y + to.y) / 2;
+        double theta = vector_angle(1, 0, (x1p - cxp) / rx, (y1p - cyp) / ry);
+        double delta = vector_angle((x1p - cxp) / rx, (y1p - cyp) / ry,
+                                    (-x1p - cxp) / rx, (-y1p - cyp) / ry);
+        if (!sweep && delta > 0)
+        {
+            delta -= 2 * M_PI;
+        }
+        else if (sweep && delta < 0)
+        {
+            delta += 2 * M_PI;
+        }
+        // one cubic per quarter turn (or less)
+        int segments = std::max(1, (int)::ceil(::fabs(delta) / (M_PI / 2) - 1e-9));
+        double step = delta / segments;
+        double alpha = 4.0 / 3.0 * ::tan(step / 4);
+        auto map = [&](double ux, double uy) -> PathPoint
+        {
+            return {cx + rx * cos_phi * ux - ry * sin_phi * uy,
+                    cy + rx * sin_phi * ux + ry * cos_phi * uy};
+        };
+        for (int i = 0; i < segments; i++)
+        {
+            double t0 = theta + i * step, t1 = t0 + step;
+            double c0 = ::cos(t0), s0 = ::sin(t0);
+            double c1 = ::cos(t1), s1 = ::sin(t1);
+            PathPoint end = (i == segments - 1) ? to : map(c1, s1);
+            cubic_to(map(c0 - alpha * s0, s0 + alpha * c0),
+                     map(c1 + alpha * s1, s1 - alpha * c1),
+                     end);
+        }
+    }
+
+    size_t PathGeometry::size() const
+    {
+        return verbs.size();
+    }
+
+    size_t PathGeometry::point_count() const
+    {
+        return points.size();
+    }
+
+    BoundingBox PathGeometry::bounds(const Affine &transform) const
+    {
+        if (points.empty())
+        {
+            return BoundingBox::none();
+        }
+        PathPoint lo = transform.apply(points[0]);
+        PathPoint hi = lo;
+        for (const PathPoint &p : points)
+        {
+            PathPoint q = transform.apply(p);
+            lo.x = std::min(lo.x, q.x);
+            lo.y = std::min(lo.y, q.y);
+            hi.x = std::max(hi.x, q.x);
+            hi.y = std::max(hi.y, q.y);
+        }
+        return {{clamp_pixel(::floor(lo.x)), clamp_pixel(::floor(lo.y))},
+                {clamp_pixel(::ceil(hi.x)), clamp_pixel(::ceil(hi.y))}};
+    }
+
+    std::shared_ptr<const FlattenedPath> PathGeometry::flatten(double scale) const
+    {
+        // Scales are bucketed in quarter powers of two; each bucket is
+        // flattened for its upper bound, so the tolerance always holds.
+        int key = (int)::ceil(::log2(std::max(scale, 1e-6)) * 4);
+        {
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            auto it = flatten_cache.find(key);
+            if (it != flatten_cache.end())
+            {
+                return it->second;
+            }
+        }
+        double tolerance = FLATTEN_TOLERANCE / ::pow(2.0, key / 4.0);
+
+        std::shared_ptr<FlattenedPath> flat = std::make_shared<FlattenedPath>();
+        std::vector<PathPoint> &out = flat->points;
+        size_t contour_begin = 0;
+        bool contour_closed = false;
+        PathPoint start = {0, 0};
+        auto end_contour = [&]()
+        {
+            if (out.size() >= contour_begin + 2)
+            {
+                flat->contour_ends.push_back(out.size());
+                flat->closed.push_back(contour_closed);
+            }
+            else
+            {
+                out.resize(contour_begin);
+            }
+            contour_begin = out.size();
+            contour_closed = false;
+        };
+        size_t pi = 0;
+        for (Verb verb : verbs)
+        {
+            if (verb != MOVE && verb != CLOSE && out.size() == contour_begin)
+            {
+                // drawing after a close-path continues from the subpath start
+                out.push_back(start);
+            }
+            switch (verb)
+            {
+            case MOVE:
+                end_contour();
+                start = points[pi++];
+                out.push_back(start);
+                break;
+            case LINE:
+                out.push_back(points[pi++]);
+                break;
+            case CUBIC:
+                flatten_cubic(out.back(), points[pi], points[pi + 1], points[pi + 2],
+                              tolerance, 0, out);
+                pi += 3;
+                break;
+            case CLOSE:
+                contour_closed = true;
+                end_contour();
+                break;
+            }
+        }
+        end_contour();
+
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        if (flatten_cache.size() >= MAX_CACHED_SCALES)
+        {
+            flatten_cache.clear();
+        }
+        flatten_cache[key] = flat;
+        return flat;
+    }
+}
@@ -0,0 +1,134 @@
+//! @file Path.hpp
+#ifndef __svg_Path_hpp__
+#define __svg_Path_hpp__
+
+#include "Point.hpp"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace svg
+{
+    //! Point with fractional coordinates, used for path geometry.
+    struct PathPoint
+    {
+        //! X coordinate.
+        double x;
+        //! Y coordinate.
+        double y;
+    };
+
+    //! 2D affine transform mapping (x, y) to
+    //! (a * x + c * y + e, b * x + d * y + f).
+    struct Affine
+    {
+        double a, b, c, d, e, f;
+
+        //! Identity transform.
+        //! @return The identity.
+        static Affine identity();
+        //! Apply the transform to a point.
+        //! @param p Point to transform.
+        //! @return Transformed point.
+        PathPoint apply(const PathPoint &p) const;
+        //! Compose with a translation applied after this transform.
+        //! @param x The x-coordinate translation.
+        //! @param y The y-coordinate translation.
+        //! @return Composed transform.
+        Affine translate(double x, double y) const;
+        //! Compose with a rotation applied after this transform.
+        //! @param origin Rotation origin.
+        //! @param degrees Degrees of rotation.
+        //! @return Composed transform.
+        Affine rotate(const PathPoint &origin, double degrees) const;
+        //! Compose with a scaling applied after this transform.
+        //! @param origin Scaling origin.
+        //! @param v Scale amount.
+        //! @return Composed transform.
+        Affine scale(const PathPoint &origin, double v) const;
+        //! Compose with a transform applied after this one.
+        //! @param next Transform applied to the result of this one.
+        //! @return Composed transform.
+        Affine then(const Affine &next) const;
+        //! Inverse transform.
+        //! @param inverse Receives the inverse.
+        //! @return False if the transform is not invertible.
+        bool invert(Affine &inverse) const;
+        //! Average linear scale factor of the transform.
+        //! @return Square root of the absolute determinant.
+        double scale_factor() const;
+    };
+
+    //! Path flattened into polygonal contours.
+    struct FlattenedPath
+    {
+        //! Vertices of all contours, one contour after the other.
+        std::vector<PathPoint> points;
+        //! End offset (exclusive) of each contour in points.
+        std::vector<size_t> contour_ends;
+        //! Whether each contour was explicitly closed.
+        std::vector<bool> closed;
+    };
+
+    //! Path geometry in local coordinates, reduced to move-to, line-to,
+    //! cubic-to and close commands. Quadratic curves and arcs are turned
+    //! into cubics when parsed, so every command is affine invariant.
+    class PathGeometry
+    {
+    public:
+        //! Parse SVG path data (the 'd' attribute).
+        //! Malformed data is read up to the command holding the first
+        //! error, and the commands before it are kept.
+        //! @param d Path data.
+        //! @return Parsed geometry.
+        static std::shared_ptr<const PathGeometry> parse(const char *d);
+
+        //! Flatten the path for a given output scale.
+        //! Curves are subdivided until they are within a fixed device
+        //! space tolerance, so larger scales produce more segments.
+        //! Results are cached per scale bucket and shared by all users
+        //! of this geometry.
+        //! @param scale Output scale (see Affine::scale_factor).
+        //! @return Flattened contours, in local coordinates.
+        std::shared_ptr<const FlattenedPath> flatten(double scale) const;
+
+        //! Number of commands in the path.
+        //! @return Command count.
+        size_t size() const;
+
+        //! Number of points (end points and control points) in the path.
+        //! @return Point count.
+        size_t point_count() const;
+
+        //! Pixel bounds of the path under a transform. Curves lie inside
+        //! the hull of their control points, so this bounds every pixel
+        //! drawn for the path.
+        //! @param transform Transform from path to image coordinates.
+        //! @return Bounding box (empty if the path has no points).
+        BoundingBox bounds(const Affine &transform) const;
+
+    private:
+        enum Verb : unsigned char
+        {
+            MOVE,
+            LINE,
+            CUBIC,
+            CLOSE
+        };
+        void move_to(const PathPoint &p);
+        void line_to(const PathPoint &p);
+        void cubic_to(const PathPoint &c1, const PathPoint &c2, const PathPoint &p);
+        void arc_to(const PathPoint &from, double rx, double ry, double degrees,
+                    bool large_arc, bool sweep, const PathPoint &to);
+        void close();
+
+        std::vector<Verb> verbs;        //!< Commands.
+        std::vector<PathPoint> points;  //!< Command operands, in order.
+        mutable std::mutex cache_mutex; //!< Guards flatten_cache.
+        //! Flattened contours, keyed by scale bucket.
+        mutable std::map<int, std::shared_ptr<const FlattenedPath>> flatten_cache;
+    };
+}
+#endif
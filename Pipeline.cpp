@@ -0,0 +1,348 @@
+//! @file Pipeline.cpp
+#include "Pipeline.hpp"
+#include "external/tinyxml2/tinyxml2.h"
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace svg
+{
+    namespace
+    {
+        //! A file on its way through the pipeline.
+        struct BatchJob
+        {
+            std::string svg_file;               //!< Input path.
+            std::string png_file;               //!< Output path.
+            std::string svg_text;               //!< Contents of the input file.
+            Point dimensions = {0, 0};          //!< Output dimensions.
+            std::vector<SVGElement *> elements; //!< Scene elements.
+            std::unique_ptr<PNGImage> image;    //!< Drawn image.
+            std::vector<unsigned char> png;     //!< Encoded PNG file.
+            std::string error;                  //!< Error, if the conversion failed.
+
+            ~BatchJob()
+            {
+                release_elements();
+            }
+            void release_elements()
+            {
+                for (SVGElement *e : elements)
+                {
+                    delete e;
+                }
+                elements.clear();
+            }
+        };
+
+        typedef BoundedQueue<BatchJob *> JobQueue;
+
+        //! Milliseconds elapsed since a time point.
+        double elapsed_ms(std::chrono::steady_clock::time_point since)
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+        }
+
+        //! Waits between attempts on a queue: spins briefly, then yields,
+        //! then sleeps, so idle workers do not burn a core.
+        class Backoff
+        {
+        public:
+            void wait()
+            {
+                if (rounds < 64)
+                {
+                    rounds++;
+                    std::this_thread::yield();
+                }
+                else
+                {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+            }
+
+        private:
+            int rounds = 0;
+        };
+
+        //! A pipeline stage and its shared state.
+        struct Stage
+        {
+            StageReport report;                   //!< Activity, merged as workers exit.
+            std::function<void(BatchJob &)> work; //!< Work done on each job.
+            JobQueue *input = nullptr;            //!< Input, or nullptr for the first stage.
+            JobQueue *output = nullptr;           //!< Output, or nullptr for the last stage.
+            std::atomic<int> active{0};           //!< Workers still running.
+        };
+
+        //! State shared by all workers of a batch.
+        struct Batch
+        {
+            const std::vector<std::pair<std::string, std::string>> *files; //!< Files to convert.
+            std::atomic<size_t> next_file{0};                              //!< Next file to read.
+            std::mutex mutex;                                              //!< Guards report.
+            PipelineReport report;                                         //!< Outcome.
+        };
+
+        //! Takes the next job for a stage.
+        //! @return False when there is no more work.
+        bool take(Batch &batch, Stage &stage, BatchJob *&job)
+        {
+            if (stage.input == nullptr)
+            {
+                size_t i = batch.next_file++;
+                if (i >= batch.files->size())
+                {
+                    return false;
+                }
+                job = new BatchJob();
+                job->svg_file = (*batch.files)[i].first;
+                job->png_file = (*batch.files)[i].second;
+                return true;
+            }
+            Backoff backoff;
+            for (;;)
+            {
+                if (stage.input->try_pop(job))
+                {
+                    return true;
+                }
+                if (stage.input->is_closed())
+                {
+                    return stage.input->try_pop(job);
+                }
+                backoff.wait();
+            }
+        }
+
+        //! Records the outcome of a job that left the pipeline.
+        void retire(Batch &batch, BatchJob *job)
+        {
+            {
+                std::lock_guard<std::mutex> lock(batch.mutex);
+                if (job->error.empty())
+                {
+                    batch.report.converted++;
+                }
+                else
+                {
+                    batch.report.errors.push_back(job->svg_file + ": " + job->error);
+                }
+            }
+            delete job;
+        }
+
+        //! Runs one worker of a stage until its input is exhausted.
+        void run_worker(Batch &batch, Stage &stage)
+        {
+            StageReport local;
+            for (;;)
+            {
+                auto start = std::chrono::steady_clock::now();
+                BatchJob *job;
+                bool more = take(batch, stage, job);
+                local.starved_ms += elapsed_ms(start);
+                if (!more)
+                {
+                    break;
+                }
+
+                start = std::chrono::steady_clock::now();
+                if (job->error.empty())
+                {
+                    try
+                    {
+                        stage.work(*job);
+                    }
+                    catch (const std::exception &e)
+                    {
+                        job->error = e.what();
+                        job->release_elements();
+                        job->image.reset();
+                    }
+                }
+                local.busy_ms += elapsed_ms(start);
+                local.jobs++;
+
+                if (stage.output == nullptr)
+                {
+                    retire(batch, job);
+                    continue;
+                }
+                start = std::chrono::steady_clock::now();
+                Backoff backoff;
+                while (!stage.output->try_push(job))
+                {
+                    backoff.wait();
+                }
+                local.blocked_ms += elapsed_ms(start);
+            }
+            {
+                std::lock_guard<std::mutex> lock(batch.mutex);
+                stage.report.jobs += local.jobs;
+                stage.report.busy_ms += local.busy_ms;
+                stage.report.starved_ms += local.starved_ms;
+                stage.report.blocked_ms += local.blocked_ms;
+            }
+            if (--stage.active == 0 && stage.output != nullptr)
+            {
+                stage.output->close();
+            }
+        }
+
+        //! Reads the input file.
+        void read_stage(BatchJob &job)
+        {
+            std::ifstream in(job.svg_file, std::ios::binary);
+            if (!in)
+            {
+                throw std::runtime_error("Unable to load " + job.svg_file);
+            }
+            job.svg_text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+
+        //! Parses the document and builds its elements at the output size.
+        void parse_stage(BatchJob &job, const ConvertOptions &options)
+        {
+            tinyxml2::XMLDocument doc;
+            if (doc.Parse(job.svg_text.data(), job.svg_text.size()) != tinyxml2::XML_SUCCESS)
+            {
+                throw std::runtime_error("Unable to parse " + job.svg_file);
+            }
+            std::string().swap(job.svg_text);
+            LimitGuard guard(options.limits);
+            readSVG(doc, job.dimensions, job.elements, nullptr, &guard, &options);
+            fit_output(job.dimensions, job.elements, options);
+        }
+
+        //! Draws the elements.
+        void raster_stage(BatchJob &job)
+        {
+            job.image.reset(new PNGImage(job.dimensions.x, job.dimensions.y));
+            for (const SVGElement *e : job.elements)
+            {
+                e->render(*job.image);
+            }
+            job.release_elements();
+        }
+
+        //! Encodes the image as PNG data.
+        void encode_stage(BatchJob &job)
+        {
+            job.image->encode(job.png);
+            job.image.reset();
+        }
+
+        //! Writes the PNG data to the output file.
+        void write_stage(BatchJob &job)
+        {
+            std::ofstream out(job.png_file, std::ios::binary);
+            out.write((const char *)job.png.data(), job.png.size());
+            out.close();
+            if (!out)
+            {
+                throw std::runtime_error("Unable to write " + job.png_file);
+            }
+            std::vector<unsigned char>().swap(job.png);
+        }
+    }
+
+    double StageReport::utilization(double wall_ms) const
+    {
+        return workers == 0 || wall_ms <= 0 ? 0 : busy_ms / (wall_ms * workers);
+    }
+
+    void PipelineReport::print(std::ostream &out) const
+    {
+        std::ios_base::fmtflags flags = out.flags();
+        out << std::fixed << std::setprecision(1)
+            << "Converted " << converted << " files, " << errors.size() << " failed, in "
+            << wall_ms << " ms" << std::endl;
+        for (const std::string &error : errors)
+        {
+            out << "  error: " << error << std::endl;
+        }
+        out << "Stage      workers      jobs     busy ms  starved ms  blocked ms   util" << std::endl;
+        for (const StageReport &stage : stages)
+        {
+            out << std::left << std::setw(10) << stage.name << std::right
+                << std::setw(8) << stage.workers
+                << std::setw(10) << stage.jobs
+                << std::setw(12) << stage.busy_ms
+                << std::setw(12) << stage.starved_ms
+                << std::setw(12) << stage.blocked_ms
+                << std::setw(6) << stage.utilization(wall_ms) * 100 << "%" << std::endl;
+        }
+        out.flags(flags);
+    }
+
+    PipelineReport convert_batch(const std::vector<std::pair<std::string, std::string>> &files,
+                                 const PipelineOptions &options)
+    {
+        const int workers[] = {options.readers, options.parsers, options.rasterizers,
+                               options.encoders, options.writers};
+        const char *names[] = {"read", "parse", "raster", "encode", "write"};
+        const int n_stages = 5;
+        for (int count : workers)
+        {
+            if (count < 1)
+            {
+                throw std::runtime_error("Every pipeline stage needs at least one worker");
+            }
+        }
+        if (options.queue_capacity < 1)
+        {
+            throw std::runtime_error("Pipeline queues need a capacity of at least one");
+        }
+
+        Batch batch;
+        batch.files = &files;
+        std::unique_ptr<JobQueue> queues[n_stages - 1];
+        for (int i = 0; i < n_stages - 1; i++)
+        {
+            queues[i].reset(new JobQueue(options.queue_capacity));
+        }
+        const ConvertOptions convert_options = options.convert;
+        Stage stages[n_stages];
+        stages[0].work = read_stage;
+        stages[1].work = [&convert_options](BatchJob &job)
+        { parse_stage(job, convert_options); };
+        stages[2].work = raster_stage;
+        stages[3].work = encode_stage;
+        stages[4].work = write_stage;
+        for (int i = 0; i < n_stages; i++)
+        {
+            stages[i].report.name = names[i];
+            stages[i].report.workers = workers[i];
+            stages[i].active = workers[i];
+            stages[i].input = i > 0 ? queues[i - 1].get() : nullptr;
+            stages[i].output = i < n_stages - 1 ? queues[i].get() : nullptr;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int i = 0; i < n_stages; i++)
+        {
+            for (int w = 0; w < workers[i]; w++)
+            {
+                threads.emplace_back(run_worker, std::ref(batch), std::ref(stages[i]));
+            }
+        }
+        for (std::thread &t : threads)
+        {
+            t.join();
+        }
+        batch.report.wall_ms = elapsed_ms(start);
+        for (int i = 0; i < n_stages; i++)
+        {
+            batch.report.stages.push_back(stages[i].report);
+        }
+        return batch.report;
+    }
+}
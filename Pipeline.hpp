@@ -0,0 +1,217 @@
+//! @file Pipeline.hpp
+#ifndef __svg_Pipeline_hpp__
+#define __svg_Pipeline_hpp__
+
+#include "SVGElements.hpp"
+
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace svg
+{
+    //! Bounded lock-free queue for any number of producers and consumers.
+    //! Each cell carries a sequence number telling producers and
+    //! consumers whose turn it is, so pushes and pops only contend on a
+    //! single atomic counter each (D. Vyukov's bounded MPMC queue).
+    //! @tparam T Element type (copied in and out of the queue).
+    template <typename T>
+    class BoundedQueue
+    {
+    public:
+        //! Constructs an empty queue.
+        //! @param capacity Maximum number of elements, rounded up to a
+        //! power of two.
+        explicit BoundedQueue(size_t capacity)
+        {
+            size_t size = 2;
+            while (size < capacity)
+            {
+                size *= 2;
+            }
+            cells.reset(new Cell[size]);
+            mask = size - 1;
+            for (size_t i = 0; i < size; i++)
+            {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        //! Number of elements the queue can hold.
+        //! @return The capacity.
+        size_t capacity() const
+        {
+            return mask + 1;
+        }
+
+        //! Add an element, unless the queue is full.
+        //! @param value Element to add.
+        //! @return True if the element was added.
+        bool try_push(const T &value)
+        {
+            size_t pos = push_pos.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                Cell &cell = cells[pos & mask];
+                size_t seq = cell.sequence.load(std::memory_order_acquire);
+                std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+                if (diff == 0)
+                {
+                    if (push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        cell.value = value;
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = push_pos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        //! Remove the oldest element, unless the queue is empty.
+        //! @param value Receives the element.
+        //! @return True if an element was removed.
+        bool try_pop(T &value)
+        {
+            size_t pos = pop_pos.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                Cell &cell = cells[pos & mask];
+                size_t seq = cell.sequence.load(std::memory_order_acquire);
+                std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)(pos + 1);
+                if (diff == 0)
+                {
+                    if (pop_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        value = cell.value;
+                        cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = pop_pos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        //! Mark that no more elements will be pushed.
+        void close()
+        {
+            closed.store(true, std::memory_order_release);
+        }
+
+        //! Check if close() was called.
+        //! Elements pushed before close() are still visible to try_pop
+        //! once this returns true.
+        //! @return True if the queue is closed.
+        bool is_closed() const
+        {
+            return closed.load(std::memory_order_acquire);
+        }
+
+    private:
+        BoundedQueue(const BoundedQueue &) = delete;
+        BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+        //! Queue slot.
+        struct Cell
+        {
+            std::atomic<size_t> sequence; //!< Turn of the next push or pop.
+            T value;                      //!< Stored element.
+        };
+
+        std::unique_ptr<Cell[]> cells;  //!< Ring of cells.
+        size_t mask;                    //!< Capacity - 1.
+        char pad0[64];                  //!< Keeps the counters on separate cache lines.
+        std::atomic<size_t> push_pos{0}; //!< Next push position.
+        char pad1[64];                  //!< Keeps the counters on separate cache lines.
+        std::atomic<size_t> pop_pos{0};  //!< Next pop position.
+        char pad2[64];                  //!< Keeps the counters on separate cache lines.
+        std::atomic<bool> closed{false}; //!< Set when producers are done.
+    };
+
+    //! Settings of a batch conversion.
+    struct PipelineOptions
+    {
+        //! Threads reading SVG files.
+        int readers = 1;
+        //! Threads parsing XML and building elements.
+        int parsers = 1;
+        //! Threads drawing elements.
+        int rasterizers = 1;
+        //! Threads encoding PNG data.
+        int encoders = 1;
+        //! Threads writing PNG files.
+        int writers = 1;
+        //! Capacity of each queue between stages. Together with the
+        //! worker counts, this bounds the number of jobs in memory.
+        size_t queue_capacity = 4;
+        //! Conversion options; only width, height and scale are used.
+        ConvertOptions convert;
+    };
+
+    //! Activity of one pipeline stage.
+    struct StageReport
+    {
+        //! Stage name.
+        std::string name;
+        //! Number of worker threads.
+        int workers = 0;
+        //! Jobs processed.
+        unsigned long long jobs = 0;
+        //! Time spent working, summed over workers, in milliseconds.
+        double busy_ms = 0;
+        //! Time spent waiting for input, summed over workers, in milliseconds.
+        double starved_ms = 0;
+        //! Time spent waiting for room downstream, summed over workers,
+        //! in milliseconds.
+        double blocked_ms = 0;
+
+        //! Fraction of the available worker time spent working.
+        //! @param wall_ms Duration of the whole batch.
+        //! @return Utilization, from 0 to 1.
+        double utilization(double wall_ms) const;
+    };
+
+    //! Outcome of a batch conversion.
+    struct PipelineReport
+    {
+        //! Duration of the whole batch, in milliseconds.
+        double wall_ms = 0;
+        //! Number of files converted.
+        unsigned long long converted = 0;
+        //! Error messages of files that could not be converted.
+        std::vector<std::string> errors;
+        //! Activity of each stage, in pipeline order.
+        std::vector<StageReport> stages;
+
+        //! Print the report in human-readable form.
+        //! @param out Output stream.
+        void print(std::ostream &out) const;
+    };
+
+    //! Converts many SVG files to PNG files through a pipeline of stages
+    //! (read, parse, raster, encode, write), each with its own threads
+    //! and connected by bounded queues. A full queue stalls the stage
+    //! feeding it, so memory stays bounded however many files there are.
+    //! @param files Pairs of SVG input and PNG output paths.
+    //! @param options Pipeline settings.
+    //! @return Report with errors and per-stage activity.
+    PipelineReport convert_batch(const std::vector<std::pair<std::string, std::string>> &files,
+                                 const PipelineOptions &options);
+}
+#endif
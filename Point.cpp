@@ -1,4 +1,6 @@
 //! @file point.cpp
+#include <algorithm>
+#include <climits>
 #include <cmath>
 #include "Point.hpp"
 
@@ -27,4 +29,114 @@ namespace svg
                 origin.y + (y - origin.y) * v};
     }
 
+    Point Point::fit(double v, double dx, double dy) const
+    {
+        return {(int)::lround(x * v + dx), (int)::lround(y * v + dy)};
+    }
+
+    namespace
+    {
+        //! Clamps a subpixel coordinate to SUBPIXEL_LIMIT.
+        int clamp_subpixel(long long v)
+        {
+            return (int)std::max(std::min(v, (long long)SUBPIXEL_LIMIT), -(long long)SUBPIXEL_LIMIT);
+        }
+
+        //! Rounds a coordinate in subpixels to the nearest subpixel and clamps it.
+        int round_subpixel(double v)
+        {
+            // also catches NaN
+            if (!(std::fabs(v) < SUBPIXEL_LIMIT))
+            {
+                return v < 0 ? -SUBPIXEL_LIMIT : SUBPIXEL_LIMIT;
+            }
+            return (int)::lround(v);
+        }
+
+        //! Rounds subpixels to the nearest pixel, with halves away from zero.
+        int round_pixel(int v)
+        {
+            const int half = SUBPIXEL_ONE / 2;
+            return v >= 0 ? (v + half) >> SUBPIXEL_BITS : -((-v + half) >> SUBPIXEL_BITS);
+        }
+    }
+
+    FixedPoint FixedPoint::from_pixels(const Point &p)
+    {
+        return {clamp_subpixel((long long)p.x * SUBPIXEL_ONE), clamp_subpixel((long long)p.y * SUBPIXEL_ONE)};
+    }
+
+    FixedPoint FixedPoint::from_double(double x, double y)
+    {
+        return {round_subpixel(x * SUBPIXEL_ONE), round_subpixel(y * SUBPIXEL_ONE)};
+    }
+
+    Point FixedPoint::round() const
+    {
+        return {round_pixel(x), round_pixel(y)};
+    }
+
+    FixedPoint FixedPoint::translate(const FixedPoint &t) const
+    {
+        return {clamp_subpixel((long long)x + t.x), clamp_subpixel((long long)y + t.y)};
+    }
+
+    FixedPoint FixedPoint::rotate(const FixedPoint &origin, int degrees) const
+    {
+        double angle = M_PI * degrees / 180.0;
+        double dx = (double)x - origin.x;
+        double dy = (double)y - origin.y;
+        double s = ::sin(angle);
+        double c = ::cos(angle);
+        return {round_subpixel(origin.x + (c * dx - s * dy)), round_subpixel(origin.y + (s * dx + c * dy))};
+    }
+
+    FixedPoint FixedPoint::scale(const FixedPoint &origin, int v) const
+    {
+        // differences are under 2^31, so the products fit in 64 bits
+        return {clamp_subpixel(origin.x + (x - (long long)origin.x) * v),
+                clamp_subpixel(origin.y + (y - (long long)origin.y) * v)};
+    }
+
+    FixedPoint FixedPoint::fit(double v, double dx, double dy) const
+    {
+        return {round_subpixel(x * v + dx * SUBPIXEL_ONE), round_subpixel(y * v + dy * SUBPIXEL_ONE)};
+    }
+
+    BoundingBox BoundingBox::none()
+    {
+        return {{INT_MAX, INT_MAX}, {INT_MIN, INT_MIN}};
+    }
+
+    bool BoundingBox::empty() const
+    {
+        return min.x > max.x || min.y > max.y;
+    }
+
+    long long BoundingBox::area() const
+    {
+        if (empty())
+        {
+            return 0;
+        }
+        return ((long long)max.x - min.x + 1) * ((long long)max.y - min.y + 1);
+    }
+
+    BoundingBox BoundingBox::merge(const BoundingBox &other) const
+    {
+        return {{std::min(min.x, other.min.x), std::min(min.y, other.min.y)},
+                {std::max(max.x, other.max.x), std::max(max.y, other.max.y)}};
+    }
+
+    BoundingBox BoundingBox::merge(const Point &p) const
+    {
+        return merge(BoundingBox{p, p});
+    }
+
+    bool BoundingBox::intersects(const BoundingBox &other) const
+    {
+        return !empty() && !other.empty() &&
+               min.x <= other.max.x && other.min.x <= max.x &&
+               min.y <= other.max.y && other.min.y <= max.y;
+    }
 }
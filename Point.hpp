@@ -26,6 +26,97 @@ namespace svg
         //! @param v Scale amount.
         //! @return Scaling result.
         Point scale(const Point &origin, int v) const;
+        //! Scale a point about (0, 0) by any factor, then translate it.
+        //! @param v Scale amount.
+        //! @param dx The x-coordinate translation.
+        //! @param dy The y-coordinate translation.
+        //! @return Result, rounded to the nearest point.
+        Point fit(double v, double dx, double dy) const;
+    };
+
+    //! Fractional bits of subpixel coordinates.
+    const int SUBPIXEL_BITS = 8;
+    //! One pixel, in subpixel units.
+    const int SUBPIXEL_ONE = 1 << SUBPIXEL_BITS;
+    //! Largest subpixel coordinate magnitude (2^22 pixels). Coordinates
+    //! are clamped to it, so that differences fit in 32 bits and edge
+    //! products in 64 bits.
+    const int SUBPIXEL_LIMIT = 1 << 30;
+
+    //! Point with 24.8 fixed-point coordinates, in 1/256 of a pixel.
+    //! Element geometry is kept this way from parsing through transforms,
+    //! so fractional coordinates survive and chained transforms do not
+    //! drift; shapes only snap to pixels when they are drawn.
+    struct FixedPoint
+    {
+        //! X coordinate, in subpixels.
+        int x;
+        //! Y coordinate, in subpixels.
+        int y;
+
+        //! Point at the center of a pixel.
+        //! @param p Pixel coordinates.
+        //! @return The same point in subpixels.
+        static FixedPoint from_pixels(const Point &p);
+        //! Point from fractional pixel coordinates.
+        //! @param x The x coordinate, in pixels.
+        //! @param y The y coordinate, in pixels.
+        //! @return Point, rounded to the nearest subpixel and clamped.
+        static FixedPoint from_double(double x, double y);
+        //! Nearest pixel, with halves rounded away from zero.
+        //! @return Pixel coordinates.
+        Point round() const;
+        //! Translate a point.
+        //! @param t translation direction.
+        //! @return Translation result.
+        FixedPoint translate(const FixedPoint &t) const;
+        //! Rotate a point.
+        //! @param origin Rotation origin
+        //! @param degrees Degrees of rotation.
+        //! @return Rotation result, rounded to the nearest subpixel.
+        FixedPoint rotate(const FixedPoint &origin, int degrees) const;
+        //! Scale a point.
+        //! @param origin Scaling origin.
+        //! @param v Scale amount.
+        //! @return Scaling result.
+        FixedPoint scale(const FixedPoint &origin, int v) const;
+        //! Scale a point about (0, 0) by any factor, then translate it.
+        //! @param v Scale amount.
+        //! @param dx The x-coordinate translation, in pixels.
+        //! @param dy The y-coordinate translation, in pixels.
+        //! @return Result, rounded to the nearest subpixel.
+        FixedPoint fit(double v, double dx, double dy) const;
+    };
+
+    //! Axis-aligned box of pixels, with inclusive bounds.
+    struct BoundingBox
+    {
+        //! Top-left corner.
+        Point min;
+        //! Bottom-right corner.
+        Point max;
+
+        //! An empty box, which is the identity for merge().
+        //! @return Empty box.
+        static BoundingBox none();
+        //! Check if the box contains no pixels.
+        //! @return True if the box is empty.
+        bool empty() const;
+        //! Number of pixels in the box.
+        //! @return Area in pixels (0 if empty).
+        long long area() const;
+        //! Smallest box containing this box and another.
+        //! @param other Other box.
+        //! @return Union of both boxes.
+        BoundingBox merge(const BoundingBox &other) const;
+        //! Smallest box containing this box and a point.
+        //! @param p Point to include.
+        //! @return Extended box.
+        BoundingBox merge(const Point &p) const;
+        //! Check if this box and another share a pixel.
+        //! @param other Other box.
+        //! @return True if the boxes intersect.
+        bool intersects(const BoundingBox &other) const;
     };
 }
 #endif
@@ -1,46 +1,159 @@
 #include "SVGElements.hpp"
+#include "Trace.hpp"
+#include <cmath>
+#include <cstdlib>
 
 namespace svg
 {
     // These must be defined!
     SVGElement::SVGElement() {}
     SVGElement::~SVGElement() {}
+    const std::vector<SVGElement *> *SVGElement::children() const
+    {
+        return nullptr;
+    }
+    void SVGElement::render(PNGImage &img) const
+    {
+        Tracer *tracer = Tracer::current();
+        if (tracer == nullptr)
+        {
+            draw(img);
+            return;
+        }
+        double start = tracer->now_us();
+        draw(img);
+        tracer->element(*this, start, tracer->now_us());
+    }
+    const std::string &SVGElement::id() const
+    {
+        return id_attribute;
+    }
+    void SVGElement::set_id(const std::string &id)
+    {
+        id_attribute = id;
+    }
+
+    namespace
+    {
+        //! Bounding box of a set of points, once snapped to pixels.
+        BoundingBox points_box(const std::vector<FixedPoint> &points)
+        {
+            BoundingBox box = BoundingBox::none();
+            for (const FixedPoint &p : points)
+            {
+                box = box.merge(p.round());
+            }
+            return box;
+        }
+
+        //! Same point, in fractional pixels.
+        PathPoint path_point(const FixedPoint &p)
+        {
+            return {(double)p.x / SUBPIXEL_ONE, (double)p.y / SUBPIXEL_ONE};
+        }
+
+        //! Fills a shape with a paint. Solid paints draw straight away;
+        //! gradients shade the image's spans while the shape is drawn.
+        //! @param img The image.
+        //! @param fill The paint.
+        //! @param draw Draws the shape with a color.
+        template <typename Draw>
+        void draw_filled(PNGImage &img, const Paint &fill, Draw draw)
+        {
+            if (fill.gradient == nullptr)
+            {
+                draw(fill.color);
+                return;
+            }
+            const GradientShader shader(fill, img.format());
+            if (shader.valid())
+            {
+                img.set_shader(&shader);
+                draw(fill.color);
+                img.set_shader(nullptr);
+            }
+        }
+    }
 
     // Ellipse
-    Ellipse::Ellipse(const Color &fill,
-                     const Point &center,
-                     const Point &radius,
-                     const Point transform_origin)
-        : fill(fill), center(center), radius(radius), transform_origin(transform_origin)
+    Ellipse::Ellipse(const Paint &fill,
+                     const FixedPoint &center,
+                     const FixedPoint &radius,
+                     const FixedPoint transform_origin,
+                     int orientation)
+        : fill(fill), center(center), radius(radius), transform_origin(transform_origin),
+          orientation(orientation)
     {
     }
     void Ellipse::draw(PNGImage &img) const
     {
-        img.draw_ellipse(center, radius, fill);
+        draw_filled(img, fill, [&](const Color &c)
+                    { img.draw_ellipse(center, radius, c, orientation); });
     }
-    void Ellipse::translate(int x, int y)
+    void Ellipse::translate(double x, double y)
     {
-        center = center.translate({x, y});
+        center = center.translate(FixedPoint::from_double(x, y));
+        fill.translate(x, y);
     }
     void Ellipse::rotate(int v)
     {
         center = center.rotate(transform_origin, v);
+        orientation = (orientation + v) % 360;
+        fill.rotate(path_point(transform_origin), v);
     }
     void Ellipse::scale(int v)
     {
         radius = radius.scale({0, 0}, v);
         center = center.scale(transform_origin, v);
+        fill.scale(path_point(transform_origin), v);
     }
-    SVGElement *Ellipse::clone(const Point transform_origin) const
+    void Ellipse::fit(double v, double dx, double dy)
     {
-        return new Ellipse(this->fill, this->center, this->radius, transform_origin);
+        radius = radius.fit(v, 0, 0);
+        center = center.fit(v, dx, dy);
+        fill.fit(v, dx, dy);
+        transform_origin = transform_origin.fit(v, dx, dy);
+    }
+    SVGElement *Ellipse::clone(const FixedPoint transform_origin) const
+    {
+        return new Ellipse(this->fill, this->center, this->radius, transform_origin, this->orientation);
+    }
+    const char *Ellipse::type_name() const
+    {
+        return "ellipse";
+    }
+    size_t Ellipse::vertex_count() const
+    {
+        return 1;
+    }
+    BoundingBox Ellipse::bounding_box() const
+    {
+        const Point center = this->center.round(), radius = this->radius.round();
+        Point r = {std::abs(radius.x), std::abs(radius.y)};
+        if (orientation % 90 == 0 || r.x == r.y)
+        {
+            if (orientation % 180 != 0)
+            {
+                r = {r.y, r.x};
+            }
+        }
+        else
+        {
+            // extents of the rotated ellipse, plus a pixel for rounding
+            double angle = M_PI * orientation / 180.0;
+            double c = ::cos(angle), s = ::sin(angle);
+            double rx2 = (double)r.x * r.x, ry2 = (double)r.y * r.y;
+            r = {(int)::ceil(::sqrt(rx2 * c * c + ry2 * s * s)) + 1,
+                 (int)::ceil(::sqrt(rx2 * s * s + ry2 * c * c)) + 1};
+        }
+        return {{center.x - r.x, center.y - r.y}, {center.x + r.x, center.y + r.y}};
     }
 
     // Line
     Line::Line(const Color &stroke,
-               const Point &start,
-               const Point &end,
-               const Point transform_origin)
+               const FixedPoint &start,
+               const FixedPoint &end,
+               const FixedPoint transform_origin)
         : stroke(stroke), start(start), end(end), transform_origin(transform_origin)
     {
     }
@@ -48,10 +161,11 @@ namespace svg
     {
         img.draw_line(start, end, stroke);
     }
-    void Line::translate(int x, int y)
+    void Line::translate(double x, double y)
     {
-        start = start.translate({x, y});
-        end = end.translate({x, y});
+        const FixedPoint t = FixedPoint::from_double(x, y);
+        start = start.translate(t);
+        end = end.translate(t);
     }
     void Line::rotate(int v)
     {
@@ -63,63 +177,357 @@ namespace svg
         start = start.scale(transform_origin, v);
         end = end.scale(transform_origin, v);
     }
-    SVGElement *Line::clone(const Point transform_origin) const
+    void Line::fit(double v, double dx, double dy)
+    {
+        start = start.fit(v, dx, dy);
+        end = end.fit(v, dx, dy);
+        transform_origin = transform_origin.fit(v, dx, dy);
+    }
+    SVGElement *Line::clone(const FixedPoint transform_origin) const
     {
         return new Line(this->stroke, this->start, this->end, transform_origin);
     }
+    const char *Line::type_name() const
+    {
+        return "line";
+    }
+    size_t Line::vertex_count() const
+    {
+        return 2;
+    }
+    BoundingBox Line::bounding_box() const
+    {
+        const Point a = start.round();
+        return BoundingBox{a, a}.merge(end.round());
+    }
+
+    // Polyline
+    Polyline::Polyline(const std::vector<FixedPoint> &points,
+                       const Color &stroke,
+                       const FixedPoint transform_origin)
+        : points(points), stroke(stroke), transform_origin(transform_origin)
+    {
+    }
+    void Polyline::draw(PNGImage &img) const
+    {
+        for (size_t i = 1; i < points.size(); i++)
+        {
+            img.draw_line(points[i - 1], points[i], stroke);
+        }
+    }
+    void Polyline::translate(double x, double y)
+    {
+        const FixedPoint t = FixedPoint::from_double(x, y);
+        for (FixedPoint &p : this->points)
+        {
+            p = p.translate(t);
+        }
+    }
+    void Polyline::rotate(int v)
+    {
+        for (FixedPoint &p : this->points)
+        {
+            p = p.rotate(transform_origin, v);
+        }
+    }
+    void Polyline::scale(int v)
+    {
+        for (FixedPoint &p : this->points)
+        {
+            p = p.scale(transform_origin, v);
+        }
+    }
+    void Polyline::fit(double v, double dx, double dy)
+    {
+        for (FixedPoint &p : this->points)
+        {
+            p = p.fit(v, dx, dy);
+        }
+        transform_origin = transform_origin.fit(v, dx, dy);
+    }
+    SVGElement *Polyline::clone(const FixedPoint transform_origin) const
+    {
+        return new Polyline(this->points, this->stroke, transform_origin);
+    }
+    const char *Polyline::type_name() const
+    {
+        return "polyline";
+    }
+    size_t Polyline::vertex_count() const
+    {
+        return points.size();
+    }
+    BoundingBox Polyline::bounding_box() const
+    {
+        return points_box(points);
+    }
 
     // Polygon
-    Polygon::Polygon(const std::vector<Point> &points,
-                     const Color &fill,
-                     const Point transform_origin)
-        : points(points), fill(fill), transform_origin(transform_origin)
+    Polygon::Polygon(const std::vector<FixedPoint> &points,
+                     const Paint &fill,
+                     const FixedPoint transform_origin)
+        : points(points), fill(fill), transform_origin(transform_origin),
+          convex(pixel_convex())
     {
     }
+    bool Polygon::pixel_convex() const
+    {
+        static thread_local std::vector<Point> pixels;
+        pixels.clear();
+        for (const FixedPoint &p : points)
+        {
+            if (p.x % SUBPIXEL_ONE != 0 || p.y % SUBPIXEL_ONE != 0)
+            {
+                return false;
+            }
+            pixels.push_back(p.round());
+        }
+        return PNGImage::is_convex(pixels);
+    }
     void Polygon::draw(PNGImage &img) const
     {
-        img.draw_polygon(points, fill);
+        auto draw_shape = [&](const Color &c)
+        {
+            if (convex)
+            {
+                // kept per thread, so that drawing does not allocate
+                static thread_local std::vector<Point> pixels;
+                pixels.clear();
+                for (const FixedPoint &p : points)
+                {
+                    pixels.push_back(p.round());
+                }
+                img.draw_convex_polygon(pixels, c);
+            }
+            else
+            {
+                img.draw_polygon(points, c);
+            }
+        };
+        draw_filled(img, fill, draw_shape);
     }
-    void Polygon::translate(int x, int y)
+    void Polygon::translate(double x, double y)
     {
-        for (Point &p : this->points)
+        const FixedPoint t = FixedPoint::from_double(x, y);
+        for (FixedPoint &p : this->points)
+        {
+            p = p.translate(t);
+        }
+        fill.translate(x, y);
+        // whole-pixel moves keep the points whole and the shape the same
+        if (t.x % SUBPIXEL_ONE != 0 || t.y % SUBPIXEL_ONE != 0)
         {
-            p = p.translate({x, y});
+            convex = pixel_convex();
         }
     }
     void Polygon::rotate(int v)
     {
-        for (Point &p : this->points)
+        for (FixedPoint &p : this->points)
         {
             p = p.rotate(transform_origin, v);
         }
+        fill.rotate(path_point(transform_origin), v);
+        convex = pixel_convex();
     }
     void Polygon::scale(int v)
     {
-        for (Point &p : this->points)
+        for (FixedPoint &p : this->points)
         {
             p = p.scale(transform_origin, v);
         }
+        fill.scale(path_point(transform_origin), v);
+        // a nonzero whole scale keeps whole points whole and convex shapes convex
+        if (!convex || v == 0)
+        {
+            convex = pixel_convex();
+        }
     }
-    SVGElement *Polygon::clone(const Point transform_origin) const
+    void Polygon::fit(double v, double dx, double dy)
+    {
+        for (FixedPoint &p : this->points)
+        {
+            p = p.fit(v, dx, dy);
+        }
+        fill.fit(v, dx, dy);
+        transform_origin = transform_origin.fit(v, dx, dy);
+        convex = pixel_convex();
+    }
+    SVGElement *Polygon::clone(const FixedPoint transform_origin) const
     {
         return new Polygon(this->points, this->fill, transform_origin);
     }
+    const char *Polygon::type_name() const
+    {
+        return "polygon";
+    }
+    size_t Polygon::vertex_count() const
+    {
+        return points.size();
+    }
+    BoundingBox Polygon::bounding_box() const
+    {
+        return points_box(points);
+    }
+
+    // Rect
+    Rect::Rect(const std::vector<FixedPoint> &corners,
+               const Paint &fill,
+               const FixedPoint transform_origin)
+        : Polygon(corners, fill, transform_origin), aligned(corners_aligned())
+    {
+    }
+    bool Rect::corners_aligned() const
+    {
+        // the first side may be horizontal or, after a quarter turn, vertical
+        const FixedPoint &a = points[0], &b = points[1], &c = points[2], &d = points[3];
+        return (a.y == b.y && b.x == c.x && c.y == d.y && d.x == a.x) ||
+               (a.x == b.x && b.y == c.y && c.x == d.x && d.y == a.y);
+    }
+    void Rect::draw(PNGImage &img) const
+    {
+        if (aligned)
+        {
+            // the polygon rasterizer fills exactly the box spanned by
+            // axis-aligned corners, whatever their order, once rounded
+            draw_filled(img, fill, [&](const Color &c)
+                        { img.draw_rect(points[0].round(), points[2].round(), c); });
+        }
+        else
+        {
+            Polygon::draw(img);
+        }
+    }
+    void Rect::rotate(int v)
+    {
+        Polygon::rotate(v);
+        aligned = corners_aligned();
+    }
+    void Rect::scale(int v)
+    {
+        Polygon::scale(v);
+        aligned = corners_aligned();
+    }
+    void Rect::fit(double v, double dx, double dy)
+    {
+        Polygon::fit(v, dx, dy);
+        aligned = corners_aligned();
+    }
+    SVGElement *Rect::clone(const FixedPoint transform_origin) const
+    {
+        return new Rect(this->points, this->fill, transform_origin);
+    }
+    const char *Rect::type_name() const
+    {
+        return "rect";
+    }
+
+    // Path
+    Path::Path(const std::shared_ptr<const PathGeometry> &geometry,
+               const Paint &fill,
+               bool filled,
+               const Color &stroke,
+               bool stroked,
+               bool even_odd,
+               const FixedPoint transform_origin,
+               const Affine &transform)
+        : geometry(geometry), fill(fill), filled(filled), stroke(stroke), stroked(stroked),
+          even_odd(even_odd), transform_origin(transform_origin), transform(transform)
+    {
+    }
+    void Path::draw(PNGImage &img) const
+    {
+        std::shared_ptr<const FlattenedPath> flat = geometry->flatten(transform.scale_factor());
+        // kept per thread, so that drawing does not allocate
+        static thread_local std::vector<FixedPoint> points;
+        points.clear();
+        for (const PathPoint &p : flat->points)
+        {
+            PathPoint q = transform.apply(p);
+            points.push_back(FixedPoint::from_double(q.x, q.y));
+        }
+        if (filled)
+        {
+            draw_filled(img, fill, [&](const Color &c)
+                        { img.draw_contours(points, flat->contour_ends, c, even_odd); });
+        }
+        if (stroked)
+        {
+            size_t begin = 0;
+            for (size_t i = 0; i < flat->contour_ends.size(); i++)
+            {
+                size_t end = flat->contour_ends[i];
+                for (size_t j = begin; j + 1 < end; j++)
+                {
+                    img.draw_line(points[j], points[j + 1], stroke);
+                }
+                if (flat->closed[i])
+                {
+                    img.draw_line(points[end - 1], points[begin], stroke);
+                }
+                begin = end;
+            }
+        }
+    }
+    void Path::translate(double x, double y)
+    {
+        transform = transform.translate(x, y);
+        fill.translate(x, y);
+    }
+    void Path::rotate(int v)
+    {
+        transform = transform.rotate(path_point(transform_origin), v);
+        fill.rotate(path_point(transform_origin), v);
+    }
+    void Path::scale(int v)
+    {
+        transform = transform.scale(path_point(transform_origin), v);
+        fill.scale(path_point(transform_origin), v);
+    }
+    void Path::fit(double v, double dx, double dy)
+    {
+        transform = transform.scale({0, 0}, v).translate(dx, dy);
+        fill.fit(v, dx, dy);
+        transform_origin = transform_origin.fit(v, dx, dy);
+    }
+    SVGElement *Path::clone(const FixedPoint transform_origin) const
+    {
+        return new Path(this->geometry, this->fill, this->filled, this->stroke, this->stroked,
+                        this->even_odd, transform_origin, this->transform);
+    }
+    const char *Path::type_name() const
+    {
+        return "path";
+    }
+    size_t Path::vertex_count() const
+    {
+        return geometry->point_count();
+    }
+    BoundingBox Path::bounding_box() const
+    {
+        return geometry->bounds(transform);
+    }
 
     // Group
     Group::Group(const std::vector<SVGElement *> &elements,
-                 const Point transform_origin)
+                 const FixedPoint transform_origin)
         : elements(elements), transform_origin(transform_origin)
     {
     }
-    void Group::draw(PNGImage &img) const
+    Group::~Group()
     {
         for (SVGElement *elem : elements)
         {
-            elem->draw(img);
             delete elem;
         }
     }
-    void Group::translate(int x, int y)
+    void Group::draw(PNGImage &img) const
+    {
+        for (SVGElement *elem : elements)
+        {
+            elem->render(img);
+        }
+    }
+    void Group::translate(double x, double y)
     {
         for (SVGElement *elem : elements)
         {
@@ -140,7 +548,15 @@ namespace svg
             elem->scale(v);
         }
     }
-    SVGElement *Group::clone(const Point transform_origin) const
+    void Group::fit(double v, double dx, double dy)
+    {
+        for (SVGElement *elem : elements)
+        {
+            elem->fit(v, dx, dy);
+        }
+        transform_origin = transform_origin.fit(v, dx, dy);
+    }
+    SVGElement *Group::clone(const FixedPoint transform_origin) const
     {
         std::vector<SVGElement *> cloned_elements;
         for (SVGElement *elem : elements)
@@ -149,17 +565,38 @@ namespace svg
         }
         return new Group(cloned_elements, transform_origin);
     }
+    const char *Group::type_name() const
+    {
+        return "g";
+    }
+    size_t Group::vertex_count() const
+    {
+        return 0;
+    }
+    BoundingBox Group::bounding_box() const
+    {
+        BoundingBox box = BoundingBox::none();
+        for (const SVGElement *elem : elements)
+        {
+            box = box.merge(elem->bounding_box());
+        }
+        return box;
+    }
+    const std::vector<SVGElement *> *Group::children() const
+    {
+        return &elements;
+    }
 
     // Use
     Use::Use(SVGElement *copied,
-             const Point transform_origin)
+             const FixedPoint transform_origin)
         : copied(copied), transform_origin(transform_origin)
     {
     }
     void Use::draw(PNGImage &img) const
     {
     }
-    void Use::translate(int x, int y)
+    void Use::translate(double x, double y)
     {
         copied->translate(x, y);
     }
@@ -171,8 +608,24 @@ namespace svg
     {
         copied->scale(v);
     }
-    SVGElement *Use::clone(const Point transform_origin) const
+    void Use::fit(double v, double dx, double dy)
+    {
+        copied->fit(v, dx, dy);
+    }
+    SVGElement *Use::clone(const FixedPoint transform_origin) const
     {
         return new Use(this->copied, transform_origin);
     }
+    const char *Use::type_name() const
+    {
+        return "use";
+    }
+    size_t Use::vertex_count() const
+    {
+        return 0;
+    }
+    BoundingBox Use::bounding_box() const
+    {
+        return BoundingBox::none();
+    }
 }
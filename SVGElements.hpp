@@ -3,12 +3,28 @@
 #define __svg_SVGElements_hpp__
 
 #include "Color.hpp"
+#include "Gradient.hpp"
+#include "Limits.hpp"
 #include "Point.hpp"
 #include "PNGImage.hpp"
+#include "Path.hpp"
 #include <map>
+#include <memory>
+#include <string>
+
+namespace tinyxml2
+{
+    class XMLDocument;
+}
 
 namespace svg
 {
+    struct RenderStats;
+    struct CostEstimate;
+    struct OverdrawStats;
+    class Tracer;
+    class SpatialIndex;
+
     //! Base class for SVG elements.
     class SVGElement
     {
@@ -23,10 +39,15 @@ namespace svg
         //! @param img The PNGImage object to draw on.
         virtual void draw(PNGImage &img) const = 0;
 
+        //! Draws the SVG element, recording the call if tracing is on.
+        //! Containers render their members through this as well.
+        //! @param img The PNGImage object to draw on.
+        void render(PNGImage &img) const;
+
         //! Translates the SVG element by the given x and y values.
-        //! @param x The x-coordinate translation.
-        //! @param y The y-coordinate translation.
-        virtual void translate(int x, int y) = 0;
+        //! @param x The x-coordinate translation, in pixels (may be fractional).
+        //! @param y The y-coordinate translation, in pixels (may be fractional).
+        virtual void translate(double x, double y) = 0;
 
         //! Rotates the SVG element by the given angle.
         //! @param v The angle to rotate the element.
@@ -36,10 +57,44 @@ namespace svg
         //! @param v The scaling factor.
         virtual void scale(int v) = 0;
 
+        //! Maps the SVG element from document to image coordinates:
+        //! every point p becomes p * v + (dx, dy).
+        //! @param v The scaling factor.
+        //! @param dx The x-coordinate translation, after scaling.
+        //! @param dy The y-coordinate translation, after scaling.
+        virtual void fit(double v, double dx, double dy) = 0;
+
         //! Clones the SVG element with a new transform origin.
         //! @param transform_origin The new transform origin.
         //! @return A pointer to the cloned SVGElement.
-        virtual SVGElement *clone(const Point transform_origin) const = 0;
+        virtual SVGElement *clone(const FixedPoint transform_origin) const = 0;
+
+        //! Gets the name of the element type.
+        //! @return The SVG tag name of the element.
+        virtual const char *type_name() const = 0;
+
+        //! Gets the number of vertices of the element (excluding group members).
+        //! @return The vertex count.
+        virtual size_t vertex_count() const = 0;
+
+        //! Gets the members of a container element.
+        //! @return A pointer to the member elements, or nullptr for a shape.
+        virtual const std::vector<SVGElement *> *children() const;
+
+        //! Gets the pixels the element may draw to.
+        //! @return A box containing every pixel drawn by the element.
+        virtual BoundingBox bounding_box() const = 0;
+
+        //! Gets the id attribute of the element.
+        //! @return The id, or an empty string.
+        const std::string &id() const;
+
+        //! Sets the id attribute of the element.
+        //! @param id The id.
+        void set_id(const std::string &id);
+
+    private:
+        std::string id_attribute; //!< The id attribute of the element.
     };
 
     //! Reads an SVG file and extracts its elements.
@@ -50,25 +105,185 @@ namespace svg
                  Point &dimensions,
                  std::vector<SVGElement *> &svg_elements);
 
+    struct ConvertOptions;
+
+    //! Extracts the elements of an SVG document that is already loaded.
+    //! @param doc The loaded XML document.
+    //! @param dimensions The dimensions of the SVG canvas.
+    //! @param svg_elements A vector to store the extracted SVG elements.
+    //! @param stats Statistics to add transform time to (optional).
+    //! @param guard Limits to enforce while reading (optional). Throws
+    //! LimitExceeded, after deleting the elements it read, if the
+    //! document goes over one.
+    //! @param options Output options (optional). If given, the output
+    //! canvas is checked as soon as the root element is read, before
+    //! any child element (see check_output_canvas).
+    void readSVG(tinyxml2::XMLDocument &doc,
+                 Point &dimensions,
+                 std::vector<SVGElement *> &svg_elements,
+                 RenderStats *stats = nullptr,
+                 LimitGuard *guard = nullptr,
+                 const ConvertOptions *options = nullptr);
+
+    //! Options for converting an SVG file.
+    struct ConvertOptions
+    {
+        //! Output width in pixels, or 0 to derive it from the document.
+        //! With only one of width and height set, the other follows the
+        //! document's aspect ratio; with both set, the drawing is scaled
+        //! to fit and centered.
+        int width = 0;
+        //! Output height in pixels, or 0 to derive it from the document.
+        int height = 0;
+        //! Extra scale factor, applied after width and height.
+        double scale = 1;
+        //! If set, filled with statistics about the conversion.
+        RenderStats *stats = nullptr;
+        //! If set, records phases and element draw calls.
+        Tracer *trace = nullptr;
+        //! If set, filled with a summary of pixel overdraw.
+        OverdrawStats *overdraw = nullptr;
+        //! If not empty, an overdraw heatmap is saved to this file.
+        std::string overdraw_heatmap;
+        //! If positive, the image is drawn and written in bands of this
+        //! many rows, so it never has to fit in memory as a whole.
+        int strip_height = 0;
+        //! Limits on the resources the conversion may use.
+        ResourceLimits limits;
+    };
+
+    //! Checks the output canvas of a document against the options.
+    //! Throws LimitExceeded if a side is not positive (EmptyCanvas) or
+    //! the canvas is over the limit (CanvasPixels).
+    //! @param dimensions Document dimensions.
+    //! @param options Conversion options (width, height, scale and the
+    //! canvas limit are used).
+    void check_output_canvas(const Point &dimensions, const ConvertOptions &options);
+
+    //! Resizes a scene to the output size requested in the options.
+    //! The scale is folded into the element geometry, so drawing
+    //! costs what the output size costs. Throws LimitExceeded as
+    //! check_output_canvas does.
+    //! @param dimensions Document dimensions, replaced by the output size.
+    //! @param svg_elements Scene elements, mapped to the output size.
+    //! @param options Conversion options (width, height, scale and the
+    //! canvas limit are used).
+    void fit_output(Point &dimensions,
+                    std::vector<SVGElement *> &svg_elements,
+                    const ConvertOptions &options);
+
     //! Converts an SVG file to a PNG file.
     //! @param svg_file The path to the SVG file.
     //! @param png_file The path to the output PNG file.
     void convert(const std::string &svg_file,
                  const std::string &png_file);
 
+    //! Converts an SVG file to a PNG file.
+    //! @param svg_file The path to the SVG file.
+    //! @param png_file The path to the output PNG file.
+    //! @param options Conversion options.
+    void convert(const std::string &svg_file,
+                 const std::string &png_file,
+                 const ConvertOptions &options);
+
+    //! Predicts the cost of converting an SVG file, by reading the
+    //! elements at the output size without drawing them. Limits in the
+    //! options are enforced as in convert().
+    //! @param svg_file The path to the SVG file.
+    //! @param options Conversion options (output size, strip height and
+    //! limits are used).
+    //! @return The estimate.
+    CostEstimate estimate_cost(const std::string &svg_file,
+                               const ConvertOptions &options = ConvertOptions());
+
+    //! Predicts the cost of converting an SVG document that is already
+    //! loaded.
+    //! @param doc The loaded XML document.
+    //! @param options Conversion options.
+    //! @return The estimate.
+    CostEstimate estimate_cost(tinyxml2::XMLDocument &doc,
+                               const ConvertOptions &options = ConvertOptions());
+
+    //! A parsed SVG document, ready to be drawn any number of times.
+    class Scene
+    {
+    public:
+        //! Loads an SVG file.
+        //! @param svg_file The path to the SVG file.
+        //! @param options Conversion options (width, height and scale are used).
+        explicit Scene(const std::string &svg_file,
+                       const ConvertOptions &options = ConvertOptions());
+
+        //! Builds a scene from an SVG document that is already loaded.
+        //! @param doc The loaded XML document.
+        //! @param options Conversion options (width, height and scale are used).
+        explicit Scene(tinyxml2::XMLDocument &doc,
+                       const ConvertOptions &options = ConvertOptions());
+
+        //! Destroys the scene and its elements.
+        ~Scene();
+
+        //! Gets the size of the drawing.
+        //! @return Width and height in pixels.
+        const Point &dimensions() const;
+
+        //! Gets the top-level elements, in drawing order.
+        //! @return The elements.
+        const std::vector<SVGElement *> &elements() const;
+
+        //! Draws the scene on an image, which may wrap caller-owned memory.
+        //! The image is not cleared first, and parts of the drawing outside
+        //! it are clipped.
+        //! @param img The PNGImage object to draw on.
+        void render(PNGImage &img) const;
+
+        //! Draws the part of the scene under an image placed at (left, top)
+        //! of the drawing, e.g. one tile of a large document. Only shapes
+        //! whose bounding box meets the image are drawn, and the result is
+        //! the same as cropping a full render. The image is not cleared
+        //! first, and keeps the placement (see PNGImage::set_left).
+        //! @param img The PNGImage object to draw on.
+        //! @param left Drawing column of the first image column.
+        //! @param top Drawing row of the first image row.
+        //! @return Number of shapes drawn.
+        size_t render_region(PNGImage &img, int left, int top) const;
+
+        //! Gets the number of shapes, not counting groups.
+        //! @return The shape count.
+        size_t shape_count() const;
+
+        //! Gets the spatial index over the shapes, for hit-testing and
+        //! region queries.
+        //! @return The index.
+        const SpatialIndex &index() const;
+
+    private:
+        Scene(const Scene &) = delete;
+        Scene &operator=(const Scene &) = delete;
+        //! Builds the elements of a loaded document.
+        //! @param doc The loaded XML document.
+        //! @param options Conversion options.
+        void build(tinyxml2::XMLDocument &doc, const ConvertOptions &options);
+        Point dimensions_;                    //!< The size of the drawing.
+        std::vector<SVGElement *> elements_;  //!< The top-level elements.
+        std::unique_ptr<SpatialIndex> index_; //!< Index over the shapes.
+    };
+
     //! Class representing an ellipse SVG element.
     class Ellipse : public SVGElement
     {
     public:
         //! Constructs an Ellipse object.
-        //! @param fill The fill color of the ellipse.
+        //! @param fill The fill of the ellipse.
         //! @param center The center point of the ellipse.
         //! @param radius The radius of the ellipse.
         //! @param transform_origin The transform origin for the ellipse.
-        Ellipse(const Color &fill,
-                const Point &center,
-                const Point &radius,
-                const Point transform_origin);
+        //! @param orientation The rotation of the ellipse axes, in degrees.
+        Ellipse(const Paint &fill,
+                const FixedPoint &center,
+                const FixedPoint &radius,
+                const FixedPoint transform_origin,
+                int orientation = 0);
 
         //! Draws the ellipse on a PNGImage.
         //! @param img The PNGImage object to draw on.
@@ -77,7 +292,7 @@ namespace svg
         //! Translates the ellipse by the given x and y values.
         //! @param x The x-coordinate translation.
         //! @param y The y-coordinate translation.
-        void translate(int x, int y) override;
+        void translate(double x, double y) override;
 
         //! Rotates the ellipse by the given angle.
         //! @param v The angle to rotate the ellipse.
@@ -87,16 +302,35 @@ namespace svg
         //! @param v The scaling factor.
         void scale(int v) override;
 
+        //! Maps the element from document to image coordinates.
+        //! @param v The scaling factor.
+        //! @param dx The x-coordinate translation, after scaling.
+        //! @param dy The y-coordinate translation, after scaling.
+        void fit(double v, double dx, double dy) override;
+
         //! Clones the ellipse with a new transform origin.
         //! @param transform_origin The new transform origin.
         //! @return A pointer to the cloned Ellipse.
-        SVGElement *clone(const Point transform_origin) const override;
+        SVGElement *clone(const FixedPoint transform_origin) const override;
+
+        //! Gets the name of the element type.
+        //! @return The SVG tag name of the element.
+        const char *type_name() const override;
+
+        //! Gets the number of vertices of the element.
+        //! @return The vertex count.
+        size_t vertex_count() const override;
+
+        //! Gets the pixels the element may draw to.
+        //! @return A box containing every pixel drawn by the element.
+        BoundingBox bounding_box() const override;
 
     private:
-        Color fill;             //!< The fill color of the ellipse.
-        Point center;           //!< The center point of the ellipse.
-        Point radius;           //!< The radius of the ellipse.
-        Point transform_origin; //!< The transform origin for the ellipse.
+        Paint fill;                  //!< The fill of the ellipse.
+        FixedPoint center;           //!< The center point of the ellipse.
+        FixedPoint radius;           //!< The radius of the ellipse.
+        FixedPoint transform_origin; //!< The transform origin for the ellipse.
+        int orientation;             //!< The rotation of the ellipse axes, in degrees.
     };
 
     //! Class representing a line SVG element.
@@ -109,9 +343,9 @@ namespace svg
         //! @param end The ending point of the line.
         //! @param transform_origin The transform origin for the line.
         Line(const Color &stroke,
-             const Point &start,
-             const Point &end,
-             const Point transform_origin);
+             const FixedPoint &start,
+             const FixedPoint &end,
+             const FixedPoint transform_origin);
 
         //! Draws the line on a PNGImage.
         //! @param img The PNGImage object to draw on.
@@ -120,7 +354,7 @@ namespace svg
         //! Translates the line by the given x and y values.
         //! @param x The x-coordinate translation.
         //! @param y The y-coordinate translation.
-        void translate(int x, int y) override;
+        void translate(double x, double y) override;
 
         //! Rotates the line by the given angle.
         //! @param v The angle to rotate the line.
@@ -130,16 +364,92 @@ namespace svg
         //! @param v The scaling factor.
         void scale(int v) override;
 
+        //! Maps the element from document to image coordinates.
+        //! @param v The scaling factor.
+        //! @param dx The x-coordinate translation, after scaling.
+        //! @param dy The y-coordinate translation, after scaling.
+        void fit(double v, double dx, double dy) override;
+
         //! Clones the line with a new transform origin.
         //! @param transform_origin The new transform origin.
         //! @return A pointer to the cloned Line.
-        SVGElement *clone(const Point transform_origin) const override;
+        SVGElement *clone(const FixedPoint transform_origin) const override;
+
+        //! Gets the name of the element type.
+        //! @return The SVG tag name of the element.
+        const char *type_name() const override;
+
+        //! Gets the number of vertices of the element.
+        //! @return The vertex count.
+        size_t vertex_count() const override;
+
+        //! Gets the pixels the element may draw to.
+        //! @return A box containing every pixel drawn by the element.
+        BoundingBox bounding_box() const override;
 
     private:
-        Color stroke;           //!< The stroke color of the line.
-        Point start;            //!< The starting point of the line.
-        Point end;              //!< The ending point of the line.
-        Point transform_origin; //!< The transform origin for the line.
+        Color stroke;                //!< The stroke color of the line.
+        FixedPoint start;            //!< The starting point of the line.
+        FixedPoint end;              //!< The ending point of the line.
+        FixedPoint transform_origin; //!< The transform origin for the line.
+    };
+
+    //! Class representing a polyline SVG element.
+    class Polyline : public SVGElement
+    {
+    public:
+        //! Constructs a Polyline object.
+        //! @param points The points defining the polyline.
+        //! @param stroke The stroke color of the polyline.
+        //! @param transform_origin The transform origin for the polyline.
+        Polyline(const std::vector<FixedPoint> &points,
+                 const Color &stroke,
+                 const FixedPoint transform_origin);
+
+        //! Draws the polyline on a PNGImage.
+        //! @param img The PNGImage object to draw on.
+        void draw(PNGImage &img) const override;
+
+        //! Translates the polyline by the given x and y values.
+        //! @param x The x-coordinate translation.
+        //! @param y The y-coordinate translation.
+        void translate(double x, double y) override;
+
+        //! Rotates the polyline by the given angle.
+        //! @param v The angle to rotate the polyline.
+        void rotate(int v) override;
+
+        //! Scales the polyline by the given factor.
+        //! @param v The scaling factor.
+        void scale(int v) override;
+
+        //! Maps the element from document to image coordinates.
+        //! @param v The scaling factor.
+        //! @param dx The x-coordinate translation, after scaling.
+        //! @param dy The y-coordinate translation, after scaling.
+        void fit(double v, double dx, double dy) override;
+
+        //! Clones the polyline with a new transform origin.
+        //! @param transform_origin The new transform origin.
+        //! @return A pointer to the cloned Polyline.
+        SVGElement *clone(const FixedPoint transform_origin) const override;
+
+        //! Gets the name of the element type.
+        //! @return The SVG tag name of the element.
+        const char *type_name() const override;
+
+        //! Gets the number of vertices of the element.
+        //! @return The vertex count.
+        size_t vertex_count() const override;
+
+        //! Gets the pixels the element may draw to.
+        //! @return A box containing every pixel drawn by the element.
+        BoundingBox bounding_box() const override;
+
+    private:
+        std::vector<FixedPoint> points; //!< The points defining the polyline.
+        Color stroke;                   //!< The stroke color of the polyline.
+        FixedPoint transform_origin;    //!< The transform origin for the polyline.
     };
 
     //! Class representing a polygon SVG element.
@@ -148,11 +458,11 @@ namespace svg
     public:
         //! Constructs a Polygon object.
         //! @param points The points defining the polygon.
-        //! @param fill The fill color of the polygon.
+        //! @param fill The fill of the polygon.
         //! @param transform_origin The transform origin for the polygon.
-        Polygon(const std::vector<Point> &points,
-                const Color &fill,
-                const Point transform_origin);
+        Polygon(const std::vector<FixedPoint> &points,
+                const Paint &fill,
+                const FixedPoint transform_origin);
 
         //! Draws the polygon on a PNGImage.
         //! @param img The PNGImage object to draw on.
@@ -161,7 +471,7 @@ namespace svg
         //! Translates the polygon by the given x and y values.
         //! @param x The x-coordinate translation.
         //! @param y The y-coordinate translation.
-        void translate(int x, int y) override;
+        void translate(double x, double y) override;
 
         //! Rotates the polygon by the given angle.
         //! @param v The angle to rotate the polygon.
@@ -171,15 +481,162 @@ namespace svg
         //! @param v The scaling factor.
         void scale(int v) override;
 
+        //! Maps the element from document to image coordinates.
+        //! @param v The scaling factor.
+        //! @param dx The x-coordinate translation, after scaling.
+        //! @param dy The y-coordinate translation, after scaling.
+        void fit(double v, double dx, double dy) override;
+
         //! Clones the polygon with a new transform origin.
         //! @param transform_origin The new transform origin.
         //! @return A pointer to the cloned Polygon.
-        SVGElement *clone(const Point transform_origin) const override;
+        SVGElement *clone(const FixedPoint transform_origin) const override;
+
+        //! Gets the name of the element type.
+        //! @return The SVG tag name of the element.
+        const char *type_name() const override;
+
+        //! Gets the number of vertices of the element.
+        //! @return The vertex count.
+        size_t vertex_count() const override;
+
+        //! Gets the pixels the element may draw to.
+        //! @return A box containing every pixel drawn by the element.
+        BoundingBox bounding_box() const override;
+
+    protected:
+        //! Checks if the points are whole pixels forming a convex polygon,
+        //! which the convex rasterizer fills with the same pixels.
+        //! @return True if the polygon can be drawn as convex.
+        bool pixel_convex() const;
+
+        std::vector<FixedPoint> points; //!< The points defining the polygon.
+        Paint fill;                     //!< The fill of the polygon.
+        FixedPoint transform_origin;    //!< The transform origin for the polygon.
+        bool convex;                    //!< Result of pixel_convex() (updated by transforms).
+    };
+
+    //! Class representing a rect SVG element.
+    //! A rectangle is a polygon whose corners stay axis-aligned through
+    //! translations and scaling, and is then filled as a block. Once
+    //! rotated off the axes, it is drawn as a polygon.
+    class Rect : public Polygon
+    {
+    public:
+        //! Constructs a Rect object.
+        //! @param corners The four corners, in outline order, inclusive.
+        //! @param fill The fill of the rectangle.
+        //! @param transform_origin The transform origin for the rectangle.
+        Rect(const std::vector<FixedPoint> &corners,
+             const Paint &fill,
+             const FixedPoint transform_origin);
+
+        //! Draws the rectangle on a PNGImage.
+        //! @param img The PNGImage object to draw on.
+        void draw(PNGImage &img) const override;
+
+        //! Rotates the rectangle by the given angle.
+        //! @param v The angle to rotate the rectangle.
+        void rotate(int v) override;
+
+        //! Scales the rectangle by the given factor.
+        //! @param v The scaling factor.
+        void scale(int v) override;
+
+        //! Maps the element from document to image coordinates.
+        //! @param v The scaling factor.
+        //! @param dx The x-coordinate translation, after scaling.
+        //! @param dy The y-coordinate translation, after scaling.
+        void fit(double v, double dx, double dy) override;
+
+        //! Clones the rectangle with a new transform origin.
+        //! @param transform_origin The new transform origin.
+        //! @return A pointer to the cloned Rect.
+        SVGElement *clone(const FixedPoint transform_origin) const override;
+
+        //! Gets the name of the element type.
+        //! @return The SVG tag name of the element.
+        const char *type_name() const override;
 
     private:
-        std::vector<Point> points; //!< The points defining the polygon.
-        Color fill;                //!< The fill color of the polygon.
-        Point transform_origin;    //!< The transform origin for the polygon.
+        //! Checks if the corners are still axis-aligned.
+        //! @return True if the corners form an axis-aligned box.
+        bool corners_aligned() const;
+
+        bool aligned; //!< Whether the corners form an axis-aligned box (updated by transforms).
+    };
+
+    //! Class representing a path SVG element.
+    class Path : public SVGElement
+    {
+    public:
+        //! Constructs a Path object.
+        //! @param geometry The path geometry, shared between copies.
+        //! @param fill The fill of the path.
+        //! @param filled Whether the path is filled.
+        //! @param stroke The stroke color of the path.
+        //! @param stroked Whether the path is stroked.
+        //! @param even_odd Whether the even-odd fill rule is used.
+        //! @param transform_origin The transform origin for the path.
+        //! @param transform The transform from path to image coordinates.
+        Path(const std::shared_ptr<const PathGeometry> &geometry,
+             const Paint &fill,
+             bool filled,
+             const Color &stroke,
+             bool stroked,
+             bool even_odd,
+             const FixedPoint transform_origin,
+             const Affine &transform = Affine::identity());
+
+        //! Draws the path on a PNGImage.
+        //! @param img The PNGImage object to draw on.
+        void draw(PNGImage &img) const override;
+
+        //! Translates the path by the given x and y values.
+        //! @param x The x-coordinate translation.
+        //! @param y The y-coordinate translation.
+        void translate(double x, double y) override;
+
+        //! Rotates the path by the given angle.
+        //! @param v The angle to rotate the path.
+        void rotate(int v) override;
+
+        //! Scales the path by the given factor.
+        //! @param v The scaling factor.
+        void scale(int v) override;
+
+        //! Maps the element from document to image coordinates.
+        //! @param v The scaling factor.
+        //! @param dx The x-coordinate translation, after scaling.
+        //! @param dy The y-coordinate translation, after scaling.
+        void fit(double v, double dx, double dy) override;
+
+        //! Clones the path with a new transform origin.
+        //! @param transform_origin The new transform origin.
+        //! @return A pointer to the cloned Path.
+        SVGElement *clone(const FixedPoint transform_origin) const override;
+
+        //! Gets the name of the element type.
+        //! @return The SVG tag name of the element.
+        const char *type_name() const override;
+
+        //! Gets the number of vertices of the element.
+        //! @return The vertex count.
+        size_t vertex_count() const override;
+
+        //! Gets the pixels the element may draw to.
+        //! @return A box containing every pixel drawn by the element.
+        BoundingBox bounding_box() const override;
+
+    private:
+        std::shared_ptr<const PathGeometry> geometry; //!< The path geometry.
+        Paint fill;                                   //!< The fill of the path.
+        bool filled;                                  //!< Whether the path is filled.
+        Color stroke;                                 //!< The stroke color of the path.
+        bool stroked;                                 //!< Whether the path is stroked.
+        bool even_odd;                                //!< Whether the even-odd fill rule is used.
+        FixedPoint transform_origin;                  //!< The transform origin for the path.
+        Affine transform;                             //!< The transform from path to image coordinates.
     };
 
     //! Class representing a group of SVG elements.
@@ -187,10 +644,14 @@ namespace svg
     {
     public:
         //! Constructs a Group object.
+        //! The group takes ownership of the elements.
         //! @param elements The vector of SVGElement pointers.
         //! @param transform_origin The transform origin for the group.
         Group(const std::vector<SVGElement *> &elements,
-              const Point transform_origin);
+              const FixedPoint transform_origin);
+
+        //! Destroys the group and its elements.
+        ~Group() override;
 
         //! Draws the group of elements on a PNGImage.
         //! @param img The PNGImage object to draw on.
@@ -199,7 +660,7 @@ namespace svg
         //! Translates the group by the given x and y values.
         //! @param x The x-coordinate translation.
         //! @param y The y-coordinate translation.
-        void translate(int x, int y) override;
+        void translate(double x, double y) override;
 
         //! Rotates the group by the given angle.
         //! @param v The angle to rotate the group.
@@ -209,14 +670,38 @@ namespace svg
         //! @param v The scaling factor.
         void scale(int v) override;
 
+        //! Maps the element from document to image coordinates.
+        //! @param v The scaling factor.
+        //! @param dx The x-coordinate translation, after scaling.
+        //! @param dy The y-coordinate translation, after scaling.
+        void fit(double v, double dx, double dy) override;
+
         //! Clones the group with a new transform origin.
         //! @param transform_origin The new transform origin.
         //! @return A pointer to the cloned Group.
-        SVGElement *clone(const Point transform_origin) const override;
+        SVGElement *clone(const FixedPoint transform_origin) const override;
+
+        //! Gets the name of the element type.
+        //! @return The SVG tag name of the element.
+        const char *type_name() const override;
+
+        //! Gets the number of vertices of the element.
+        //! @return The vertex count.
+        size_t vertex_count() const override;
+
+        //! Gets the pixels the element may draw to.
+        //! @return A box containing every pixel drawn by the element.
+        BoundingBox bounding_box() const override;
+
+        //! Gets the members of the group.
+        //! @return A pointer to the member elements.
+        const std::vector<SVGElement *> *children() const override;
 
     private:
+        Group(const Group &) = delete;
+        Group &operator=(const Group &) = delete;
         std::vector<SVGElement *> elements; //!< The vector of SVGElement pointers.
-        Point transform_origin;             //!< The transform origin for the group.
+        FixedPoint transform_origin;        //!< The transform origin for the group.
     };
 
     //! Class representing a 'use' element that references another SVG element.
@@ -227,7 +712,7 @@ namespace svg
         //! @param copied The SVGElement being referenced.
         //! @param transform_origin The transform origin for the use element.
         Use(SVGElement *copied,
-            const Point transform_origin);
+            const FixedPoint transform_origin);
 
         //! Draws the referenced element on a PNGImage.
         //! @param img The PNGImage object to draw on.
@@ -236,7 +721,7 @@ namespace svg
         //! Translates the referenced element by the given x and y values.
         //! @param x The x-coordinate translation.
         //! @param y The y-coordinate translation.
-        void translate(int x, int y) override;
+        void translate(double x, double y) override;
 
         //! Rotates the referenced element by the given angle.
         //! @param v The angle to rotate the element.
@@ -246,14 +731,32 @@ namespace svg
         //! @param v The scaling factor.
         void scale(int v) override;
 
+        //! Maps the element from document to image coordinates.
+        //! @param v The scaling factor.
+        //! @param dx The x-coordinate translation, after scaling.
+        //! @param dy The y-coordinate translation, after scaling.
+        void fit(double v, double dx, double dy) override;
+
         //! Clones the use element with a new transform origin.
         //! @param transform_origin The new transform origin.
         //! @return A pointer to the cloned Use element.
-        SVGElement *clone(const Point transform_origin) const override;
+        SVGElement *clone(const FixedPoint transform_origin) const override;
+
+        //! Gets the name of the element type.
+        //! @return The SVG tag name of the element.
+        const char *type_name() const override;
+
+        //! Gets the number of vertices of the element.
+        //! @return The vertex count.
+        size_t vertex_count() const override;
+
+        //! Gets the pixels the element may draw to.
+        //! @return A box containing every pixel drawn by the element.
+        BoundingBox bounding_box() const override;
 
     private:
-        SVGElement *copied;     //!< The SVGElement being referenced.
-        Point transform_origin; //!< The transform origin for the use element.
+        SVGElement *copied;          //!< The SVGElement being referenced.
+        FixedPoint transform_origin; //!< The transform origin for the use element.
     };
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,120 @@
+//! @file SceneGenerator.cpp
+#include "SceneGenerator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <vector>
+
+namespace svg
+{
+    SceneRandom::SceneRandom(unsigned long long seed)
+        : state(seed ? seed : 0x9E3779B97F4A7C15ULL)
+    {
+    }
+
+    int SceneRandom::uniform(int lo, int hi)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return lo + (int)(state % (unsigned long long)(hi - lo + 1));
+    }
+
+    namespace
+    {
+        //! Random '#rrggbb' color.
+        std::string random_color(SceneRandom &rnd)
+        {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "#%06x", rnd.uniform(0, 0xFFFFFF));
+            return buf;
+        }
+
+        //! Write a random star-shaped (hence simple) polygon.
+        void write_polygon(const SceneParams &params, SceneRandom &rnd, int index, std::ostream &out)
+        {
+            int size = std::max(2, std::min(params.polygon_size, std::min(params.width, params.height) - 1));
+            int cx = rnd.uniform(size / 2, params.width - 1 - size / 2);
+            int cy = rnd.uniform(size / 2, params.height - 1 - size / 2);
+            int vertices = std::max(params.vertices, 3);
+            std::vector<int> angles;
+            for (int i = 0; i < vertices; i++)
+            {
+                angles.push_back(rnd.uniform(0, 35999));
+            }
+            std::sort(angles.begin(), angles.end());
+            out << "<polygon id=\"p" << index << "\" points=\"";
+            for (int angle : angles)
+            {
+                double a = M_PI * angle / 18000.0;
+                int r = rnd.uniform(1, size / 2);
+                out << cx + (int)::lround(r * ::cos(a)) << ',' << cy + (int)::lround(r * ::sin(a)) << ' ';
+            }
+            out << "\" fill=\"" << random_color(rnd) << "\"/>\n";
+        }
+    }
+
+    void generate_scene(const SceneParams &params, std::ostream &out)
+    {
+        SceneRandom rnd(params.seed);
+        out << "<svg width=\"" << params.width << "\" height=\"" << params.height
+            << "\" xmlns=\"http://www.w3.org/2000/svg\">\n";
+
+        // polygons live in the innermost of 'depth' nested groups
+        for (int d = 0; d < params.depth; d++)
+        {
+            out << "<g id=\"g" << d << "\">\n";
+        }
+        for (int i = 0; i < params.polygons; i++)
+        {
+            write_polygon(params, rnd, i, out);
+        }
+        for (int d = 0; d < params.depth; d++)
+        {
+            out << "</g>\n";
+        }
+
+        for (int i = 0; i < params.uses && params.polygons > 0; i++)
+        {
+            out << "<use href=\"#p" << rnd.uniform(0, params.polygons - 1)
+                << "\" transform=\"translate(" << rnd.uniform(-params.width / 4, params.width / 4)
+                << ' ' << rnd.uniform(-params.height / 4, params.height / 4) << ")\"/>\n";
+        }
+
+        for (int i = 0; i < params.circles; i++)
+        {
+            int r = rnd.uniform(1, std::max(1, std::min(40, std::min(params.width, params.height) / 2 - 1)));
+            out << "<circle cx=\"" << rnd.uniform(r, params.width - r - 1)
+                << "\" cy=\"" << rnd.uniform(r, params.height - r - 1) << "\" r=\"" << r
+                << "\" fill=\"" << random_color(rnd) << "\"/>\n";
+        }
+
+        for (int i = 0; i < params.polylines; i++)
+        {
+            out << "<polyline stroke=\"" << random_color(rnd) << "\" points=\"";
+            for (int j = 0; j < params.polyline_length; j++)
+            {
+                out << rnd.uniform(0, params.width - 1) << ',' << rnd.uniform(0, params.height - 1) << ' ';
+            }
+            out << "\"/>\n";
+        }
+
+        for (int i = 0; i < params.paths; i++)
+        {
+            int x = rnd.uniform(params.width / 4, params.width - params.width / 4);
+            int y = rnd.uniform(params.height / 4, params.height - params.height / 4);
+            out << "<path fill=\"" << random_color(rnd) << "\" d=\"M" << x << ' ' << y
+                << " c 40 -50 60 50 40 0 s -30 40 -40 40 q -40 0 -30 -20 z\"/>\n";
+        }
+        out << "</svg>\n";
+    }
+
+    std::string generate_scene(const SceneParams &params)
+    {
+        std::ostringstream out;
+        generate_scene(params, out);
+        return out.str();
+    }
+}
@@ -0,0 +1,66 @@
+//! @file SceneGenerator.hpp
+#ifndef __svg_SceneGenerator_hpp__
+#define __svg_SceneGenerator_hpp__
+
+#include <ostream>
+#include <string>
+
+namespace svg
+{
+    //! Parameters of a synthetic SVG scene.
+    struct SceneParams
+    {
+        //! Random seed; equal parameters always produce the same scene.
+        unsigned long long seed = 1;
+        //! Canvas width.
+        int width = 1000;
+        //! Canvas height.
+        int height = 1000;
+        //! Number of polygons.
+        int polygons = 0;
+        //! Vertices per polygon (at least 3).
+        int vertices = 3;
+        //! Maximum size of a polygon, in pixels.
+        int polygon_size = 60;
+        //! Depth of the nested groups that hold the polygons.
+        int depth = 0;
+        //! Number of use elements referencing random polygons.
+        int uses = 0;
+        //! Number of polylines.
+        int polylines = 0;
+        //! Points per polyline.
+        int polyline_length = 0;
+        //! Number of circles.
+        int circles = 0;
+        //! Number of curved paths.
+        int paths = 0;
+    };
+
+    //! Deterministic xorshift random number generator.
+    class SceneRandom
+    {
+    public:
+        //! Constructor.
+        //! @param seed Random seed.
+        SceneRandom(unsigned long long seed);
+        //! Get a uniform random integer.
+        //! @param lo Lower bound.
+        //! @param hi Upper bound (inclusive).
+        //! @return Random integer in [lo, hi].
+        int uniform(int lo, int hi);
+
+    private:
+        unsigned long long state; //!< Generator state.
+    };
+
+    //! Write a synthetic SVG scene.
+    //! @param params Scene parameters.
+    //! @param out Output stream.
+    void generate_scene(const SceneParams &params, std::ostream &out);
+
+    //! Generate a synthetic SVG scene.
+    //! @param params Scene parameters.
+    //! @return SVG text.
+    std::string generate_scene(const SceneParams &params);
+}
+#endif
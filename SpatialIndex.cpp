@@ -0,0 +1,246 @@
+//! @file SpatialIndex.cpp
+#include "SpatialIndex.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+namespace svg
+{
+    namespace
+    {
+        //! Children per node.
+        const size_t NODE_SIZE = 16;
+
+        //! Deepest tree that 32-bit entry positions can produce.
+        const int MAX_DEPTH = 9;
+
+        //! Gathers the shapes of a scene in drawing order, looking
+        //! inside groups.
+        void flatten(const std::vector<SVGElement *> &elements,
+                     std::vector<const SVGElement *> &shapes)
+        {
+            for (const SVGElement *e : elements)
+            {
+                if (e->children() != nullptr)
+                {
+                    flatten(*e->children(), shapes);
+                }
+                else
+                {
+                    shapes.push_back(e);
+                }
+            }
+        }
+
+        //! Orders items for Sort-Tile-Recursive packing: sorted by the x
+        //! center into vertical slices of whole nodes, then each slice
+        //! sorted by the y center, so that runs of NODE_SIZE items are
+        //! compact.
+        //! @param items Items to reorder.
+        //! @param box_of Gets the bounding box of an item.
+        template <typename T, typename BoxOf>
+        void str_order(std::vector<T> &items, BoxOf box_of)
+        {
+            auto by_x = [&](const T &a, const T &b)
+            { return box_of(a).min.x + box_of(a).max.x < box_of(b).min.x + box_of(b).max.x; };
+            auto by_y = [&](const T &a, const T &b)
+            { return box_of(a).min.y + box_of(a).max.y < box_of(b).min.y + box_of(b).max.y; };
+            const size_t node_count = (items.size() + NODE_SIZE - 1) / NODE_SIZE;
+            const size_t slices = (size_t)::ceil(::sqrt((double)node_count));
+            const size_t slice_size = ((node_count + slices - 1) / slices) * NODE_SIZE;
+            std::sort(items.begin(), items.end(), by_x);
+            for (size_t begin = 0; begin < items.size(); begin += slice_size)
+            {
+                size_t end = std::min(begin + slice_size, items.size());
+                std::sort(items.begin() + begin, items.begin() + end, by_y);
+            }
+        }
+
+        //! Checks if a shape draws at least one pixel of a region, by
+        //! drawing it over the part of the region inside its bounding box.
+        //! @param shape Shape to test.
+        //! @param box Bounding box of the shape.
+        //! @param region Region to test.
+        //! @return True if the shape draws in the region.
+        bool probe(const SVGElement &shape, const BoundingBox &box, const BoundingBox &region)
+        {
+            if (!box.intersects(region))
+            {
+                return false;
+            }
+            const BoundingBox clip = {{std::max(box.min.x, region.min.x), std::max(box.min.y, region.min.y)},
+                                      {std::min(box.max.x, region.max.x), std::min(box.max.y, region.max.y)}};
+            // The image is drawn in bands of rows and never cleared: only
+            // its count of pixel writes matters. It is kept per thread and
+            // reused while the size stays the same, as it does for points.
+            const int width = clip.max.x - clip.min.x + 1;
+            const int band = std::min(clip.max.y - clip.min.y + 1, 64);
+            static thread_local std::unique_ptr<PNGImage> img;
+            if (!img || img->width() != width || img->height() != band)
+            {
+                img.reset(new PNGImage(width, band));
+            }
+            img->set_left(clip.min.x);
+            for (int top = clip.min.y; top <= clip.max.y; top += band)
+            {
+                // the last band ends on the last row, overlapping the one before
+                img->set_top(std::min(top, clip.max.y - band + 1));
+                const unsigned long long before = img->pixels_written();
+                shape.draw(*img);
+                if (img->pixels_written() != before)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+
+    SpatialIndex::SpatialIndex(const std::vector<SVGElement *> &elements)
+    {
+        flatten(elements, shapes);
+        boxes.reserve(shapes.size());
+        for (size_t i = 0; i < shapes.size(); i++)
+        {
+            boxes.push_back(shapes[i]->bounding_box());
+            if (!boxes[i].empty())
+            {
+                entries.push_back((std::uint32_t)i);
+            }
+        }
+        if (entries.empty())
+        {
+            return;
+        }
+
+        // leaves, over runs of entries
+        str_order(entries, [this](std::uint32_t i) -> const BoundingBox &
+                  { return boxes[i]; });
+        std::vector<Node> level;
+        for (size_t begin = 0; begin < entries.size(); begin += NODE_SIZE)
+        {
+            Node node = {BoundingBox::none(), (std::uint32_t)begin,
+                         (std::uint32_t)std::min(NODE_SIZE, entries.size() - begin)};
+            for (size_t i = begin; i < begin + node.count; i++)
+            {
+                node.box = node.box.merge(boxes[entries[i]]);
+            }
+            level.push_back(node);
+        }
+        leaf_count = level.size();
+
+        // upper levels, over runs of the nodes below, until one is left
+        while (level.size() > 1)
+        {
+            str_order(level, [](const Node &n) -> const BoundingBox &
+                      { return n.box; });
+            const size_t base = nodes.size();
+            nodes.insert(nodes.end(), level.begin(), level.end());
+            std::vector<Node> parents;
+            for (size_t begin = 0; begin < level.size(); begin += NODE_SIZE)
+            {
+                Node node = {BoundingBox::none(), (std::uint32_t)(base + begin),
+                             (std::uint32_t)std::min(NODE_SIZE, level.size() - begin)};
+                for (size_t i = begin; i < begin + node.count; i++)
+                {
+                    node.box = node.box.merge(level[i].box);
+                }
+                parents.push_back(node);
+            }
+            level.swap(parents);
+        }
+        nodes.push_back(level.front());
+    }
+
+    size_t SpatialIndex::size() const
+    {
+        return shapes.size();
+    }
+
+    const SVGElement *SpatialIndex::shape(size_t i) const
+    {
+        return shapes[i];
+    }
+
+    const BoundingBox &SpatialIndex::box(size_t i) const
+    {
+        return boxes[i];
+    }
+
+    void SpatialIndex::candidates(const BoundingBox &region, std::vector<size_t> &found) const
+    {
+        found.clear();
+        if (nodes.empty() || !nodes.back().box.intersects(region))
+        {
+            return;
+        }
+        // depth-first, with at most NODE_SIZE - 1 siblings pending per level
+        std::uint32_t pending[MAX_DEPTH * NODE_SIZE];
+        size_t n_pending = 0;
+        pending[n_pending++] = (std::uint32_t)(nodes.size() - 1);
+        while (n_pending > 0)
+        {
+            const std::uint32_t n = pending[--n_pending];
+            const Node &node = nodes[n];
+            if (n < leaf_count)
+            {
+                for (std::uint32_t i = node.first; i < node.first + node.count; i++)
+                {
+                    if (boxes[entries[i]].intersects(region))
+                    {
+                        found.push_back(entries[i]);
+                    }
+                }
+                continue;
+            }
+            for (std::uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                if (nodes[i].box.intersects(region))
+                {
+                    pending[n_pending++] = i;
+                }
+            }
+        }
+        std::sort(found.begin(), found.end());
+    }
+
+    std::vector<const SVGElement *> SpatialIndex::intersecting(const BoundingBox &region) const
+    {
+        std::vector<size_t> found;
+        candidates(region, found);
+        std::vector<const SVGElement *> result;
+        for (size_t i : found)
+        {
+            if (probe(*shapes[i], boxes[i], region))
+            {
+                result.push_back(shapes[i]);
+            }
+        }
+        return result;
+    }
+
+    std::vector<const SVGElement *> SpatialIndex::at(const Point &p) const
+    {
+        return intersecting({p, p});
+    }
+
+    const SVGElement *SpatialIndex::top_at(const Point &p) const
+    {
+        std::vector<size_t> found;
+        candidates({p, p}, found);
+        for (size_t i = found.size(); i-- > 0;)
+        {
+            if (probe(*shapes[found[i]], boxes[found[i]], {p, p}))
+            {
+                return shapes[found[i]];
+            }
+        }
+        return nullptr;
+    }
+
+    bool SpatialIndex::draws_in(const SVGElement &shape, const BoundingBox &region)
+    {
+        return probe(shape, shape.bounding_box(), region);
+    }
+}
@@ -0,0 +1,88 @@
+//! @file SpatialIndex.hpp
+#ifndef __svg_SpatialIndex_hpp__
+#define __svg_SpatialIndex_hpp__
+
+#include "SVGElements.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace svg
+{
+    //! Packed R-tree over the bounding boxes of the shapes of a scene.
+    //! Groups are flattened, so the index holds every shape in drawing
+    //! order. The tree is bulk-loaded with Sort-Tile-Recursive packing:
+    //! boxes are sorted into vertical slices by x, each slice is sorted
+    //! by y, and runs of boxes become nodes, level after level. Queries
+    //! then only visit the nodes that meet the query.
+    class SpatialIndex
+    {
+    public:
+        //! Builds the index.
+        //! The elements must outlive the index and must not move.
+        //! @param elements Scene elements, as built by readSVG.
+        explicit SpatialIndex(const std::vector<SVGElement *> &elements);
+
+        //! Gets the number of shapes.
+        //! @return Shape count.
+        size_t size() const;
+
+        //! Gets a shape.
+        //! @param i Position of the shape in drawing order.
+        //! @return The shape.
+        const SVGElement *shape(size_t i) const;
+
+        //! Gets the bounding box of a shape.
+        //! @param i Position of the shape in drawing order.
+        //! @return The bounding box.
+        const BoundingBox &box(size_t i) const;
+
+        //! Finds the shapes whose bounding box meets a region.
+        //! This is a conservative test: use intersecting() or at() to
+        //! know which shapes draw there.
+        //! @param region Region to search.
+        //! @param found Cleared, then filled with shape positions in
+        //! drawing order.
+        void candidates(const BoundingBox &region, std::vector<size_t> &found) const;
+
+        //! Finds the shapes that draw at least one pixel of a region.
+        //! @param region Region to search.
+        //! @return Shapes, in drawing order.
+        std::vector<const SVGElement *> intersecting(const BoundingBox &region) const;
+
+        //! Finds the shapes that draw a pixel.
+        //! @param p Pixel position.
+        //! @return Shapes, in drawing order (the last one is on top).
+        std::vector<const SVGElement *> at(const Point &p) const;
+
+        //! Finds the shape that is visible at a pixel.
+        //! @param p Pixel position.
+        //! @return The topmost shape drawing the pixel, or nullptr.
+        const SVGElement *top_at(const Point &p) const;
+
+        //! Checks if a shape draws at least one pixel of a region.
+        //! The shape is drawn into a scratch image over the region, so the
+        //! answer is exact for every kind of shape: polygon edges and fill
+        //! rules, ellipse rows and line steps are those of the rasterizer.
+        //! @param shape Shape to test.
+        //! @param region Region to test.
+        //! @return True if the shape draws in the region.
+        static bool draws_in(const SVGElement &shape, const BoundingBox &region);
+
+    private:
+        //! Tree node, covering a run of entries or of nodes one level down.
+        struct Node
+        {
+            BoundingBox box;     //!< Union of the children's boxes.
+            std::uint32_t first; //!< First child (entry or node).
+            std::uint32_t count; //!< Number of children.
+        };
+
+        std::vector<const SVGElement *> shapes; //!< Shapes, in drawing order.
+        std::vector<BoundingBox> boxes;         //!< Bounding box of each shape.
+        std::vector<std::uint32_t> entries;     //!< Shape positions, in tree order.
+        std::vector<Node> nodes;                //!< Nodes, leaves first and the root last.
+        size_t leaf_count = 0;                  //!< Nodes whose children are entries.
+    };
+}
+#endif
@@ -0,0 +1,242 @@
+//! @file Stats.cpp
+#include "Stats.hpp"
+#include "SVGElements.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+// POSIX headers
+#include <sys/resource.h>
+
+namespace svg
+{
+    long peak_rss_kb()
+    {
+        struct rusage usage;
+        if (::getrusage(RUSAGE_SELF, &usage) != 0)
+        {
+            return 0;
+        }
+        return usage.ru_maxrss;
+    }
+
+    void RenderStats::count_elements(const std::vector<SVGElement *> &elements)
+    {
+        for (const SVGElement *e : elements)
+        {
+            element_counts[e->type_name()]++;
+            vertices += e->vertex_count();
+            if (e->children() != nullptr)
+            {
+                count_elements(*e->children());
+            }
+        }
+    }
+
+    double RenderStats::ellipse_profile_hit_rate() const
+    {
+        const unsigned long long lookups = ellipse_profile_hits + ellipse_profile_misses;
+        return lookups == 0 ? 0 : (double)ellipse_profile_hits / lookups;
+    }
+
+    void RenderStats::print(std::ostream &out) const
+    {
+        std::ios_base::fmtflags flags = out.flags();
+        out << std::fixed << std::setprecision(3)
+            << "Phase times (ms):" << std::endl
+            << "  xml_load   " << std::setw(12) << xml_load_ms << std::endl
+            << "  build      " << std::setw(12) << build_ms << std::endl
+            << "  transform  " << std::setw(12) << transform_ms << std::endl
+            << "  raster     " << std::setw(12) << raster_ms << std::endl
+            << "  encode     " << std::setw(12) << encode_ms << std::endl
+            << "  total      " << std::setw(12) << total_ms << std::endl
+            << "Elements:" << std::endl;
+        for (const auto &count : element_counts)
+        {
+            out << "  " << std::left << std::setw(11) << count.first << std::right
+                << std::setw(12) << count.second << std::endl;
+        }
+        out << "Vertices:          " << vertices << std::endl
+            << "Pixels written:    " << pixels_written << std::endl
+            << "Framebuffer bytes: " << framebuffer_bytes << std::endl
+            << "Allocations:       " << allocations << " (" << allocated_bytes << " bytes)" << std::endl
+            << "Ellipse profiles:  " << ellipse_profile_hits << " hits, " << ellipse_profile_misses
+            << " misses (" << std::setprecision(1) << ellipse_profile_hit_rate() * 100 << "% hit rate)" << std::endl
+            << "Peak RSS:          " << peak_rss_kb << " KB" << std::endl;
+        out.flags(flags);
+    }
+
+    void RenderStats::write_json(std::ostream &out) const
+    {
+        std::ios_base::fmtflags flags = out.flags();
+        out << std::fixed << std::setprecision(3)
+            << "{\"phases_ms\": {\"xml_load\": " << xml_load_ms
+            << ", \"build\": " << build_ms
+            << ", \"transform\": " << transform_ms
+            << ", \"raster\": " << raster_ms
+            << ", \"encode\": " << encode_ms
+            << ", \"total\": " << total_ms << "}, \"elements\": {";
+        const char *sep = "";
+        for (const auto &count : element_counts)
+        {
+            out << sep << '"' << count.first << "\": " << count.second;
+            sep = ", ";
+        }
+        out << "}, \"vertices\": " << vertices
+            << ", \"pixels_written\": " << pixels_written
+            << ", \"framebuffer_bytes\": " << framebuffer_bytes
+            << ", \"allocations\": " << allocations
+            << ", \"allocated_bytes\": " << allocated_bytes
+            << ", \"ellipse_profile_hits\": " << ellipse_profile_hits
+            << ", \"ellipse_profile_misses\": " << ellipse_profile_misses
+            << ", \"peak_rss_kb\": " << peak_rss_kb << "}" << std::endl;
+        out.flags(flags);
+    }
+
+    double CostEstimate::coverage() const
+    {
+        return canvas_pixels == 0 ? 0 : (double)filled_area / canvas_pixels;
+    }
+
+    void CostEstimate::print(std::ostream &out) const
+    {
+        std::ios_base::fmtflags flags = out.flags();
+        out << std::fixed << std::setprecision(3)
+            << "Canvas:            " << width << " x " << height << " (" << canvas_pixels << " pixels)" << std::endl
+            << "Elements:          " << elements << std::endl;
+        for (const auto &count : element_counts)
+        {
+            out << "  " << std::left << std::setw(11) << count.first << std::right
+                << std::setw(12) << count.second << std::endl;
+        }
+        out << "Vertices:          " << vertices << std::endl
+            << "Filled area:       " << filled_area << " pixels (" << coverage() << " x canvas)" << std::endl
+            << "Framebuffer bytes: " << framebuffer_bytes << std::endl
+            << "Scene bytes:       " << scene_bytes << std::endl
+            << "Encode bytes:      " << encode_bytes << std::endl
+            << "Peak bytes:        " << peak_bytes << std::endl
+            << "Estimate time:     " << estimate_ms << " ms" << std::endl;
+        out.flags(flags);
+    }
+
+    void CostEstimate::write_json(std::ostream &out) const
+    {
+        std::ios_base::fmtflags flags = out.flags();
+        out << std::fixed << std::setprecision(3)
+            << "{\"width\": " << width
+            << ", \"height\": " << height
+            << ", \"canvas_pixels\": " << canvas_pixels
+            << ", \"elements\": {";
+        const char *sep = "";
+        for (const auto &count : element_counts)
+        {
+            out << sep << '"' << count.first << "\": " << count.second;
+            sep = ", ";
+        }
+        out << "}, \"element_total\": " << elements
+            << ", \"vertices\": " << vertices
+            << ", \"filled_area\": " << filled_area
+            << ", \"coverage\": " << coverage()
+            << ", \"framebuffer_bytes\": " << framebuffer_bytes
+            << ", \"scene_bytes\": " << scene_bytes
+            << ", \"encode_bytes\": " << encode_bytes
+            << ", \"peak_bytes\": " << peak_bytes
+            << ", \"estimate_ms\": " << estimate_ms << "}" << std::endl;
+        out.flags(flags);
+    }
+
+    OverdrawStats OverdrawStats::measure(const PNGImage &img)
+    {
+        OverdrawStats stats;
+        stats.pixels = (unsigned long long)img.width() * img.height();
+        for (int y = 0; y < img.height(); y++)
+        {
+            for (int x = 0; x < img.width(); x++)
+            {
+                unsigned long long n = img.overdraw(x, y);
+                stats.covered += n != 0;
+                stats.writes += n;
+                stats.max = std::max(stats.max, n);
+            }
+        }
+        return stats;
+    }
+
+    void OverdrawStats::merge(const OverdrawStats &other)
+    {
+        pixels += other.pixels;
+        covered += other.covered;
+        writes += other.writes;
+        max = std::max(max, other.max);
+    }
+
+    double OverdrawStats::mean() const
+    {
+        return covered == 0 ? 0 : (double)writes / covered;
+    }
+
+    double OverdrawStats::wasted_fraction() const
+    {
+        // every covered pixel keeps exactly one write; the rest is waste
+        return writes == 0 ? 0 : (double)(writes - covered) / writes;
+    }
+
+    void OverdrawStats::print(std::ostream &out) const
+    {
+        std::ios_base::fmtflags flags = out.flags();
+        out << std::fixed << std::setprecision(3)
+            << "Overdraw:" << std::endl
+            << "  covered    " << std::setw(12) << covered << " of " << pixels << " pixels" << std::endl
+            << "  writes     " << std::setw(12) << writes << std::endl
+            << "  mean       " << std::setw(12) << mean() << std::endl
+            << "  max        " << std::setw(12) << max << std::endl
+            << "  wasted     " << std::setw(12) << wasted_fraction() * 100 << " %" << std::endl;
+        out.flags(flags);
+    }
+
+    namespace
+    {
+        //! Heatmap palette, from the lowest to the highest count.
+        const Color HEATMAP_RAMP[] = {
+            {0, 0, 255}, {0, 255, 255}, {0, 255, 0}, {255, 255, 0}, {255, 0, 0}};
+        const int HEATMAP_STOPS = sizeof(HEATMAP_RAMP) / sizeof(HEATMAP_RAMP[0]);
+
+        //! Heatmap color for a position on the palette.
+        //! @param t Position, from 0 to 1.
+        //! @return Interpolated color.
+        Color heatmap_color(double t)
+        {
+            double pos = t * (HEATMAP_STOPS - 1);
+            int i = std::min((int)pos, HEATMAP_STOPS - 2);
+            double f = pos - i;
+            const Color &a = HEATMAP_RAMP[i];
+            const Color &b = HEATMAP_RAMP[i + 1];
+            return {(unsigned char)::lround(a.red + (b.red - a.red) * f),
+                    (unsigned char)::lround(a.green + (b.green - a.green) * f),
+                    (unsigned char)::lround(a.blue + (b.blue - a.blue) * f)};
+        }
+    }
+
+    void save_overdraw_heatmap(const PNGImage &img, const std::string &png_file_name)
+    {
+        OverdrawStats stats = OverdrawStats::measure(img);
+        // precompute one color per count so each pixel is a lookup
+        std::vector<Color> palette(stats.max + 1);
+        palette[0] = {0, 0, 0};
+        double log_max = ::log((double)std::max(stats.max, 2ULL));
+        for (unsigned long long n = 1; n <= stats.max; n++)
+        {
+            palette[n] = heatmap_color(::log((double)n) / log_max);
+        }
+        PNGImage heatmap(img.width(), img.height());
+        for (int y = 0; y < img.height(); y++)
+        {
+            for (int x = 0; x < img.width(); x++)
+            {
+                heatmap.set(x, y, palette[img.overdraw(x, y)]);
+            }
+        }
+        heatmap.save(png_file_name);
+    }
+}
@@ -0,0 +1,163 @@
+//! @file Stats.hpp
+#ifndef __svg_Stats_hpp__
+#define __svg_Stats_hpp__
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace svg
+{
+    class SVGElement;
+    class PNGImage;
+
+    //! Statistics gathered while converting an SVG file.
+    struct RenderStats
+    {
+        //! Time spent loading and parsing the XML, in milliseconds.
+        double xml_load_ms = 0;
+        //! Time spent building elements (excluding transforms), in milliseconds.
+        double build_ms = 0;
+        //! Time spent applying transforms, in milliseconds.
+        double transform_ms = 0;
+        //! Time spent drawing elements, in milliseconds.
+        double raster_ms = 0;
+        //! Time spent encoding and writing the PNG, in milliseconds.
+        double encode_ms = 0;
+        //! Total conversion time, in milliseconds.
+        double total_ms = 0;
+        //! Number of elements by type, including group members.
+        std::map<std::string, unsigned long long> element_counts;
+        //! Number of vertices (points, centers and control points).
+        unsigned long long vertices = 0;
+        //! Number of pixel writes performed by drawing routines.
+        unsigned long long pixels_written = 0;
+        //! Framebuffer size in bytes.
+        unsigned long long framebuffer_bytes = 0;
+        //! Number of operator new calls during the conversion.
+        unsigned long long allocations = 0;
+        //! Bytes requested from operator new during the conversion.
+        unsigned long long allocated_bytes = 0;
+        //! Axis-aligned ellipses drawn from a cached row profile. The cache
+        //! is shared by the process, but only this conversion's lookups
+        //! are counted.
+        unsigned long long ellipse_profile_hits = 0;
+        //! Axis-aligned ellipses whose row profile had to be computed.
+        unsigned long long ellipse_profile_misses = 0;
+        //! Peak resident set size of the process, in kilobytes.
+        long peak_rss_kb = 0;
+
+        //! Count elements and vertices of a scene.
+        //! @param elements Top-level elements.
+        void count_elements(const std::vector<SVGElement *> &elements);
+        //! Fraction of axis-aligned ellipses drawn from a cached profile.
+        //! @return Hit rate in [0, 1] (0 if no ellipse was drawn).
+        double ellipse_profile_hit_rate() const;
+        //! Print statistics in human-readable form.
+        //! @param out Output stream.
+        void print(std::ostream &out) const;
+        //! Print statistics as a JSON object.
+        //! @param out Output stream.
+        void write_json(std::ostream &out) const;
+    };
+
+    //! Predicted cost of converting a document, from a pass that reads
+    //! and sizes the elements but draws nothing.
+    struct CostEstimate
+    {
+        //! Output width in pixels.
+        int width = 0;
+        //! Output height in pixels.
+        int height = 0;
+        //! Output pixels (width times height).
+        unsigned long long canvas_pixels = 0;
+        //! Number of elements by type, including group members and use copies.
+        std::map<std::string, unsigned long long> element_counts;
+        //! Number of elements, including group members and use copies.
+        unsigned long long elements = 0;
+        //! Number of vertices (points, centers and control points).
+        unsigned long long vertices = 0;
+        //! Sum of the bounding box areas of the shapes, clipped to the
+        //! canvas: a bound on the pixels that filled shapes write.
+        unsigned long long filled_area = 0;
+        //! Framebuffer size in bytes (one band with strip rendering).
+        unsigned long long framebuffer_bytes = 0;
+        //! Approximate memory held by the elements, in bytes.
+        unsigned long long scene_bytes = 0;
+        //! Approximate memory used to encode the PNG, in bytes.
+        unsigned long long encode_bytes = 0;
+        //! Projected peak memory of the conversion, in bytes, besides the
+        //! XML document.
+        unsigned long long peak_bytes = 0;
+        //! Time taken by the estimate, in milliseconds.
+        double estimate_ms = 0;
+
+        //! Mean number of shapes over each canvas pixel.
+        //! @return Filled area over canvas pixels (0 for an empty canvas).
+        double coverage() const;
+        //! Print the estimate in human-readable form.
+        //! @param out Output stream.
+        void print(std::ostream &out) const;
+        //! Print the estimate as a JSON object.
+        //! @param out Output stream.
+        void write_json(std::ostream &out) const;
+    };
+
+    //! Summary of how often pixels were overwritten while drawing.
+    struct OverdrawStats
+    {
+        //! Number of pixels in the image.
+        unsigned long long pixels = 0;
+        //! Number of pixels written at least once.
+        unsigned long long covered = 0;
+        //! Total number of pixel writes.
+        unsigned long long writes = 0;
+        //! Highest number of writes to a single pixel.
+        unsigned long long max = 0;
+
+        //! Summarize the write counts of an image.
+        //! @param img Image drawn with overdraw tracking on.
+        //! @return Summary.
+        static OverdrawStats measure(const PNGImage &img);
+        //! Add the counts of another part of the same image.
+        //! @param other Summary of the other part.
+        void merge(const OverdrawStats &other);
+        //! Mean writes per covered pixel.
+        //! @return Mean overdraw (0 if nothing was drawn).
+        double mean() const;
+        //! Fraction of writes that were later overwritten.
+        //! @return Wasted fraction of raster work, in [0, 1).
+        double wasted_fraction() const;
+        //! Print the summary in human-readable form.
+        //! @param out Output stream.
+        void print(std::ostream &out) const;
+    };
+
+    //! Save the write counts of an image as a false-color heatmap.
+    //! Unwritten pixels are black; counts from 1 to the maximum go from
+    //! blue through green and yellow to red, on a logarithmic scale.
+    //! @param img Image drawn with overdraw tracking on.
+    //! @param png_file_name Output file name.
+    void save_overdraw_heatmap(const PNGImage &img, const std::string &png_file_name);
+
+    //! Counter of heap allocations made through operator new.
+    //! Counting only happens between start() and stop().
+    class AllocationCounter
+    {
+    public:
+        //! Start counting (nested use is not supported).
+        static void start();
+        //! Stop counting.
+        static void stop();
+        //! Number of allocations counted so far.
+        static unsigned long long count();
+        //! Number of bytes counted so far.
+        static unsigned long long bytes();
+    };
+
+    //! Get peak resident set size of the process.
+    //! @return Peak RSS in kilobytes.
+    long peak_rss_kb();
+}
+#endif
@@ -0,0 +1,281 @@
+//! @file Tiles.cpp
+#include "Tiles.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+
+namespace svg
+{
+    namespace
+    {
+        //! Largest scaled drawing side, so that pixel coordinates of shapes
+        //! reaching well past the drawing still fit in an int.
+        const double MAX_SCALED_SIDE = 1 << 24;
+
+        //! Milliseconds elapsed since a time point.
+        double elapsed_ms(std::chrono::steady_clock::time_point since)
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+        }
+
+        //! Creates a directory, unless it exists.
+        void make_directory(const std::string &path)
+        {
+            if (::mkdir(path.c_str(), 0777) != 0 && errno != EEXIST)
+            {
+                throw std::runtime_error("Unable to create directory " + path);
+            }
+        }
+
+        //! A zoom level of the pyramid.
+        struct Level
+        {
+            int zoom;                 //!< Zoom level.
+            double scale;             //!< Scale of the drawing.
+            int columns;              //!< Tiles across.
+            int rows;                 //!< Tiles down.
+            unsigned long long first; //!< Index of the first tile, counting all levels.
+        };
+    }
+
+    SceneCache::SceneCache(size_t capacity)
+        : capacity(std::max<size_t>(capacity, 1))
+    {
+    }
+
+    std::shared_ptr<const Scene> SceneCache::get(const std::string &svg_file, double scale)
+    {
+        if (!(scale > 0))
+        {
+            throw std::runtime_error("Scene scale must be positive");
+        }
+        const Key key(svg_file, scale);
+        std::promise<std::shared_ptr<const Scene>> promise;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = index.find(key);
+            if (it != index.end())
+            {
+                hit_count++;
+                entries.splice(entries.begin(), entries, it->second);
+                Entry entry = it->second->second;
+                // wait for a scene still being loaded outside the lock
+                return entry.get();
+            }
+            miss_count++;
+            entries.emplace_front(key, promise.get_future().share());
+            index[key] = entries.begin();
+            if (entries.size() > capacity)
+            {
+                index.erase(entries.back().first);
+                entries.pop_back();
+            }
+        }
+
+        // Other threads asking for the same key wait on the future.
+        try
+        {
+            if (scale != 1)
+            {
+                const Point &size = get(svg_file, 1)->dimensions();
+                if (std::max(size.x, size.y) * scale > MAX_SCALED_SIDE)
+                {
+                    throw std::runtime_error("Scale too large for " + svg_file);
+                }
+            }
+            ConvertOptions options;
+            options.scale = scale;
+            std::shared_ptr<const Scene> scene(new Scene(svg_file, options));
+            promise.set_value(scene);
+            return scene;
+        }
+        catch (...)
+        {
+            promise.set_exception(std::current_exception());
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = index.find(key);
+            if (it != index.end())
+            {
+                entries.erase(it->second);
+                index.erase(it);
+            }
+            throw;
+        }
+    }
+
+    unsigned long long SceneCache::hits() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return hit_count;
+    }
+
+    unsigned long long SceneCache::misses() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return miss_count;
+    }
+
+    void render_region(SceneCache &cache,
+                       const std::string &svg_file,
+                       double x, double y, double zoom,
+                       PNGImage &img)
+    {
+        std::shared_ptr<const Scene> scene = cache.get(svg_file, zoom);
+        img.fill({255, 255, 255});
+        scene->render_region(img, (int)::lround(x * zoom), (int)::lround(y * zoom));
+    }
+
+    void TilePyramidReport::print(std::ostream &out) const
+    {
+        std::ios_base::fmtflags flags = out.flags();
+        out << std::fixed << std::setprecision(1)
+            << "Wrote " << tiles << " tiles in " << wall_ms << " ms";
+        if (tiles > 0 && shapes > 0)
+        {
+            out << ", drawing " << (double)shapes_drawn / tiles << " of " << shapes
+                << " shapes per tile";
+        }
+        out << std::endl;
+        out.flags(flags);
+    }
+
+    TilePyramidReport render_pyramid(const std::string &svg_file,
+                                     const std::string &out_dir,
+                                     const TilePyramidOptions &options)
+    {
+        if (options.tile_size < 1 || options.threads < 1 ||
+            options.min_zoom < 0 || options.max_zoom < options.min_zoom)
+        {
+            throw std::runtime_error("Invalid tile pyramid options");
+        }
+        auto start = std::chrono::steady_clock::now();
+        SceneCache cache(options.max_zoom - options.min_zoom + 2);
+        std::shared_ptr<const Scene> document = cache.get(svg_file, 1);
+        const Point &size = document->dimensions();
+        if (size.x <= 0 || size.y <= 0)
+        {
+            throw std::runtime_error("Document has no width or height");
+        }
+
+        // Level z is drawn at the scale that spreads the longer side of
+        // the document over 2^z tiles. Tiles are numbered level by level,
+        // column by column, and only the directories are made up front.
+        std::vector<Level> levels;
+        unsigned long long tile_count = 0;
+        for (int z = options.min_zoom; z <= options.max_zoom; z++)
+        {
+            const double scale = std::ldexp((double)options.tile_size / std::max(size.x, size.y), z);
+            if (std::max(size.x, size.y) * scale > MAX_SCALED_SIDE)
+            {
+                throw std::runtime_error("Zoom level " + std::to_string(z) + " is too large");
+            }
+            const int columns = std::max(1, (int)::ceil(size.x * scale / options.tile_size));
+            const int rows = std::max(1, (int)::ceil(size.y * scale / options.tile_size));
+            levels.push_back({z, scale, columns, rows, tile_count});
+            tile_count += (unsigned long long)columns * rows;
+        }
+        make_directory(out_dir);
+        for (const Level &level : levels)
+        {
+            const std::string level_dir = out_dir + "/" + std::to_string(level.zoom);
+            make_directory(level_dir);
+            for (int x = 0; x < level.columns; x++)
+            {
+                make_directory(level_dir + "/" + std::to_string(x));
+            }
+        }
+
+        std::atomic<unsigned long long> next_tile{0};
+        std::atomic<unsigned long long> shapes_drawn{0};
+        std::mutex error_mutex;
+        std::string error;
+        auto work = [&]()
+        {
+            PNGImage img(options.tile_size, options.tile_size);
+            std::vector<unsigned char> png;
+            unsigned long long drawn = 0;
+            try
+            {
+                for (unsigned long long i = next_tile++; i < tile_count; i = next_tile++)
+                {
+                    size_t l = levels.size() - 1;
+                    while (levels[l].first > i)
+                    {
+                        l--;
+                    }
+                    const Level &level = levels[l];
+                    const int x = (int)((i - level.first) / level.rows);
+                    const int y = (int)((i - level.first) % level.rows);
+                    std::shared_ptr<const Scene> scene = cache.get(svg_file, level.scale);
+                    const Color white = {255, 255, 255};
+                    const int left = x * options.tile_size, top = y * options.tile_size;
+                    const int right = left + options.tile_size - 1, bottom = top + options.tile_size - 1;
+                    img.fill(white);
+                    drawn += scene->render_region(img, left, top);
+                    // shapes that overhang the drawing are clipped, as in a
+                    // full render
+                    const Point &size = scene->dimensions();
+                    if (right >= size.x)
+                    {
+                        img.draw_rect({std::max(size.x, left), top}, {right, bottom}, white);
+                    }
+                    if (bottom >= size.y)
+                    {
+                        img.draw_rect({left, std::max(size.y, top)}, {right, bottom}, white);
+                    }
+                    img.encode(png);
+                    const std::string png_file = out_dir + "/" + std::to_string(level.zoom) + "/" +
+                                                 std::to_string(x) + "/" + std::to_string(y) + ".png";
+                    std::ofstream out(png_file, std::ios::binary);
+                    out.write((const char *)png.data(), png.size());
+                    out.close();
+                    if (!out)
+                    {
+                        throw std::runtime_error("Unable to write " + png_file);
+                    }
+                }
+            }
+            catch (const std::exception &e)
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (error.empty())
+                {
+                    error = e.what();
+                }
+                // stop the other workers as well
+                next_tile = tile_count;
+            }
+            shapes_drawn += drawn;
+        };
+        std::vector<std::thread> threads;
+        for (int t = 1; t < options.threads; t++)
+        {
+            threads.emplace_back(work);
+        }
+        work();
+        for (std::thread &t : threads)
+        {
+            t.join();
+        }
+        if (!error.empty())
+        {
+            throw std::runtime_error(error);
+        }
+
+        TilePyramidReport report;
+        report.wall_ms = elapsed_ms(start);
+        report.tiles = tile_count;
+        report.shapes = document->shape_count();
+        report.shapes_drawn = shapes_drawn;
+        return report;
+    }
+}
@@ -0,0 +1,121 @@
+//! @file Tiles.hpp
+#ifndef __svg_Tiles_hpp__
+#define __svg_Tiles_hpp__
+
+#include "SVGElements.hpp"
+
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+
+namespace svg
+{
+    //! Thread-safe cache of parsed scenes, keyed by file and scale.
+    //! A scene is built once per key, however many threads ask for it at
+    //! the same time, and the least recently used scenes are dropped when
+    //! the cache is full. Scenes stay alive while a caller holds them.
+    class SceneCache
+    {
+    public:
+        //! Constructs an empty cache.
+        //! @param capacity Maximum number of scenes kept.
+        explicit SceneCache(size_t capacity = 16);
+
+        //! Gets a scene, loading it if it is not cached.
+        //! Throws std::runtime_error if the file cannot be loaded, or if
+        //! the scaled drawing would be too large for pixel coordinates.
+        //! @param svg_file The path to the SVG file.
+        //! @param scale Scale factor from document to image coordinates.
+        //! @return The scene, drawn at the given scale.
+        std::shared_ptr<const Scene> get(const std::string &svg_file, double scale);
+
+        //! Number of requests answered from the cache.
+        //! @return Hit count.
+        unsigned long long hits() const;
+
+        //! Number of requests that loaded a scene.
+        //! @return Miss count.
+        unsigned long long misses() const;
+
+    private:
+        SceneCache(const SceneCache &) = delete;
+        SceneCache &operator=(const SceneCache &) = delete;
+
+        typedef std::pair<std::string, double> Key;
+        typedef std::shared_future<std::shared_ptr<const Scene>> Entry;
+
+        typedef std::list<std::pair<Key, Entry>> EntryList;
+
+        size_t capacity;                          //!< Maximum number of scenes.
+        mutable std::mutex mutex;                 //!< Guards everything below.
+        EntryList entries;                        //!< Scenes, most recently used first.
+        std::map<Key, EntryList::iterator> index; //!< Position of each key in entries.
+        unsigned long long hit_count = 0;         //!< Requests answered from the cache.
+        unsigned long long miss_count = 0;        //!< Requests that loaded a scene.
+    };
+
+    //! Draws a rectangle of a document into an image, such as a map tile.
+    //! The rectangle starts at (x, y) in document coordinates (the image
+    //! coordinates of a plain conversion) and covers img.width() / zoom by
+    //! img.height() / zoom document units. The image is filled with white
+    //! first, and only shapes that meet the rectangle are drawn.
+    //! @param cache Cache to take the scene from.
+    //! @param svg_file The path to the SVG file.
+    //! @param x Left edge of the rectangle, in document coordinates.
+    //! @param y Top edge of the rectangle, in document coordinates.
+    //! @param zoom Image pixels per document unit.
+    //! @param img The PNGImage object to draw on.
+    void render_region(SceneCache &cache,
+                       const std::string &svg_file,
+                       double x, double y, double zoom,
+                       PNGImage &img);
+
+    //! Settings of a tile pyramid.
+    struct TilePyramidOptions
+    {
+        //! Width and height of each tile, in pixels.
+        int tile_size = 256;
+        //! Lowest zoom level; at level 0 the document fits in one tile.
+        int min_zoom = 0;
+        //! Highest zoom level; each level doubles the scale of the one below.
+        int max_zoom = 3;
+        //! Threads drawing and writing tiles.
+        int threads = 1;
+    };
+
+    //! Outcome of a tile pyramid.
+    struct TilePyramidReport
+    {
+        //! Duration of the whole pyramid, in milliseconds.
+        double wall_ms = 0;
+        //! Number of tiles written.
+        unsigned long long tiles = 0;
+        //! Number of shapes in the document.
+        size_t shapes = 0;
+        //! Number of shapes drawn, summed over tiles.
+        unsigned long long shapes_drawn = 0;
+
+        //! Print the report in human-readable form.
+        //! @param out Output stream.
+        void print(std::ostream &out) const;
+    };
+
+    //! Writes a document as a pyramid of XYZ tiles, out_dir/z/x/y.png.
+    //! Level z has 2^z tiles across the longer side of the document;
+    //! tiles past the edge of the document are padded with white. Tiles
+    //! are drawn in parallel, each from the cached scene of its level.
+    //! Throws std::runtime_error on invalid options or on I/O errors.
+    //! @param svg_file The path to the SVG file.
+    //! @param out_dir Output directory (created if needed).
+    //! @param options Pyramid settings.
+    //! @return Report with tile counts and timing.
+    TilePyramidReport render_pyramid(const std::string &svg_file,
+                                     const std::string &out_dir,
+                                     const TilePyramidOptions &options);
+}
+#endif
@@ -0,0 +1,99 @@
+//! @file Trace.cpp
+#include "Trace.hpp"
+#include "SVGElements.hpp"
+
+#include <iomanip>
+
+namespace svg
+{
+    thread_local Tracer *Tracer::current_tracer = nullptr;
+
+    namespace
+    {
+        //! Write a string as a JSON string literal.
+        void write_json_string(std::ostream &out, const std::string &s)
+        {
+            out << '"';
+            for (char ch : s)
+            {
+                unsigned char c = (unsigned char)ch;
+                if (c == '"' || c == '\\')
+                {
+                    out << '\\' << ch;
+                }
+                else if (c < 0x20)
+                {
+                    out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c
+                        << std::dec << std::setfill(' ');
+                }
+                else
+                {
+                    out << ch;
+                }
+            }
+            out << '"';
+        }
+    }
+
+    Tracer::Tracer() : origin(std::chrono::steady_clock::now())
+    {
+    }
+
+    double Tracer::now_us() const
+    {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    void Tracer::phase(const char *name, double start_us, double end_us)
+    {
+        events.push_back({name, false, start_us, end_us - start_us, std::string(), 0, 0});
+    }
+
+    void Tracer::element(const SVGElement &elem, double start_us, double end_us)
+    {
+        events.push_back({elem.type_name(), true, start_us, end_us - start_us, elem.id(),
+                          elem.vertex_count(), elem.bounding_box().area()});
+    }
+
+    size_t Tracer::size() const
+    {
+        return events.size();
+    }
+
+    void Tracer::write_json(std::ostream &out) const
+    {
+        std::ios_base::fmtflags flags = out.flags();
+        out << std::fixed << std::setprecision(3)
+            << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl
+            << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, "
+            << "\"args\": {\"name\": \"svgtopng\"}}";
+        for (const Event &e : events)
+        {
+            out << "," << std::endl
+                << "{\"name\": \"" << e.name << "\", \"cat\": \""
+                << (e.is_element ? "draw" : "phase") << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": " << e.start_us
+                << ", \"dur\": " << e.duration_us;
+            if (e.is_element)
+            {
+                out << ", \"args\": {\"id\": ";
+                write_json_string(out, e.id);
+                out << ", \"vertices\": " << e.vertices
+                    << ", \"bbox_area\": " << e.bbox_area << "}";
+            }
+            out << "}";
+        }
+        out << std::endl
+            << "]}" << std::endl;
+        out.flags(flags);
+    }
+
+    TraceScope::TraceScope(Tracer *tracer) : previous(Tracer::current_tracer)
+    {
+        Tracer::current_tracer = tracer;
+    }
+
+    TraceScope::~TraceScope()
+    {
+        Tracer::current_tracer = previous;
+    }
+}
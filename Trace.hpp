@@ -0,0 +1,93 @@
+//! @file Trace.hpp
+#ifndef __svg_Trace_hpp__
+#define __svg_Trace_hpp__
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace svg
+{
+    class SVGElement;
+
+    //! Recorder of timed events, written in the Chrome trace-event
+    //! format (chrome://tracing, Perfetto, speedscope).
+    //! Elements only record their draw calls while a tracer is made
+    //! current with a TraceScope; otherwise tracing costs one branch
+    //! per element.
+    class Tracer
+    {
+    public:
+        //! Constructs an empty tracer; timestamps are relative to now.
+        Tracer();
+
+        //! Time elapsed since the tracer was created.
+        //! @return Time in microseconds.
+        double now_us() const;
+
+        //! Record a pipeline phase.
+        //! @param name Phase name.
+        //! @param start_us Start time, from now_us().
+        //! @param end_us End time, from now_us().
+        void phase(const char *name, double start_us, double end_us);
+
+        //! Record the drawing of an element.
+        //! @param elem The element drawn.
+        //! @param start_us Start time, from now_us().
+        //! @param end_us End time, from now_us().
+        void element(const SVGElement &elem, double start_us, double end_us);
+
+        //! Number of events recorded.
+        //! @return Event count.
+        size_t size() const;
+
+        //! Write the events as a trace-event JSON object.
+        //! @param out Output stream.
+        void write_json(std::ostream &out) const;
+
+        //! Tracer of the calling thread.
+        //! @return The current tracer, or nullptr if tracing is off.
+        static Tracer *current()
+        {
+            return current_tracer;
+        }
+
+    private:
+        friend class TraceScope;
+
+        //! A complete ('X') trace event.
+        struct Event
+        {
+            const char *name;       //!< Phase or element type name.
+            bool is_element;        //!< Element draw (true) or phase (false).
+            double start_us;        //!< Start time.
+            double duration_us;     //!< Duration.
+            std::string id;         //!< Element id attribute.
+            size_t vertices;        //!< Element vertex count.
+            long long bbox_area;    //!< Element bounding box area.
+        };
+
+        std::chrono::steady_clock::time_point origin; //!< Time of creation.
+        std::vector<Event> events;                    //!< Recorded events.
+
+        static thread_local Tracer *current_tracer; //!< Tracer of each thread.
+    };
+
+    //! Makes a tracer current for the calling thread while in scope.
+    class TraceScope
+    {
+    public:
+        //! Makes a tracer current.
+        //! @param tracer The tracer (nullptr disables tracing).
+        explicit TraceScope(Tracer *tracer);
+        //! Restores the previously current tracer.
+        ~TraceScope();
+
+    private:
+        TraceScope(const TraceScope &) = delete;
+        TraceScope &operator=(const TraceScope &) = delete;
+        Tracer *previous; //!< Tracer current before this scope.
+    };
+}
+#endif
@@ -0,0 +1,723 @@
+// Project file headers
+#include "SVGElements.hpp"
+#include "SceneGenerator.hpp"
+#include "SpatialIndex.hpp"
+#include "Stats.hpp"
+#include "external/tinyxml2/tinyxml2.h"
+
+// C++ library headers
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+using namespace tinyxml2;
+
+// POSIX headers
+#include <dirent.h>
+
+namespace svg
+{
+    //! Timing statistics of one benchmark case, in milliseconds.
+    struct BenchResult
+    {
+        string name;
+        string phase;
+        int repetitions;
+        double min;
+        double median;
+        double p99;
+    };
+
+    class BenchDriver
+    {
+    private:
+        string root_path;
+        int repetitions;
+        int warmup;
+        string filter;
+        string scratch_file;
+        vector<BenchResult> results;
+
+        //! Time a benchmark case.
+        //! @param name Case name.
+        //! @param phase Pipeline phase (or primitive) being timed.
+        //! @param body Code to time.
+        //! @param setup Untimed code run before each repetition.
+        //! @param teardown Untimed code run after each repetition.
+        void run_case(const string &name, const string &phase,
+                      const function<void()> &body,
+                      const function<void()> &setup = nullptr,
+                      const function<void()> &teardown = nullptr)
+        {
+            string full_name = name + " " + phase;
+            if (full_name.find(filter) == string::npos)
+            {
+                return;
+            }
+            vector<double> samples;
+            for (int i = -warmup; i < repetitions; i++)
+            {
+                if (setup)
+                {
+                    setup();
+                }
+                auto start = chrono::steady_clock::now();
+                body();
+                auto end = chrono::steady_clock::now();
+                if (teardown)
+                {
+                    teardown();
+                }
+                if (i >= 0)
+                {
+                    samples.push_back(chrono::duration<double, milli>(end - start).count());
+                }
+            }
+            sort(samples.begin(), samples.end());
+            size_t p99_rank = (size_t)ceil(0.99 * samples.size());
+            BenchResult r = {name, phase, repetitions,
+                             samples.front(),
+                             samples[samples.size() / 2],
+                             samples[max(p99_rank, (size_t)1) - 1]};
+            results.push_back(r);
+            cout << left << setw(36) << name << setw(12) << phase << right << fixed << setprecision(3)
+                 << " min " << setw(10) << r.min
+                 << "  median " << setw(10) << r.median
+                 << "  p99 " << setw(10) << r.p99 << " ms" << endl;
+        }
+
+        //! Benchmark every pipeline phase of an SVG scene.
+        //! @param name Scene name.
+        //! @param source File path, or SVG text when in_memory is set.
+        //! @param in_memory Whether source is SVG text.
+        void run_scene(const string &name, const string &source, bool in_memory)
+        {
+            XMLDocument *doc = nullptr;
+            Point dimensions;
+            vector<SVGElement *> elements;
+            PNGImage *img = nullptr;
+
+            auto load = [&]
+            {
+                delete doc;
+                doc = new XMLDocument();
+                XMLError r = in_memory ? doc->Parse(source.c_str(), source.size())
+                                       : doc->LoadFile(source.c_str());
+                if (r != XML_SUCCESS)
+                {
+                    throw runtime_error("Unable to load " + name);
+                }
+            };
+            auto build = [&]
+            {
+                readSVG(*doc, dimensions, elements);
+            };
+            auto transform = [&]
+            {
+                for (SVGElement *e : elements)
+                {
+                    e->translate(1, 1);
+                    e->scale(1);
+                    e->rotate(360);
+                }
+            };
+            auto raster = [&]
+            {
+                for (SVGElement *e : elements)
+                {
+                    e->draw(*img);
+                }
+            };
+            auto release = [&]
+            {
+                for (SVGElement *e : elements)
+                {
+                    delete e;
+                }
+                elements.clear();
+                delete img;
+                img = nullptr;
+            };
+            auto new_image = [&]
+            {
+                img = new PNGImage(max(dimensions.x, 1), max(dimensions.y, 1));
+            };
+
+            run_case(name, "xml_load", load);
+            load();
+            run_case(name, "build", build, nullptr, release);
+            run_case(name, "transform", transform, build, release);
+            run_case(name, "raster", raster, [&]
+                     { build(); new_image(); }, release);
+            run_case(name, "encode", [&]
+                     { img->save(scratch_file); }, [&]
+                     { build(); new_image(); raster(); }, release);
+            release();
+            delete doc;
+            ::remove(scratch_file.c_str());
+        }
+
+        void run_primitive_benchmarks()
+        {
+            PNGImage img(4000, 4000);
+            const Point center = {2000, 2000};
+            const Color fill = {255, 0, 0};
+            run_case("ellipse/axis r=1900x1200", "draw_ellipse", [&]
+                     { img.draw_ellipse(center, {1900, 1200}, fill); });
+            run_case("ellipse/circle r=1900", "draw_ellipse", [&]
+                     { img.draw_ellipse(center, {1900, 1900}, fill); });
+            run_case("ellipse/rotated 30deg r=1900x1200", "draw_ellipse", [&]
+                     { img.draw_ellipse(center, {1900, 1200}, fill, 30); });
+            run_case("ellipse/small r=20x10 x1000", "draw_ellipse", [&]
+                     {
+                         for (int i = 0; i < 1000; i++)
+                         {
+                             img.draw_ellipse(Point{40 + (i % 100) * 39, 40 + (i / 100) * 390}, Point{20, 10}, fill);
+                         } });
+            vector<pair<Point, Point>> scatter;
+            SceneRandom scatter_rnd(7);
+            for (int i = 0; i < 100000; i++)
+            {
+                int r = scatter_rnd.uniform(2, 8);
+                scatter.push_back({{scatter_rnd.uniform(0, 3999), scatter_rnd.uniform(0, 3999)}, {r, r}});
+            }
+            run_case("ellipse/scatter r=2..8 x100000", "draw_ellipse", [&]
+                     {
+                         for (const pair<Point, Point> &dot : scatter)
+                         {
+                             img.draw_ellipse(dot.first, dot.second, fill);
+                         } });
+            PNGImage band(4000, 16);
+            run_case("ellipse/band of 16 rows r=1900 x100", "draw_ellipse", [&]
+                     {
+                         for (int i = 0; i < 100; i++)
+                         {
+                             band.set_top(i * 38);
+                             band.draw_ellipse(center, {1900, 1900}, fill);
+                         } });
+            run_case("line/horizontal x4000", "draw_line", [&]
+                     {
+                         for (int y = 0; y < 4000; y++)
+                         {
+                             img.draw_line(Point{0, y}, Point{3999, y}, fill);
+                         } });
+            run_case("line/vertical x4000", "draw_line", [&]
+                     {
+                         for (int x = 0; x < 4000; x++)
+                         {
+                             img.draw_line(Point{x, 0}, Point{x, 3999}, fill);
+                         } });
+            run_case("line/diagonal x4000", "draw_line", [&]
+                     {
+                         for (int x = 0; x < 4000; x++)
+                         {
+                             img.draw_line(Point{x, 0}, Point{0, x}, fill);
+                         } });
+            run_case("line/general x4000", "draw_line", [&]
+                     {
+                         for (int x = 0; x < 4000; x++)
+                         {
+                             img.draw_line(Point{x, 0}, Point{3999 - x / 3, 3999}, fill);
+                         } });
+            run_case("line/subpixel general x4000", "draw_line", [&]
+                     {
+                         for (int x = 0; x < 4000; x++)
+                         {
+                             img.draw_line(FixedPoint{x * SUBPIXEL_ONE + 77, 0},
+                                           FixedPoint{(3999 - x / 3) * SUBPIXEL_ONE + 131, 3999 * SUBPIXEL_ONE}, fill);
+                         } });
+            run_case("ellipse/subpixel r=20x10 x1000", "draw_ellipse", [&]
+                     {
+                         for (int i = 0; i < 1000; i++)
+                         {
+                             img.draw_ellipse(FixedPoint{(40 + (i % 100) * 39) * SUBPIXEL_ONE + 77, (40 + (i / 100) * 390) * SUBPIXEL_ONE + 131},
+                                              FixedPoint{20 * SUBPIXEL_ONE + 64, 10 * SUBPIXEL_ONE}, fill);
+                         } });
+            run_case("line/mostly outside x4000", "draw_line", [&]
+                     {
+                         for (int x = 0; x < 4000; x++)
+                         {
+                             img.draw_line(Point{x - 100000, -60000}, Point{x + 100000, 60000}, fill);
+                         } });
+            run_case("span/full rows x4000", "draw_span", [&]
+                     {
+                         for (int y = 0; y < 4000; y++)
+                         {
+                             img.draw_span(y, 0, 3999, fill);
+                         } });
+            vector<Point> big_triangle = {{100, 100}, {3900, 600}, {1500, 3900}};
+            run_case("polygon/triangle large", "draw_polygon", [&]
+                     { img.draw_polygon(big_triangle, fill); });
+            vector<vector<Point>> small_triangles;
+            SceneRandom rnd(42);
+            for (int i = 0; i < 10000; i++)
+            {
+                int x = rnd.uniform(0, 3940), y = rnd.uniform(0, 3940);
+                small_triangles.push_back({{x + rnd.uniform(0, 59), y},
+                                           {x, y + rnd.uniform(0, 59)},
+                                           {x + rnd.uniform(0, 59), y + rnd.uniform(0, 59)}});
+            }
+            run_case("polygon/triangles small x10000", "draw_polygon", [&]
+                     {
+                         for (const vector<Point> &t : small_triangles)
+                         {
+                             img.draw_polygon(t, fill);
+                         } });
+            run_case("polygon/triangle large", "draw_convex", [&]
+                     { img.draw_convex_polygon(big_triangle, fill); });
+            run_case("polygon/triangles small x10000", "draw_convex", [&]
+                     {
+                         for (const vector<Point> &t : small_triangles)
+                         {
+                             if (PNGImage::is_convex(t))
+                             {
+                                 img.draw_convex_polygon(t, fill);
+                             }
+                             else
+                             {
+                                 img.draw_polygon(t, fill);
+                             }
+                         } });
+            vector<Point> big_rect = {{100, 100}, {3899, 100}, {3899, 3899}, {100, 3899}};
+            run_case("rect/large", "draw_polygon", [&]
+                     { img.draw_polygon(big_rect, fill); });
+            run_case("rect/large", "draw_rect", [&]
+                     { img.draw_rect(big_rect[0], big_rect[2], fill); });
+            vector<vector<Point>> small_rects;
+            for (int i = 0; i < 10000; i++)
+            {
+                int x = rnd.uniform(0, 3940), y = rnd.uniform(0, 3940);
+                int w = rnd.uniform(1, 59), h = rnd.uniform(1, 59);
+                small_rects.push_back({{x, y}, {x + w, y}, {x + w, y + h}, {x, y + h}});
+            }
+            run_case("rect/small x10000", "draw_polygon", [&]
+                     {
+                         for (const vector<Point> &r : small_rects)
+                         {
+                             img.draw_polygon(r, fill);
+                         } });
+            run_case("rect/small x10000", "draw_rect", [&]
+                     {
+                         for (const vector<Point> &r : small_rects)
+                         {
+                             img.draw_rect(r[0], r[2], fill);
+                         } });
+            vector<Point> star;
+            for (int i = 0; i < 10; i++)
+            {
+                double r = (i % 2) ? 800 : 1900, a = M_PI * i / 5;
+                star.push_back({(int)(2000 + r * sin(a)), (int)(2000 - r * cos(a))});
+            }
+            run_case("polygon/star large", "draw_polygon", [&]
+                     { img.draw_polygon(star, fill); });
+            vector<size_t> star_ends = {star.size()};
+            run_case("contours/star large nonzero", "draw_contours", [&]
+                     { img.draw_contours(star, star_ends, fill, false); });
+            // the subpixel kernels, on the same shapes
+            auto to_fixed = [](const vector<Point> &points)
+            {
+                vector<FixedPoint> fixed;
+                for (const Point &p : points)
+                {
+                    fixed.push_back(FixedPoint::from_pixels(p));
+                }
+                return fixed;
+            };
+            vector<FixedPoint> big_triangle_fixed = to_fixed(big_triangle);
+            run_case("polygon/triangle large", "draw_polygon_fixed", [&]
+                     { img.draw_polygon(big_triangle_fixed, fill); });
+            vector<vector<FixedPoint>> small_triangles_fixed;
+            for (const vector<Point> &t : small_triangles)
+            {
+                small_triangles_fixed.push_back(to_fixed(t));
+            }
+            run_case("polygon/triangles small x10000", "draw_polygon_fixed", [&]
+                     {
+                         for (const vector<FixedPoint> &t : small_triangles_fixed)
+                         {
+                             img.draw_polygon(t, fill);
+                         } });
+            vector<FixedPoint> star_fixed = to_fixed(star);
+            run_case("polygon/star large", "draw_polygon_fixed", [&]
+                     { img.draw_polygon(star_fixed, fill); });
+            run_case("contours/star large nonzero", "draw_contours_fixed", [&]
+                     { img.draw_contours(star_fixed, star_ends, fill, false); });
+            // spans shaded by gradients spanning the image
+            std::shared_ptr<Gradient> linear = std::make_shared<Gradient>();
+            linear->x2 = 1;
+            linear->y2 = 1;
+            linear->stops = {{0, {255, 0, 0}}, {0.5, {255, 255, 0}}, {1, {0, 0, 255}}};
+            linear->build_ramp();
+            std::shared_ptr<Gradient> radial = std::make_shared<Gradient>(*linear);
+            radial->radial = true;
+            radial->fx = 0.3;
+            radial->spread = SpreadMethod::Reflect;
+            radial->r = 0.2;
+            auto run_shaded = [&](const char *kernel, const std::shared_ptr<Gradient> &gradient)
+            {
+                const GradientShader shader(Paint(gradient, 0, 0, 4000, 4000), img.format());
+                img.set_shader(&shader);
+                run_case("span/full rows x4000", kernel, [&]
+                         {
+                             for (int y = 0; y < 4000; y++)
+                             {
+                                 img.draw_span(y, 0, 3999, fill);
+                             } });
+                run_case("polygon/star large", kernel, [&]
+                         { img.draw_polygon(star_fixed, fill); });
+                img.set_shader(nullptr);
+            };
+            run_shaded("draw_span_linear", linear);
+            run_shaded("draw_span_radial", radial);
+        }
+
+        //! Benchmark element construction on a large scene with every
+        //! kind of element, the document being parsed once.
+        void run_parse_benchmarks()
+        {
+            SceneParams params;
+            params.seed = 9;
+            params.width = params.height = 4000;
+            params.polygons = 40000;
+            params.depth = 2;
+            params.uses = 10000;
+            params.polylines = 20000;
+            params.polyline_length = 4;
+            params.circles = 20000;
+            params.paths = 10000;
+            string source = generate_scene(params);
+            XMLDocument doc;
+            if (doc.Parse(source.c_str(), source.size()) != XML_SUCCESS)
+            {
+                throw runtime_error("Unable to parse synthetic scene");
+            }
+            vector<SVGElement *> elements;
+            Point dimensions;
+            run_case("parse/100k mixed elements", "build", [&]
+                     { readSVG(doc, dimensions, elements); }, nullptr, [&]
+                     {
+                         for (SVGElement *e : elements)
+                         {
+                             delete e;
+                         }
+                         elements.clear(); });
+            run_case("estimate/100k mixed elements", "estimate", [&]
+                     { estimate_cost(doc); });
+        }
+
+        //! Benchmark the spatial index on a large scene.
+        void run_index_benchmarks()
+        {
+            SceneParams params;
+            params.seed = 5;
+            params.width = params.height = 20000;
+            params.polygons = 100000;
+            params.polygon_size = 100;
+            string source = generate_scene(params);
+            XMLDocument doc;
+            if (doc.Parse(source.c_str(), source.size()) != XML_SUCCESS)
+            {
+                throw runtime_error("Unable to parse synthetic scene");
+            }
+            vector<SVGElement *> elements;
+            Point dimensions;
+            readSVG(doc, dimensions, elements);
+
+            SpatialIndex *index = nullptr;
+            run_case("index/100k triangles", "build", [&]
+                     { index = new SpatialIndex(elements); }, nullptr, [&]
+                     { delete index; });
+            index = new SpatialIndex(elements);
+            vector<Point> points;
+            SceneRandom rnd(6);
+            for (int i = 0; i < 10000; i++)
+            {
+                points.push_back({rnd.uniform(0, 19999), rnd.uniform(0, 19999)});
+            }
+            vector<size_t> found;
+            size_t total = 0;
+            run_case("index/100k bbox points x10000", "query", [&]
+                     {
+                         for (const Point &p : points)
+                         {
+                             index->candidates({p, p}, found);
+                             total += found.size();
+                         } });
+            run_case("index/100k top_at x10000", "query", [&]
+                     {
+                         for (const Point &p : points)
+                         {
+                             total += index->top_at(p) != nullptr;
+                         } });
+            run_case("index/100k rects 200px x1000", "query", [&]
+                     {
+                         for (int i = 0; i < 1000; i++)
+                         {
+                             const Point &p = points[i];
+                             total += index->intersecting({p, {p.x + 199, p.y + 199}}).size();
+                         } });
+            run_case("index/100k linear scan x100", "query", [&]
+                     {
+                         for (int i = 0; i < 100; i++)
+                         {
+                             for (size_t s = 0; s < index->size(); s++)
+                             {
+                                 total += index->box(s).intersects({points[i], points[i]});
+                             }
+                         } });
+            delete index;
+            for (SVGElement *e : elements)
+            {
+                delete e;
+            }
+        }
+
+        void write_json(const string &file) const
+        {
+            ofstream out(file);
+            if (!out)
+            {
+                throw runtime_error("Unable to write " + file);
+            }
+            // one result per line, so that results are easy to diff and parse
+            out << "{\"unit\": \"ms\", \"results\": [" << endl;
+            for (size_t i = 0; i < results.size(); i++)
+            {
+                const BenchResult &r = results[i];
+                out << fixed << setprecision(6)
+                    << "{\"name\": \"" << r.name << "\", \"phase\": \"" << r.phase
+                    << "\", \"repetitions\": " << r.repetitions
+                    << ", \"min\": " << r.min << ", \"median\": " << r.median
+                    << ", \"p99\": " << r.p99 << "}"
+                    << (i + 1 < results.size() ? "," : "") << endl;
+            }
+            out << "]}" << endl;
+        }
+
+        void compare_with(const string &file) const
+        {
+            ifstream in(file);
+            if (!in)
+            {
+                throw runtime_error("Unable to read " + file);
+            }
+            map<string, double> baseline;
+            string line;
+            while (getline(in, line))
+            {
+                size_t name_at = line.find("\"name\": \"");
+                size_t phase_at = line.find("\"phase\": \"");
+                size_t median_at = line.find("\"median\": ");
+                if (name_at == string::npos || phase_at == string::npos || median_at == string::npos)
+                {
+                    continue;
+                }
+                name_at += 9;
+                phase_at += 10;
+                string key = line.substr(name_at, line.find('"', name_at) - name_at) + " " +
+                             line.substr(phase_at, line.find('"', phase_at) - phase_at);
+                baseline[key] = atof(line.c_str() + median_at + 10);
+            }
+            cout << "== COMPARISON WITH " << file << " (median, new / old) ==" << endl;
+            double log_ratio_sum = 0;
+            int compared = 0;
+            for (const BenchResult &r : results)
+            {
+                auto it = baseline.find(r.name + " " + r.phase);
+                if (it == baseline.end() || it->second <= 0 || r.median <= 0)
+                {
+                    continue;
+                }
+                log_ratio_sum += log(r.median / it->second);
+                compared++;
+                cout << left << setw(36) << r.name << setw(12) << r.phase << right << fixed
+                     << setprecision(3) << setw(10) << it->second << " -> " << setw(10) << r.median
+                     << " ms  x" << setprecision(2) << r.median / it->second << endl;
+            }
+            if (compared > 0)
+            {
+                cout << "Geometric mean over " << compared << " cases: x" << setprecision(3)
+                     << exp(log_ratio_sum / compared) << endl;
+            }
+        }
+
+    public:
+        BenchDriver(const string &root_path, int repetitions, int warmup,
+                    const string &filter, const string &scratch_file)
+            : root_path(root_path), repetitions(repetitions), warmup(warmup),
+              filter(filter), scratch_file(scratch_file)
+        {
+        }
+
+        void run_benchmarks(const string &sweep)
+        {
+            if (!sweep.empty())
+            {
+                run_sweep(sweep);
+                return;
+            }
+            run_primitive_benchmarks();
+            run_index_benchmarks();
+            run_parse_benchmarks();
+
+            string dir_path = root_path + "/input";
+            ::DIR *directory = ::opendir(dir_path.c_str());
+            if (directory == nullptr)
+            {
+                cerr << "Unable to open input directory " << dir_path << endl;
+                return;
+            }
+            vector<string> files;
+            ::dirent *entry;
+            while ((entry = readdir(directory)) != nullptr)
+            {
+                string fname = entry->d_name;
+                if (entry->d_type == DT_REG && fname.size() > 4 &&
+                    fname.compare(fname.size() - 4, 4, ".svg") == 0)
+                {
+                    files.push_back(fname);
+                }
+            }
+            ::closedir(directory);
+            sort(files.begin(), files.end());
+            for (const string &fname : files)
+            {
+                run_scene("input/" + fname, dir_path + "/" + fname, false);
+            }
+
+            SceneParams triangles;
+            triangles.width = triangles.height = 2000;
+            triangles.polygons = 20000;
+            run_scene("synthetic/triangles_20k", generate_scene(triangles), true);
+            SceneParams circles;
+            circles.seed = 2;
+            circles.width = circles.height = 2000;
+            circles.circles = 5000;
+            run_scene("synthetic/circles_5k", generate_scene(circles), true);
+            SceneParams polyline;
+            polyline.seed = 3;
+            polyline.width = polyline.height = 2000;
+            polyline.polylines = 1;
+            polyline.polyline_length = 50000;
+            run_scene("synthetic/polyline_50k", generate_scene(polyline), true);
+            SceneParams paths;
+            paths.seed = 4;
+            paths.width = paths.height = 2000;
+            paths.paths = 2000;
+            run_scene("synthetic/paths_2k", generate_scene(paths), true);
+        }
+
+        //! Benchmark synthetic scenes along one parameter axis.
+        //! @param spec Axis and values, as 'axis=v1,v2,...'.
+        void run_sweep(const string &spec)
+        {
+            size_t eq = spec.find('=');
+            if (eq == string::npos)
+            {
+                throw runtime_error("Invalid sweep: " + spec);
+            }
+            string axis = spec.substr(0, eq);
+            stringstream values(spec.substr(eq + 1));
+            string value;
+            while (getline(values, value, ','))
+            {
+                // baseline scene: a few of everything, so that each axis matters
+                SceneParams params;
+                params.width = params.height = 1000;
+                params.polygons = 1000;
+                params.vertices = 3;
+                params.depth = 1;
+                params.uses = 100;
+                params.polylines = 1;
+                params.polyline_length = 1000;
+                params.circles = 100;
+                int v = atoi(value.c_str());
+                if (axis == "polygons")
+                    params.polygons = v;
+                else if (axis == "vertices")
+                    params.vertices = v;
+                else if (axis == "depth")
+                    params.depth = v;
+                else if (axis == "uses")
+                    params.uses = v;
+                else if (axis == "polyline-length")
+                    params.polyline_length = v;
+                else if (axis == "circles")
+                    params.circles = v;
+                else if (axis == "paths")
+                    params.paths = v;
+                else if (axis == "size")
+                    params.width = params.height = v;
+                else
+                {
+                    throw runtime_error("Unknown sweep axis: " + axis);
+                }
+                run_scene("sweep/" + axis + "=" + value, generate_scene(params), true);
+            }
+        }
+
+        void report(const string &json_file, const string &compare_file) const
+        {
+            if (!json_file.empty())
+            {
+                write_json(json_file);
+                cout << "Results written to " << json_file << endl;
+            }
+            if (!compare_file.empty())
+            {
+                compare_with(compare_file);
+            }
+        }
+    };
+}
+
+int main(int argc, char **argv)
+{
+    int repetitions = 10, warmup = 1;
+    string root = ".", filter, json_file, compare_file, sweep;
+    string scratch_file = "/tmp/svgtopng_bench.png";
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--reps" && has_value)
+            repetitions = max(atoi(argv[++i]), 1);
+        else if (arg == "--warmup" && has_value)
+            warmup = max(atoi(argv[++i]), 0);
+        else if (arg == "--filter" && has_value)
+            filter = argv[++i];
+        else if (arg == "--root" && has_value)
+            root = argv[++i];
+        else if (arg == "--json" && has_value)
+            json_file = argv[++i];
+        else if (arg == "--compare" && has_value)
+            compare_file = argv[++i];
+        else if (arg == "--sweep" && has_value)
+            sweep = argv[++i];
+        else if (arg == "--scratch" && has_value)
+            scratch_file = argv[++i];
+        else
+        {
+            cout << "Usage: bench [--reps N] [--warmup N] [--filter text] [--root dir]" << endl
+                 << "             [--json results.json] [--compare baseline.json] [--scratch file.png]" << endl
+                 << "             [--sweep axis=v1,v2,...]" << endl
+                 << "Sweep axes: polygons vertices depth uses polyline-length circles paths size" << endl;
+            return 1;
+        }
+    }
+    svg::BenchDriver driver(root, repetitions, warmup, filter, scratch_file);
+    driver.run_benchmarks(sweep);
+    driver.report(json_file, compare_file);
+    return 0;
+}
@@ -1,23 +1,566 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
 #include <string>
 #include <vector>
 #include "SVGElements.hpp"
+#include "PNGWriter.hpp"
+#include "SpatialIndex.hpp"
+#include "Stats.hpp"
+#include "Trace.hpp"
+#include "external/tinyxml2/tinyxml2.h"
 
 namespace svg
 {
+    namespace
+    {
+        //! Milliseconds elapsed since a time point.
+        double elapsed_ms(std::chrono::steady_clock::time_point since)
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+        }
+
+        //! Records a phase that ends now.
+        //! @return The end time, which starts the next phase.
+        double trace_phase(Tracer *tracer, const char *name, double start_us)
+        {
+            double end_us = tracer->now_us();
+            tracer->phase(name, start_us, end_us);
+            return end_us;
+        }
+
+        //! Gathers the shapes of a scene in drawing order, looking
+        //! inside groups.
+        //! @param elements Elements to search.
+        //! @param leaves Vector to append the shapes to.
+        void collect_leaves(const std::vector<SVGElement *> &elements,
+                            std::vector<const SVGElement *> &leaves)
+        {
+            for (const SVGElement *e : elements)
+            {
+                if (e->children() != nullptr)
+                {
+                    collect_leaves(*e->children(), leaves);
+                }
+                else
+                {
+                    leaves.push_back(e);
+                }
+            }
+        }
+
+        //! Output canvas of a document.
+        struct OutputFit
+        {
+            double scale;  //!< Scale from document to output coordinates.
+            double width;  //!< Output width, before rounding.
+            double height; //!< Output height, before rounding.
+        };
+
+        //! Computes the output canvas requested by the options.
+        //! @param dimensions Document dimensions.
+        //! @param options Conversion options (width, height and scale).
+        //! @return The output canvas (the document size, unscaled, if it
+        //! has no area).
+        OutputFit output_fit(const Point &dimensions, const ConvertOptions &options)
+        {
+            if (options.width < 0 || options.height < 0 || options.scale <= 0)
+            {
+                throw std::runtime_error("Output width, height and scale must be positive");
+            }
+            const double doc_width = dimensions.x, doc_height = dimensions.y;
+            OutputFit fit = {1, doc_width, doc_height};
+            if (dimensions.x <= 0 || dimensions.y <= 0)
+            {
+                return fit;
+            }
+            if (options.width > 0 && options.height > 0)
+            {
+                fit.scale = std::min(options.width / doc_width, options.height / doc_height);
+                fit.width = options.width;
+                fit.height = options.height;
+            }
+            else if (options.width > 0)
+            {
+                fit.scale = options.width / doc_width;
+                fit.width = options.width;
+                fit.height = doc_height * fit.scale;
+            }
+            else if (options.height > 0)
+            {
+                fit.scale = options.height / doc_height;
+                fit.width = doc_width * fit.scale;
+                fit.height = options.height;
+            }
+            fit.scale *= options.scale;
+            fit.width *= options.scale;
+            fit.height *= options.scale;
+            return fit;
+        }
+
+        //! Owns the elements of a conversion, which are deleted on every
+        //! exit path, errors included.
+        struct ElementOwner
+        {
+            std::vector<SVGElement *> elements;
+            ~ElementOwner()
+            {
+                release();
+            }
+            void release()
+            {
+                for (SVGElement *e : elements)
+                {
+                    delete e;
+                }
+                elements.clear();
+            }
+        };
+
+        //! Stops allocation counting when a conversion ends, even on errors.
+        struct AllocationScope
+        {
+            bool active;
+            ~AllocationScope()
+            {
+                if (active)
+                {
+                    AllocationCounter::stop();
+                }
+            }
+        };
+
+        //! Draws a scene one band of rows at a time, streaming each band
+        //! to the PNG file, so only one band is ever in memory.
+        //! @param svg_elements Scene elements.
+        //! @param dimensions Canvas dimensions.
+        //! @param png_file Output file name.
+        //! @param options Conversion options (strip height, statistics).
+        void render_strips(const std::vector<SVGElement *> &svg_elements,
+                           const Point &dimensions,
+                           const std::string &png_file,
+                           const ConvertOptions &options)
+        {
+            RenderStats *stats = options.stats;
+            Tracer *tracer = Tracer::current();
+            if (options.overdraw != nullptr)
+            {
+                *options.overdraw = OverdrawStats();
+            }
+
+            // Groups only draw their members in order, so the scene can be
+            // drawn as its leaves, each skipped in the bands it misses.
+            std::vector<const SVGElement *> leaves;
+            collect_leaves(svg_elements, leaves);
+            std::vector<BoundingBox> boxes;
+            boxes.reserve(leaves.size());
+            for (const SVGElement *e : leaves)
+            {
+                boxes.push_back(e->bounding_box());
+            }
+            // Leaves by top row: each band takes in the leaves starting
+            // above its bottom and drops those ending above its top, so
+            // no band looks at every leaf.
+            std::vector<size_t> by_top(leaves.size());
+            for (size_t i = 0; i < by_top.size(); i++)
+            {
+                by_top[i] = i;
+            }
+            std::sort(by_top.begin(), by_top.end(), [&](size_t l, size_t r)
+                      { return boxes[l].min.y < boxes[r].min.y; });
+            size_t next = 0;
+            std::vector<size_t> active;
+
+            const int width = dimensions.x;
+            const int height = dimensions.y;
+            const int strip = std::min(options.strip_height, height);
+            PNGWriter writer(png_file, width, height);
+            std::unique_ptr<PNGImage> band(new PNGImage(width, strip));
+            std::vector<unsigned char> rgb((size_t)width * 3);
+            // counters of the bands replaced by a shorter last band
+            unsigned long long pixels_written = 0, ellipse_hits = 0, ellipse_misses = 0;
+            for (int top = 0; top < height; top += strip)
+            {
+                auto phase_start = std::chrono::steady_clock::now();
+                double trace_start = tracer != nullptr ? tracer->now_us() : 0;
+                const int rows = std::min(strip, height - top);
+                if (rows != band->height())
+                {
+                    pixels_written += band->pixels_written();
+                    ellipse_hits += band->ellipse_profile_hits();
+                    ellipse_misses += band->ellipse_profile_misses();
+                    band.reset(new PNGImage(width, rows));
+                }
+                else
+                {
+                    band->fill({255, 255, 255});
+                }
+                band->set_top(top);
+                if (options.overdraw != nullptr)
+                {
+                    band->track_overdraw();
+                }
+                for (; next < by_top.size() && boxes[by_top[next]].min.y < top + rows; next++)
+                {
+                    active.push_back(by_top[next]);
+                }
+                active.erase(std::remove_if(active.begin(), active.end(), [&](size_t i)
+                                            { return boxes[i].max.y < top; }),
+                             active.end());
+                // leaf indices are the drawing order
+                std::sort(active.begin(), active.end());
+                for (size_t i : active)
+                {
+                    leaves[i]->render(*band);
+                }
+                if (tracer != nullptr)
+                {
+                    trace_start = trace_phase(tracer, "raster", trace_start);
+                }
+                if (stats != nullptr)
+                {
+                    stats->raster_ms += elapsed_ms(phase_start);
+                    phase_start = std::chrono::steady_clock::now();
+                }
+                if (options.overdraw != nullptr)
+                {
+                    options.overdraw->merge(OverdrawStats::measure(*band));
+                }
+
+                for (int y = 0; y < rows; y++)
+                {
+                    const Pixel *src = band->row(y);
+                    for (int x = 0; x < width; x++)
+                    {
+                        std::memcpy(&rgb[(size_t)x * 3], &src[x], 3);
+                    }
+                    writer.write_row(rgb.data());
+                }
+                if (tracer != nullptr)
+                {
+                    trace_phase(tracer, "encode", trace_start);
+                }
+                if (stats != nullptr)
+                {
+                    stats->encode_ms += elapsed_ms(phase_start);
+                }
+            }
+            auto phase_start = std::chrono::steady_clock::now();
+            writer.finish();
+            if (stats != nullptr)
+            {
+                stats->encode_ms += elapsed_ms(phase_start);
+                stats->pixels_written = pixels_written + band->pixels_written();
+                stats->ellipse_profile_hits = ellipse_hits + band->ellipse_profile_hits();
+                stats->ellipse_profile_misses = ellipse_misses + band->ellipse_profile_misses();
+                stats->framebuffer_bytes = (unsigned long long)band->stride() * strip * sizeof(Pixel);
+            }
+        }
+    }
+
+    void check_output_canvas(const Point &dimensions, const ConvertOptions &options)
+    {
+        const OutputFit fit = output_fit(dimensions, options);
+        LimitGuard(options.limits).check_canvas(fit.width, fit.height);
+    }
+
+    void fit_output(Point &dimensions, std::vector<SVGElement *> &svg_elements, const ConvertOptions &options)
+    {
+        const OutputFit fit = output_fit(dimensions, options);
+        LimitGuard(options.limits).check_canvas(fit.width, fit.height);
+        const double scale = fit.scale;
+        Point fitted = {std::max(1, (int)::lround(fit.width)), std::max(1, (int)::lround(fit.height))};
+        double dx = (fitted.x - dimensions.x * scale) / 2;
+        double dy = (fitted.y - dimensions.y * scale) / 2;
+        if (scale == 1 && dx == 0 && dy == 0)
+        {
+            return;
+        }
+        for (SVGElement *e : svg_elements)
+        {
+            e->fit(scale, dx, dy);
+        }
+        dimensions = fitted;
+    }
+
+    Scene::Scene(const std::string &svg_file, const ConvertOptions &options)
+    {
+        tinyxml2::XMLDocument doc;
+        if (doc.LoadFile(svg_file.c_str()) != tinyxml2::XML_SUCCESS)
+        {
+            throw std::runtime_error("Unable to load " + svg_file);
+        }
+        build(doc, options);
+    }
+
+    Scene::Scene(tinyxml2::XMLDocument &doc, const ConvertOptions &options)
+    {
+        build(doc, options);
+    }
+
+    Scene::~Scene()
+    {
+        for (SVGElement *e : elements_)
+        {
+            delete e;
+        }
+    }
+
+    void Scene::build(tinyxml2::XMLDocument &doc, const ConvertOptions &options)
+    {
+        try
+        {
+            LimitGuard guard(options.limits);
+            readSVG(doc, dimensions_, elements_, nullptr, &guard, &options);
+            fit_output(dimensions_, elements_, options);
+            index_.reset(new SpatialIndex(elements_));
+        }
+        catch (...)
+        {
+            for (SVGElement *e : elements_)
+            {
+                delete e;
+            }
+            throw;
+        }
+    }
+
+    const Point &Scene::dimensions() const
+    {
+        return dimensions_;
+    }
+
+    const std::vector<SVGElement *> &Scene::elements() const
+    {
+        return elements_;
+    }
+
+    void Scene::render(PNGImage &img) const
+    {
+        for (const SVGElement *e : elements_)
+        {
+            e->render(img);
+        }
+    }
+
+    size_t Scene::shape_count() const
+    {
+        return index_->size();
+    }
+
+    const SpatialIndex &Scene::index() const
+    {
+        return *index_;
+    }
+
+    size_t Scene::render_region(PNGImage &img, int left, int top) const
+    {
+        img.set_left(left);
+        img.set_top(top);
+        // Groups only draw their members in order, so drawing the shapes
+        // that meet the region gives the same pixels as drawing everything.
+        const BoundingBox region = {{left, top}, {left + img.width() - 1, top + img.height() - 1}};
+        static thread_local std::vector<size_t> found;
+        index_->candidates(region, found);
+        for (size_t i : found)
+        {
+            index_->shape(i)->render(img);
+        }
+        return found.size();
+    }
+
+    CostEstimate estimate_cost(const std::string &svg_file, const ConvertOptions &options)
+    {
+        tinyxml2::XMLDocument doc;
+        if (doc.LoadFile(svg_file.c_str()) != tinyxml2::XML_SUCCESS)
+        {
+            throw std::runtime_error("Unable to load " + svg_file);
+        }
+        return estimate_cost(doc, options);
+    }
+
+    CostEstimate estimate_cost(tinyxml2::XMLDocument &doc, const ConvertOptions &options)
+    {
+        // Rough size of an element object with its heap blocks, besides
+        // its vertices.
+        const unsigned long long ELEMENT_BYTES = 128;
+
+        const auto start = std::chrono::steady_clock::now();
+        Point dimensions;
+        ElementOwner owner;
+        std::vector<SVGElement *> &elements = owner.elements;
+        LimitGuard guard(options.limits);
+        readSVG(doc, dimensions, elements, nullptr, &guard, &options);
+        CostEstimate cost;
+        fit_output(dimensions, elements, options);
+        RenderStats counts;
+        counts.count_elements(elements);
+        cost.element_counts = counts.element_counts;
+        for (const auto &count : cost.element_counts)
+        {
+            cost.elements += count.second;
+        }
+        cost.vertices = counts.vertices;
+        cost.width = dimensions.x;
+        cost.height = dimensions.y;
+        cost.canvas_pixels = (unsigned long long)cost.width * cost.height;
+        std::vector<const SVGElement *> leaves;
+        collect_leaves(elements, leaves);
+        for (const SVGElement *e : leaves)
+        {
+            const BoundingBox box = e->bounding_box();
+            const BoundingBox clipped = {{std::max(box.min.x, 0), std::max(box.min.y, 0)},
+                                         {std::min(box.max.x, cost.width - 1),
+                                          std::min(box.max.y, cost.height - 1)}};
+            cost.filled_area += clipped.area();
+        }
+        owner.release();
+
+        // same row alignment as PNGImage
+        const int per_line = PNGImage::ROW_ALIGNMENT / (int)sizeof(Pixel);
+        const unsigned long long stride = (cost.width + per_line - 1) / per_line * per_line;
+        const unsigned long long rgb_row = (unsigned long long)cost.width * 3;
+        if (options.strip_height > 0)
+        {
+            const int strip = std::min(options.strip_height, cost.height);
+            cost.framebuffer_bytes = stride * strip * sizeof(Pixel);
+            cost.encode_bytes = rgb_row + PNGWriter::memory_bytes(cost.width);
+        }
+        else
+        {
+            // save() copies the image to RGB, then the encoder filters
+            // it into a second buffer and compresses that into a third
+            // of at most about the same size
+            cost.framebuffer_bytes = stride * cost.height * sizeof(Pixel);
+            cost.encode_bytes = rgb_row * cost.height + 2 * (rgb_row + 1) * cost.height;
+        }
+        cost.scene_bytes = cost.elements * ELEMENT_BYTES + cost.vertices * sizeof(Point);
+        cost.peak_bytes = cost.framebuffer_bytes + cost.scene_bytes + cost.encode_bytes;
+        cost.estimate_ms = elapsed_ms(start);
+        return cost;
+    }
+
     void convert(const std::string &svg_file, const std::string &png_file)
     {
+        convert(svg_file, png_file, ConvertOptions());
+    }
+
+    void convert(const std::string &svg_file, const std::string &png_file, const ConvertOptions &options)
+    {
+        if (options.strip_height > 0 && !options.overdraw_heatmap.empty())
+        {
+            throw std::runtime_error("An overdraw heatmap needs the whole image; it cannot be combined with strips");
+        }
+        RenderStats *stats = options.stats;
+        if (stats != nullptr)
+        {
+            *stats = RenderStats();
+            AllocationCounter::start();
+        }
+        AllocationScope allocation_scope = {stats != nullptr};
+        auto start = std::chrono::steady_clock::now();
+        auto phase_start = start;
+        LimitGuard guard(options.limits);
+        Tracer *tracer = options.trace;
+        TraceScope trace_scope(tracer);
+        const double trace_begin = tracer != nullptr ? tracer->now_us() : 0;
+        double trace_start = trace_begin;
+
+        tinyxml2::XMLDocument doc;
+        if (doc.LoadFile(svg_file.c_str()) != tinyxml2::XML_SUCCESS)
+        {
+            throw std::runtime_error("Unable to load " + svg_file);
+        }
+        if (tracer != nullptr)
+        {
+            trace_start = trace_phase(tracer, "xml_load", trace_start);
+        }
+        if (stats != nullptr)
+        {
+            stats->xml_load_ms = elapsed_ms(phase_start);
+            phase_start = std::chrono::steady_clock::now();
+        }
+
         Point dimensions;
-        std::vector<SVGElement *> svg_elements;
-        readSVG(svg_file, dimensions, svg_elements);
-        PNGImage img(dimensions.x, dimensions.y);
-        for (SVGElement* e : svg_elements)
+        ElementOwner owner;
+        std::vector<SVGElement *> &svg_elements = owner.elements;
+        readSVG(doc, dimensions, svg_elements, stats, &guard, &options);
+        fit_output(dimensions, svg_elements, options);
+        if (tracer != nullptr)
         {
-            e->draw(img);
+            trace_start = trace_phase(tracer, "build", trace_start);
         }
-        img.save(png_file);
-        for (SVGElement* e  : svg_elements)
+        if (stats != nullptr)
         {
-            delete e;
+            stats->build_ms = elapsed_ms(phase_start) - stats->transform_ms;
+            phase_start = std::chrono::steady_clock::now();
+        }
+
+        if (options.strip_height > 0)
+        {
+            render_strips(svg_elements, dimensions, png_file, options);
+        }
+        else
+        {
+            PNGImage img(dimensions.x, dimensions.y);
+            if (options.overdraw != nullptr || !options.overdraw_heatmap.empty())
+            {
+                img.track_overdraw();
+            }
+            for (SVGElement* e : svg_elements)
+            {
+                e->render(img);
+            }
+            if (tracer != nullptr)
+            {
+                trace_start = trace_phase(tracer, "raster", trace_start);
+            }
+            if (stats != nullptr)
+            {
+                stats->raster_ms = elapsed_ms(phase_start);
+                phase_start = std::chrono::steady_clock::now();
+            }
+
+            img.save(png_file);
+            if (tracer != nullptr)
+            {
+                trace_start = trace_phase(tracer, "encode", trace_start);
+            }
+            if (stats != nullptr)
+            {
+                stats->encode_ms = elapsed_ms(phase_start);
+                stats->pixels_written = img.pixels_written();
+                stats->ellipse_profile_hits = img.ellipse_profile_hits();
+                stats->ellipse_profile_misses = img.ellipse_profile_misses();
+                stats->framebuffer_bytes = (unsigned long long)img.stride() * img.height() * sizeof(Pixel);
+            }
+            if (options.overdraw != nullptr)
+            {
+                *options.overdraw = OverdrawStats::measure(img);
+            }
+            if (!options.overdraw_heatmap.empty())
+            {
+                save_overdraw_heatmap(img, options.overdraw_heatmap);
+            }
+        }
+        if (stats != nullptr)
+        {
+            stats->count_elements(svg_elements);
+        }
+        owner.release();
+        if (tracer != nullptr)
+        {
+            trace_phase(tracer, "convert", trace_begin);
+        }
+        if (stats != nullptr)
+        {
+            AllocationCounter::stop();
+            stats->allocations = AllocationCounter::count();
+            stats->allocated_bytes = AllocationCounter::bytes();
+            stats->total_ms = elapsed_ms(start);
+            stats->peak_rss_kb = peak_rss_kb();
         }
     }
-}
\ No newline at end of file
+}
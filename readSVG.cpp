@@ -1,5 +1,11 @@
+#include <algorithm>
+#include <climits>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
+#include "ElementRegistry.hpp"
 #include "SVGElements.hpp"
 #include "external/tinyxml2/tinyxml2.h"
 #include <string.h>
@@ -9,91 +15,114 @@ using namespace tinyxml2;
 
 namespace svg
 {
-    //! Gets transform-origin point.
-    //! @param child The XMLElement to search for transform-origin
-    //! @return Point transform-origin from XMLELement
-    Point getTransformOrigin(XMLElement *child)
+    //! Gets the viewBox of the root element.
+    //! @param root The root XMLElement.
+    //! @param view_box Receives min-x, min-y, width and height.
+    //! @return True if the root has a valid viewBox.
+    bool getViewBox(XMLElement *root, double view_box[4])
     {
-        std::string transform_origin_str;
-        if (child->Attribute("transform-origin") != NULL)
+        if (root->Attribute("viewBox") == NULL)
         {
-            // get transform_origin string (ex: "150 150" or "150, 150")
-            transform_origin_str = child->Attribute("transform-origin");
-
-            // replace commas with spaces
-            for (char &c : transform_origin_str)
+            return false;
+        }
+        std::string view_box_str = root->Attribute("viewBox");
+        for (char &c : view_box_str)
+        {
+            if (c == ',')
             {
-                if (c == ',')
-                {
-                    c = ' ';
-                }
+                c = ' ';
             }
         }
-        else
+        stringstream sstream(view_box_str);
+        for (int i = 0; i < 4; i++)
         {
-            // if there is no "transform-origin" attritube function should return {0,0}
-            transform_origin_str = "0 0";
+            if (!(sstream >> view_box[i]))
+            {
+                return false;
+            }
         }
-        int torigin_x, torigin_y;
-        stringstream originSStream(transform_origin_str);
-        originSStream >> torigin_x >> torigin_y; // get first and second values
-        Point res = {torigin_x, torigin_y};
-        return res;
+        return view_box[2] > 0 && view_box[3] > 0;
     }
 
-    //! Applies transformations to SVGElement.
-    //! @param child The XMLElement with transformations.
-    //! @param elem The SVGElement to transform.
-    void applyTransform(XMLElement *child, SVGElement *elem)
+    //! Gets the points of a polyline or polygon.
+    //! @param attributes Attributes of an element with a points attribute.
+    //! @return Vector of points (a trailing unpaired value is ignored).
+    std::vector<FixedPoint> getPoints(const ElementAttributes &attributes)
     {
-        std::string operation;
-        if (child->Attribute("transform") != NULL)
+        // numbers are separated by spaces and commas; strtod skips the
+        // spaces and reads fractions without copying the attribute
+        const char *s = attributes.get(attr::points);
+        std::vector<FixedPoint> points;
+        if (s == NULL)
         {
-            // get transform attribute
-            std::string transform = child->Attribute("transform");
-            // replace characters '(', ')' and ',' with spaces
-            for (char &c : transform)
+            return points;
+        }
+        for (;;)
+        {
+            double value[2];
+            for (double &v : value)
             {
-                if (c == '(' || c == ')' || c == ',')
+                while (*s == ',' || isspace((unsigned char)*s))
+                {
+                    s++;
+                }
+                char *end;
+                v = strtod(s, &end);
+                if (end == s)
                 {
-                    c = ' ';
+                    return points;
                 }
+                s = end;
             }
+            points.push_back(FixedPoint::from_double(value[0], value[1]));
+        }
+    }
 
-            std::stringstream sstream(transform);
-            sstream >> operation;
-            if (operation == "rotate")
+    namespace
+    {
+        //! Gets the fill of an element: a color, or a gradient such as
+        //! fill="url(#id)". Gradients with a single stop are solid.
+        //! @param xml The XML element.
+        //! @param value The fill attribute.
+        //! @param reader Reader of the document, which finds gradients.
+        //! @param x Left of the element's bounding box.
+        //! @param y Top of the bounding box.
+        //! @param width Width of the bounding box.
+        //! @param height Height of the bounding box.
+        //! @return The fill.
+        Paint getFill(XMLElement *xml, const char *value, ElementReader &reader,
+                      double x, double y, double width, double height)
+        {
+            if (value == NULL || strncmp(value, "url(", 4) != 0)
             {
-                int v;
-                sstream >> v;
-                elem->rotate(v);
+                return parse_color(value);
             }
-            else if (operation == "scale")
+            // url(#id), url('#id') or url("#id")
+            std::string id = value + 4;
+            id = id.substr(0, id.find(')'));
+            id.erase(std::remove(id.begin(), id.end(), '\''), id.end());
+            id.erase(std::remove(id.begin(), id.end(), '"'), id.end());
+            id.erase(std::remove_if(id.begin(), id.end(), [](char c)
+                                    { return isspace((unsigned char)c); }),
+                     id.end());
+            if (id.empty() || id[0] != '#')
             {
-                int v;
-                sstream >> v;
-                elem->scale(v);
+                throw runtime_error("Unsupported fill: " + std::string(value));
             }
-            else if (operation == "translate")
+            std::shared_ptr<const Gradient> gradient = reader.gradient(xml, id.substr(1));
+            if (gradient->stops.size() == 1)
             {
-                int x, y;
-                sstream >> x;
-                sstream >> y;
-                elem->translate(x, y);
+                return gradient->stops[0].color;
             }
+            return Paint(gradient, x, y, width, height);
         }
-    }
 
-    //! Seaches an XMLElement for an SVGElement and pushes it to vector svg_elements.
-    //! @param child XMLElement to search.
-    //! @param svg_elements Vector of SVGElements to push to.
-    //! @param elements_with_id Map with all elements that have an id.
-    void getElement(XMLElement *child, std::vector<SVGElement *> &svg_elements, std::map<std::string, SVGElement *> &elements_with_id)
-    {
-        // ELLIPSE
-        if (std::string(child->Name()) == "ellipse")
-        {
+        // Factories of the built-in elements, registered by
+        // ElementRegistry::standard().
 
+        SVGElement *readEllipse(XMLElement *xml, const ElementAttributes &attributes,
+                                const FixedPoint &transform_origin, ElementReader &reader)
+        {
             // exemplo:
             // cx="100"
             // cy="100"
@@ -101,70 +130,36 @@ namespace svg
             // ry="20"
             // fill="red"
 
-            Point center;
-            center.x = child->IntAttribute("cx");
-            center.y = child->IntAttribute("cy");
-
-            Point radius;
-            radius.x = child->IntAttribute("rx");
-            radius.y = child->IntAttribute("ry");
+            double cx = attributes.get_double(attr::cx), cy = attributes.get_double(attr::cy);
+            double rx = attributes.get_double(attr::rx), ry = attributes.get_double(attr::ry);
+            FixedPoint center = FixedPoint::from_double(cx, cy);
+            FixedPoint radius = FixedPoint::from_double(rx, ry);
 
-            Color color = parse_color(child->Attribute("fill"));
-
-            // get transform_origin point
-            Point transform_origin = getTransformOrigin(child);
-            // dynamically allocate new ellipse object
-            Ellipse *elem = new Ellipse(color, center, radius, transform_origin);
-            // check and apply transforms
-            applyTransform(child, elem);
-            // check if child has an id and add to elements_with_id map
-            if (child->Attribute("id") != NULL)
-            {
-                elements_with_id[child->Attribute("id")] = elem;
-            }
-            // push ellipse into svg_elements vector
-            svg_elements.push_back(elem);
+            Paint fill = getFill(xml, attributes.get(attr::fill), reader, cx - rx, cy - ry, 2 * rx, 2 * ry);
+            return new Ellipse(fill, center, radius, transform_origin);
         }
 
-        // CIRCLE
-        if (std::string(child->Name()) == "circle")
+        SVGElement *readCircle(XMLElement *xml, const ElementAttributes &attributes,
+                               const FixedPoint &transform_origin, ElementReader &reader)
         {
-
             // exemplo:
             // cx="100"
             // cy="100"
             // r="95"
             // fill="red"
 
-            Point center;
-            center.x = child->IntAttribute("cx");
-            center.y = child->IntAttribute("cy");
-
-            Point radius;
-            radius.x = child->IntAttribute("r");
-            radius.y = radius.x;
-
-            Color color = parse_color(child->Attribute("fill"));
+            double cx = attributes.get_double(attr::cx), cy = attributes.get_double(attr::cy);
+            double r = attributes.get_double(attr::r);
+            FixedPoint center = FixedPoint::from_double(cx, cy);
+            FixedPoint radius = FixedPoint::from_double(r, r);
 
-            // get transform_origin point
-            Point transform_origin = getTransformOrigin(child);
-            // dynamically allocate new ellipse object
-            Ellipse *elem = new Ellipse(color, center, radius, transform_origin);
-            // check and apply transforms
-            applyTransform(child, elem);
-            // check if child has an id and add to elements_with_id map
-            if (child->Attribute("id") != NULL)
-            {
-                elements_with_id[child->Attribute("id")] = elem;
-            }
-            // push ellipse into svg_elements vector
-            svg_elements.push_back(elem);
+            Paint fill = getFill(xml, attributes.get(attr::fill), reader, cx - r, cy - r, 2 * r, 2 * r);
+            return new Ellipse(fill, center, radius, transform_origin);
         }
 
-        // LINE
-        if (std::string(child->Name()) == "line")
+        SVGElement *readLine(XMLElement *, const ElementAttributes &attributes,
+                             const FixedPoint &transform_origin, ElementReader &)
         {
-
             // exemplo:
             // x1="1"
             // y1="198"
@@ -172,137 +167,53 @@ namespace svg
             // y2="1"
             // stroke="red"
 
-            Point start;
-            start.x = child->IntAttribute("x1");
-            start.y = child->IntAttribute("y1");
-
-            Point end;
-            end.x = child->IntAttribute("x2");
-            end.y = child->IntAttribute("y2");
+            FixedPoint start = FixedPoint::from_double(attributes.get_double(attr::x1), attributes.get_double(attr::y1));
+            FixedPoint end = FixedPoint::from_double(attributes.get_double(attr::x2), attributes.get_double(attr::y2));
 
-            Color color = parse_color(child->Attribute("stroke"));
-
-            // get transform_origin point
-            Point transform_origin = getTransformOrigin(child);
-            // dynamically allocate new line object
-            Line *elem = new Line(color, start, end, transform_origin);
-            // check and apply transforms
-            applyTransform(child, elem);
-            // check if child has an id and add to elements_with_id map
-            if (child->Attribute("id") != NULL)
-            {
-                elements_with_id[child->Attribute("id")] = elem;
-            }
-            // push line into svg_elements vector
-            svg_elements.push_back(elem);
+            Color color = parse_color(attributes.get(attr::stroke));
+            return new Line(color, start, end, transform_origin);
         }
 
-        // POLYLINE
-        if (std::string(child->Name()) == "polyline")
+        SVGElement *readPolyline(XMLElement *, const ElementAttributes &attributes,
+                                 const FixedPoint &transform_origin, ElementReader &)
         {
-
             // exemplo:
             // points="0,0 0,399 399,399, 399,199"
-            // fill="red"
-
-            std::string points_str = child->Attribute("points");
-
-            // substituir virgulas com espaços
-            for (char &c : points_str)
-            {
-                if (c == ',')
-                {
-                    c = ' ';
-                }
-            }
-            // separar valores e push_back para numbers
-            std::stringstream ss(points_str);
-            int num;
-            std::vector<int> numbers;
-            while (ss >> num)
-            {
-                numbers.push_back(num);
-            }
-
-            Color color = parse_color(child->Attribute("stroke"));
+            // stroke="red"
 
-            for (long unsigned int i = 0; i < numbers.size() - 3; i += 2)
-            {
-                Point start = {numbers[i], numbers[i + 1]};
-                Point end = {numbers[i + 2], numbers[i + 3]};
-
-                // get transform_origin point
-                Point transform_origin = getTransformOrigin(child);
-                // dynamically allocate new line obejct
-                Line *elem = new Line(color, start, end, transform_origin);
-                // check and apply transforms
-                applyTransform(child, elem);
-                // check if child has an id and add to elements_with_id map
-                if (child->Attribute("id") != NULL)
-                {
-                    elements_with_id[child->Attribute("id")] = elem;
-                }
-                // push line into svg_elements vector
-                svg_elements.push_back(elem);
-            }
+            std::vector<FixedPoint> points = getPoints(attributes);
+            Color color = parse_color(attributes.get(attr::stroke));
+            return new Polyline(points, color, transform_origin);
         }
 
-        // POLYGON
-        if (std::string(child->Name()) == "polygon")
+        SVGElement *readPolygon(XMLElement *xml, const ElementAttributes &attributes,
+                                const FixedPoint &transform_origin, ElementReader &reader)
         {
-
             // exemplo:
             // points="0,0 0,399 399,399, 399,199"
             // fill="red"
 
-            std::string points_str = child->Attribute("points");
-
-            // substituir virgulas com espaços
-            for (char &c : points_str)
+            std::vector<FixedPoint> points = getPoints(attributes);
+            // bounding box, for gradients
+            FixedPoint lo = {0, 0}, hi = {0, 0};
+            if (!points.empty())
             {
-                if (c == ',')
-                {
-                    c = ' ';
-                }
+                lo = hi = points[0];
             }
-
-            // separar valores e push_back para numbers
-            std::stringstream ss(points_str);
-            int num;
-            std::vector<int> numbers;
-            while (ss >> num)
+            for (const FixedPoint &p : points)
             {
-                numbers.push_back(num);
+                lo = {std::min(lo.x, p.x), std::min(lo.y, p.y)};
+                hi = {std::max(hi.x, p.x), std::max(hi.y, p.y)};
             }
-
-            vector<Point> points;
-            for (unsigned int i = 0; i < numbers.size() - 1; i += 2)
-            {
-                Point point = {numbers[i], numbers[i + 1]};
-                points.push_back(point);
-            }
-
-            Color color = parse_color(child->Attribute("fill"));
-
-            // get transform_origin point
-            Point transform_origin = getTransformOrigin(child);
-            // dynamically allocate new polygon
-            Polygon *elem = new Polygon(points, color, transform_origin);
-            // check and apply transforms
-            applyTransform(child, elem);
-            // check if child has an id and add to elements_with_id map
-            if (child->Attribute("id") != NULL)
-            {
-                elements_with_id[child->Attribute("id")] = elem;
-            }
-            // push polygon into svg_elements vector
-            svg_elements.push_back(elem);
+            Paint fill = getFill(xml, attributes.get(attr::fill), reader,
+                                 (double)lo.x / SUBPIXEL_ONE, (double)lo.y / SUBPIXEL_ONE,
+                                 (double)(hi.x - lo.x) / SUBPIXEL_ONE, (double)(hi.y - lo.y) / SUBPIXEL_ONE);
+            return new Polygon(points, fill, transform_origin);
         }
 
-        // RECT
-        if (std::string(child->Name()) == "rect")
+        SVGElement *readRect(XMLElement *xml, const ElementAttributes &attributes,
+                             const FixedPoint &transform_origin, ElementReader &reader)
         {
-
             // exemplo:
             // x="0"
             // y="0"
@@ -310,85 +221,114 @@ namespace svg
             // width="400"
             // height="600"
 
-            int x = child->IntAttribute("x"); // get x
-            int y = child->IntAttribute("y"); // get y
+            double x = attributes.get_double(attr::x); // get x
+            double y = attributes.get_double(attr::y); // get y
+
+            double width_rect = attributes.get_double(attr::width);   // get width
+            double height_rect = attributes.get_double(attr::height); // get height
+
+            vector<FixedPoint> points;
+            points.push_back(FixedPoint::from_double(x, y));                                    // top-left corner
+            points.push_back(FixedPoint::from_double(x + width_rect - 1, y));                   // top-right corner
+            points.push_back(FixedPoint::from_double(x + width_rect - 1, y + height_rect - 1)); // bottom-right corner
+            points.push_back(FixedPoint::from_double(x, y + height_rect - 1));                  // bottom-left corner
 
-            int width_rect = child->IntAttribute("width");   // get width
-            int height_rect = child->IntAttribute("height"); // get height
+            Paint fill = getFill(xml, attributes.get(attr::fill), reader, x, y, width_rect, height_rect);
+            return new Rect(points, fill, transform_origin);
+        }
 
-            vector<Point> points;
-            points.push_back({x, y});                                    // top-left corner
-            points.push_back({x + width_rect - 1, y});                   // top-right corner
-            points.push_back({x + width_rect - 1, y + height_rect - 1}); // bottom-right corner
-            points.push_back({x, y + height_rect - 1});                  // bottom-left corner
+        SVGElement *readPath(XMLElement *xml, const ElementAttributes &attributes,
+                             const FixedPoint &transform_origin, ElementReader &reader)
+        {
+            // exemplo:
+            // d="M 10 10 h 80 q 40 0 40 40 Z"
+            // fill="red"
+            // stroke="blue"
+            // fill-rule="evenodd"
 
-            Color color = parse_color(child->Attribute("fill")); // get color
+            std::shared_ptr<const PathGeometry> geometry = PathGeometry::parse(attributes.get(attr::d));
 
-            // get transform_origin point
-            Point transform_origin = getTransformOrigin(child);
-            // dynamically allocate new polygon
-            Polygon *elem = new Polygon(points, color, transform_origin);
-            // check and apply transforms
-            applyTransform(child, elem);
-            // check if child has an id and add to elements_with_id map
-            if (child->Attribute("id") != NULL)
+            // fill defaults to black, stroke defaults to none
+            const char *fill_str = attributes.get(attr::fill);
+            bool filled = fill_str == NULL || std::string(fill_str) != "none";
+            Paint fill;
+            if (fill_str != NULL && filled)
             {
-                elements_with_id[child->Attribute("id")] = elem;
+                // bounding box of the flattened path, for gradients
+                const std::vector<PathPoint> &points = geometry->flatten(1)->points;
+                PathPoint lo = {0, 0}, hi = {0, 0};
+                if (!points.empty())
+                {
+                    lo = hi = points[0];
+                }
+                for (const PathPoint &p : points)
+                {
+                    lo = {std::min(lo.x, p.x), std::min(lo.y, p.y)};
+                    hi = {std::max(hi.x, p.x), std::max(hi.y, p.y)};
+                }
+                fill = getFill(xml, fill_str, reader, lo.x, lo.y, hi.x - lo.x, hi.y - lo.y);
             }
-            // push polygon into svg_elements vector
-            svg_elements.push_back(elem);
+            const char *stroke_str = attributes.get(attr::stroke);
+            bool stroked = stroke_str != NULL && std::string(stroke_str) != "none";
+            Color stroke = stroked ? parse_color(stroke_str) : Color{0, 0, 0};
+            bool even_odd = attributes.equals(attr::fill_rule, "evenodd");
+            return new Path(geometry, fill, filled, stroke, stroked, even_odd, transform_origin);
         }
 
-        // GROUP
-        if (std::string(child->Name()) == "g")
+        SVGElement *readGroup(XMLElement *xml, const ElementAttributes &,
+                              const FixedPoint &transform_origin, ElementReader &reader)
         {
-
             std::vector<SVGElement *> elements;
-            for (XMLElement *group_child = child->FirstChildElement(); group_child != nullptr; group_child = group_child->NextSiblingElement())
+            try
             {
-                getElement(group_child, elements, elements_with_id);
+                reader.read_children(xml, elements);
             }
-
-            // get transform_origin point
-            Point transform_origin = getTransformOrigin(child);
-            // dynamically allocate new group
-            Group *elem = new Group(elements, transform_origin);
-            // check and apply transforms
-            applyTransform(child, elem);
-            // check if child has an id and add to elements_with_id map
-            if (child->Attribute("id") != NULL)
+            catch (...)
             {
-                elements_with_id[child->Attribute("id")] = elem;
+                for (SVGElement *e : elements)
+                {
+                    delete e;
+                }
+                throw;
             }
-            // push group into svg_elements vector
-            svg_elements.push_back(elem);
+            return new Group(elements, transform_origin);
         }
 
-        // USE
-        if (std::string(child->Name()) == "use")
+        SVGElement *readUse(XMLElement *, const ElementAttributes &attributes,
+                            const FixedPoint &transform_origin, ElementReader &reader)
         {
-            // get transform_origin point
-            Point transform_origin = getTransformOrigin(child);
-
             // get href
-            std::string href = child->Attribute("href");
-            href = href.erase(0, 1); // erase '#'
-
-            // copy corresponding element
-            auto elem = elements_with_id.at(href)->clone(transform_origin);
-
-            // check and apply transforms
-            applyTransform(child, elem);
-            // check if child has an id and add to elements_with_id map
-            if (child->Attribute("id") != NULL)
+            const char *href = attributes.get(attr::href);
+            if (href == NULL || href[0] != '#')
             {
-                elements_with_id[child->Attribute("id")] = elem;
+                throw runtime_error("use element without a #id reference");
             }
-            // push polygon into svg_elements vector
-            svg_elements.push_back(elem);
+            // copy corresponding element, counting the copy before it is made
+            const SVGElement *source = reader.element_with_id(href + 1);
+            reader.guard().add_use_copy(*source);
+            return source->clone(transform_origin);
         }
     }
 
+    ElementRegistry &ElementRegistry::standard()
+    {
+        static ElementRegistry *registry = []
+        {
+            ElementRegistry *r = new ElementRegistry();
+            r->add("ellipse", readEllipse);
+            r->add("circle", readCircle);
+            r->add("line", readLine);
+            r->add("polyline", readPolyline);
+            r->add("polygon", readPolygon);
+            r->add("rect", readRect);
+            r->add("path", readPath);
+            r->add("g", readGroup);
+            r->add("use", readUse);
+            return r;
+        }();
+        return *registry;
+    }
+
     void readSVG(const string &svg_file, Point &dimensions, vector<SVGElement *> &svg_elements)
     {
         XMLDocument doc;
@@ -397,19 +337,67 @@ namespace svg
         {
             throw runtime_error("Unable to load " + svg_file);
         }
+        readSVG(doc, dimensions, svg_elements);
+    }
+
+    void readSVG(XMLDocument &doc, Point &dimensions, vector<SVGElement *> &svg_elements, RenderStats *stats,
+                 LimitGuard *guard, const ConvertOptions *options)
+    {
         XMLElement *xml_elem = doc.RootElement();
+        if (xml_elem == nullptr)
+        {
+            throw runtime_error("SVG document has no root element");
+        }
 
-        // get image dimensions
-        dimensions.x = xml_elem->IntAttribute("width");
-        dimensions.y = xml_elem->IntAttribute("height");
+        // get image dimensions, which default to the viewBox size
+        double view_box[4];
+        bool has_view_box = getViewBox(xml_elem, view_box);
+        double width = xml_elem->DoubleAttribute("width", has_view_box ? view_box[2] : 0);
+        double height = xml_elem->DoubleAttribute("height", has_view_box ? view_box[3] : 0);
+        if (!(::fabs(width) <= INT_MAX && ::fabs(height) <= INT_MAX))
+        {
+            throw LimitExceeded(LimitCode::CanvasPixels, "Document size over the largest pixel coordinate");
+        }
+        dimensions.x = (int)::lround(width);
+        dimensions.y = (int)::lround(height);
+        if (options != nullptr)
+        {
+            // reject the canvas before reading what would be drawn on it
+            check_output_canvas(dimensions, *options);
+        }
 
-        // create map of ids and elements that have ids
-        std::map<std::string, SVGElement *> elements_with_id;
+        // read all child elements
+        LimitGuard unlimited((ResourceLimits()));
+        ElementReader reader(ElementRegistry::standard(), stats, guard != nullptr ? *guard : unlimited);
+        const size_t first = svg_elements.size();
+        try
+        {
+            reader.read_children(xml_elem, svg_elements);
+        }
+        catch (...)
+        {
+            for (size_t i = first; i < svg_elements.size(); i++)
+            {
+                delete svg_elements[i];
+            }
+            svg_elements.resize(first);
+            throw;
+        }
 
-        // loop over all child elements
-        for (XMLElement *child = xml_elem->FirstChildElement(); child != nullptr; child = child->NextSiblingElement())
+        // map the viewBox onto the image, scaled uniformly and centered
+        // (preserveAspectRatio="xMidYMid meet")
+        if (has_view_box)
         {
-            getElement(child, svg_elements, elements_with_id);
+            double scale = std::min(width / view_box[2], height / view_box[3]);
+            double dx = (width - view_box[2] * scale) / 2 - view_box[0] * scale;
+            double dy = (height - view_box[3] * scale) / 2 - view_box[1] * scale;
+            if (scale != 1 || dx != 0 || dy != 0)
+            {
+                for (SVGElement *elem : svg_elements)
+                {
+                    elem->fit(scale, dx, dy);
+                }
+            }
         }
     }
 }
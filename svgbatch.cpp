@@ -0,0 +1,79 @@
+#include "Pipeline.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+void usage()
+{
+    std::cout << "Usage: svgbatch [options] out_dir in_file.svg..." << std::endl
+              << "  --readers N       threads reading SVG files (default 1)" << std::endl
+              << "  --parsers N       threads parsing documents (default 1)" << std::endl
+              << "  --rasterizers N   threads drawing images (default 1)" << std::endl
+              << "  --encoders N      threads encoding PNG data (default 1)" << std::endl
+              << "  --writers N       threads writing PNG files (default 1)" << std::endl
+              << "  --queue N         capacity of each queue between stages (default 4)" << std::endl
+              << "  --width W, --height H, --scale S   output size, as for svgtopng" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    svg::PipelineOptions options;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0)
+        {
+            args.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            usage();
+            return 1;
+        }
+        const char *value = argv[++i];
+        if (arg == "--readers")
+            options.readers = std::atoi(value);
+        else if (arg == "--parsers")
+            options.parsers = std::atoi(value);
+        else if (arg == "--rasterizers")
+            options.rasterizers = std::atoi(value);
+        else if (arg == "--encoders")
+            options.encoders = std::atoi(value);
+        else if (arg == "--writers")
+            options.writers = std::atoi(value);
+        else if (arg == "--queue")
+            options.queue_capacity = std::strtoul(value, nullptr, 10);
+        else if (arg == "--width")
+            options.convert.width = std::atoi(value);
+        else if (arg == "--height")
+            options.convert.height = std::atoi(value);
+        else if (arg == "--scale")
+            options.convert.scale = std::atof(value);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (args.size() < 2)
+    {
+        usage();
+        return 1;
+    }
+
+    std::vector<std::pair<std::string, std::string>> files;
+    for (size_t i = 1; i < args.size(); i++)
+    {
+        std::string name = args[i].substr(args[i].find_last_of('/') + 1);
+        name = name.substr(0, name.find_last_of('.'));
+        files.push_back({args[i], args[0] + "/" + name + ".png"});
+    }
+    svg::PipelineReport report = svg::convert_batch(files, options);
+    report.print(std::cout);
+    return report.errors.empty() ? 0 : 1;
+}
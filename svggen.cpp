@@ -0,0 +1,90 @@
+#include "SceneGenerator.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+void usage()
+{
+    std::cout << "Usage: svggen [options] [-o out_file.svg]" << std::endl
+              << "  --seed S              random seed (default 1)" << std::endl
+              << "  --width W --height H  canvas size (default 1000x1000)" << std::endl
+              << "  --polygons N          number of polygons" << std::endl
+              << "  --vertices V          vertices per polygon (default 3)" << std::endl
+              << "  --polygon-size P      maximum polygon size in pixels (default 60)" << std::endl
+              << "  --depth D             nest the polygons in D groups" << std::endl
+              << "  --uses K              use elements referencing random polygons" << std::endl
+              << "  --polylines P         number of polylines" << std::endl
+              << "  --polyline-length L   points per polyline" << std::endl
+              << "  --circles C           number of circles" << std::endl
+              << "  --paths P             number of curved paths" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    svg::SceneParams params;
+    std::string out_file;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            usage();
+            return 1;
+        }
+        const char *value = argv[++i];
+        if (arg == "-o")
+            out_file = value;
+        else if (arg == "--seed")
+            params.seed = std::strtoull(value, nullptr, 10);
+        else if (arg == "--width")
+            params.width = std::atoi(value);
+        else if (arg == "--height")
+            params.height = std::atoi(value);
+        else if (arg == "--polygons")
+            params.polygons = std::atoi(value);
+        else if (arg == "--vertices")
+            params.vertices = std::atoi(value);
+        else if (arg == "--polygon-size")
+            params.polygon_size = std::atoi(value);
+        else if (arg == "--depth")
+            params.depth = std::atoi(value);
+        else if (arg == "--uses")
+            params.uses = std::atoi(value);
+        else if (arg == "--polylines")
+            params.polylines = std::atoi(value);
+        else if (arg == "--polyline-length")
+            params.polyline_length = std::atoi(value);
+        else if (arg == "--circles")
+            params.circles = std::atoi(value);
+        else if (arg == "--paths")
+            params.paths = std::atoi(value);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (params.width < 4 || params.height < 4)
+    {
+        std::cerr << "svggen: canvas must be at least 4x4" << std::endl;
+        return 1;
+    }
+    if (out_file.empty())
+    {
+        svg::generate_scene(params, std::cout);
+    }
+    else
+    {
+        std::ofstream out(out_file);
+        if (!out)
+        {
+            std::cerr << "svggen: unable to write " << out_file << std::endl;
+            return 1;
+        }
+        svg::generate_scene(params, out);
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include "Tiles.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+void usage()
+{
+    std::cout << "Usage: svgtiles [options] in_file.svg out_dir" << std::endl
+              << "Writes XYZ tiles as out_dir/z/x/y.png." << std::endl
+              << "  --tile-size N     tile width and height (default 256)" << std::endl
+              << "  --min-zoom Z      lowest zoom level (default 0, one tile)" << std::endl
+              << "  --max-zoom Z      highest zoom level (default 3)" << std::endl
+              << "  --threads N       threads drawing tiles (default 1)" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    svg::TilePyramidOptions options;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0)
+        {
+            args.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            usage();
+            return 1;
+        }
+        const char *value = argv[++i];
+        if (arg == "--tile-size")
+            options.tile_size = std::atoi(value);
+        else if (arg == "--min-zoom")
+            options.min_zoom = std::atoi(value);
+        else if (arg == "--max-zoom")
+            options.max_zoom = std::atoi(value);
+        else if (arg == "--threads")
+            options.threads = std::atoi(value);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (args.size() != 2)
+    {
+        usage();
+        return 1;
+    }
+
+    try
+    {
+        svg::TilePyramidReport report = svg::render_pyramid(args[0], args[1], options);
+        report.print(std::cout);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "svgtiles: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
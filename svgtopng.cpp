@@ -1,17 +1,177 @@
 #include "SVGElements.hpp"
+#include "Stats.hpp"
+#include "Trace.hpp"
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <string>
 
 int main(int argc, char **argv)
 {
-    if (argc != 3)
+    bool print_stats = false;
+    std::string stats_json_file;
+    std::string trace_file;
+    std::string overdraw_file;
+    int strip_height = 0;
+    svg::ConvertOptions options;
+    std::string files[2];
+    int n_files = 0;
+    bool usage_error = false;
+    for (int i = 1; i < argc; i++)
     {
-        std::cout << "Usage: svgtopng in_file.svg out_file.png" << std::endl;
+        std::string arg = argv[i];
+        if (arg == "--stats")
+        {
+            print_stats = true;
+        }
+        else if (arg == "--stats-json" && i + 1 < argc)
+        {
+            stats_json_file = argv[++i];
+        }
+        else if (arg == "--trace" && i + 1 < argc)
+        {
+            trace_file = argv[++i];
+        }
+        else if (arg == "--overdraw" && i + 1 < argc)
+        {
+            overdraw_file = argv[++i];
+        }
+        else if (arg == "--width" && i + 1 < argc)
+        {
+            options.width = std::atoi(argv[++i]);
+        }
+        else if (arg == "--height" && i + 1 < argc)
+        {
+            options.height = std::atoi(argv[++i]);
+        }
+        else if (arg == "--scale" && i + 1 < argc)
+        {
+            options.scale = std::atof(argv[++i]);
+        }
+        else if (arg == "--strip-height" && i + 1 < argc)
+        {
+            strip_height = std::atoi(argv[++i]);
+        }
+        else if (arg == "--untrusted")
+        {
+            options.limits = svg::ResourceLimits::untrusted();
+        }
+        else if (arg == "--max-pixels" && i + 1 < argc)
+        {
+            options.limits.max_canvas_pixels = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--max-elements" && i + 1 < argc)
+        {
+            options.limits.max_elements = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--max-vertices" && i + 1 < argc)
+        {
+            options.limits.max_vertices = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--max-depth" && i + 1 < argc)
+        {
+            options.limits.max_depth = std::atoi(argv[++i]);
+        }
+        else if (arg == "--max-uses" && i + 1 < argc)
+        {
+            options.limits.max_use_expansions = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--timeout-ms" && i + 1 < argc)
+        {
+            options.limits.max_wall_ms = std::atof(argv[++i]);
+        }
+        else if (arg.compare(0, 2, "--") != 0 && n_files < 2)
+        {
+            files[n_files++] = arg;
+        }
+        else
+        {
+            usage_error = true;
+        }
+    }
+    if (usage_error || n_files != 2)
+    {
+        std::cout << "Usage: svgtopng [options] in_file.svg out_file.png" << std::endl
+                  << "  --width W, --height H   output size (the other follows the aspect ratio)" << std::endl
+                  << "  --scale S               extra output scale factor" << std::endl
+                  << "  --strip-height N        draw and write N rows at a time" << std::endl
+                  << "  --stats                 print conversion statistics" << std::endl
+                  << "  --stats-json FILE       write statistics as JSON ('-' for stdout, with" << std::endl
+                  << "                          other output moved to stderr)" << std::endl
+                  << "  --trace FILE            write a Chrome trace of phases and draws" << std::endl
+                  << "  --overdraw FILE         save an overdraw heatmap and print a summary" << std::endl
+                  << "  --untrusted             limits for untrusted input (later limits override)" << std::endl
+                  << "  --max-pixels N          largest output canvas, in pixels" << std::endl
+                  << "  --max-elements N        most elements, counting use copies" << std::endl
+                  << "  --max-vertices N        most vertices" << std::endl
+                  << "  --max-depth N           deepest group nesting" << std::endl
+                  << "  --max-uses N            most elements copied by use" << std::endl
+                  << "  --timeout-ms N          longest time spent reading the document" << std::endl
+                  << "A document over a limit exits with status 10 plus the limit code" << std::endl
+                  << "(11 pixels, 12 elements, 13 vertices, 14 depth, 15 uses, 16 time," << std::endl
+                  << "17 no width or height). Other errors exit with status 2." << std::endl;
+        return 1;
     }
     else
     {
-        std::cout << "Performing conversion ... " << argv[1] << " --> " << argv[2] << std::endl;
-        svg::convert(argv[1], argv[2]);
-        std::cout << "Done!" << std::endl;
+        svg::RenderStats stats;
+        svg::Tracer tracer;
+        svg::OverdrawStats overdraw;
+        if (print_stats || !stats_json_file.empty())
+        {
+            options.stats = &stats;
+        }
+        if (!trace_file.empty())
+        {
+            options.trace = &tracer;
+        }
+        options.strip_height = strip_height;
+        if (!overdraw_file.empty())
+        {
+            options.overdraw = &overdraw;
+            options.overdraw_heatmap = overdraw_file;
+        }
+        // with the JSON on stdout, everything else goes to stderr so
+        // that stdout parses as JSON
+        std::ostream &report = stats_json_file == "-" ? std::cerr : std::cout;
+        report << "Performing conversion ... " << files[0] << " --> " << files[1] << std::endl;
+        try
+        {
+            svg::convert(files[0], files[1], options);
+        }
+        catch (const svg::LimitExceeded &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 10 + (int)e.code();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 2;
+        }
+        report << "Done!" << std::endl;
+        if (print_stats)
+        {
+            stats.print(report);
+        }
+        if (!overdraw_file.empty())
+        {
+            overdraw.print(report);
+        }
+        if (stats_json_file == "-")
+        {
+            stats.write_json(std::cout);
+        }
+        else if (!stats_json_file.empty())
+        {
+            std::ofstream out(stats_json_file);
+            stats.write_json(out);
+        }
+        if (!trace_file.empty())
+        {
+            std::ofstream out(trace_file);
+            tracer.write_json(out);
+        }
     }
     return 0;
-}
\ No newline at end of file
+}
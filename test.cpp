@@ -1,6 +1,9 @@
 
 // Project file headers
 #include "SVGElements.hpp"
+#include "SpatialIndex.hpp"
+#include "Stats.hpp"
+#include "Tiles.hpp"
 
 // C++ library headers
 #include <algorithm>
@@ -12,6 +15,12 @@
 #include <vector>
 #include <iterator>
 #include <fstream>
+#include <functional>
+#include <utility>
+#include <atomic>
+#include <thread>
+#include <random>
+#include <cmath>
 using namespace std;
 
 // POSIX headers
@@ -24,22 +33,14 @@ namespace svg
 {
     const string LOG_FILE_NAME = "test_log.txt";
 
-    class TestDriver
+    // Checks of behavior that a single expected image cannot show. Each
+    // returns true on success and explains failures on stdout.
+    namespace
     {
-    private:
-        string root_path;
-        int total_tests = 0;
-        int passed_tests = 0;
-        int failed_tests = 0;
-        FILE *log_stream;
-
-        bool run_conversion_test(const string &id)
+        //! Compares two images pixel by pixel.
+        //! @return True if they have the same size and pixels.
+        bool same_image(const PNGImage &img1, const PNGImage &img2)
         {
-            string svg_file = root_path + "/input/" + id + ".svg";
-            string exp_file = root_path + "/expected/" + id + ".png";
-            string out_file = root_path + "/output/" + id + ".png";
-            convert(svg_file, out_file);
-            PNGImage img1(exp_file), img2(out_file);
             int w1 = img1.width(), h1 = img1.height(),
                 w2 = img2.width(), h2 = img2.height();
             if (w1 != w2 || h1 != h2)
@@ -67,6 +68,957 @@ namespace svg
             return true;
         }
 
+        //! Compares two PNG files pixel by pixel.
+        //! @return True if they have the same size and pixels.
+        bool same_pixels(const string &exp_file, const string &out_file)
+        {
+            return same_image(PNGImage(exp_file), PNGImage(out_file));
+        }
+
+        //! Lists the conversion tests.
+        //! @return Names of the input documents, without extension, sorted.
+        vector<string> input_ids(const string &root_path)
+        {
+            vector<string> ids;
+            ::DIR *directory = ::opendir((root_path + "/input").c_str());
+            if (directory == nullptr)
+            {
+                return ids;
+            }
+            ::dirent *entry;
+            while ((entry = readdir(directory)) != nullptr)
+            {
+                if (entry->d_type == DT_REG)
+                {
+                    string fname = entry->d_name;
+                    ids.push_back(fname.substr(0, fname.find_last_of('.')));
+                }
+            }
+            ::closedir(directory);
+            sort(ids.begin(), ids.end());
+            return ids;
+        }
+
+        //! Writes a document to the output directory.
+        //! @return Its file name.
+        string write_svg(const string &root_path, const string &id, const string &svg)
+        {
+            string svg_file = root_path + "/output/" + id + ".svg";
+            ofstream(svg_file) << svg;
+            return svg_file;
+        }
+
+        //! Document whose shapes reach far past pixel coordinates: bands
+        //! across the canvas, a sliver with one distant corner and a stroke
+        //! through it.
+        const char *const OFF_CANVAS_SVG =
+            "<svg width=\"100\" height=\"100\" xmlns=\"http://www.w3.org/2000/svg\">"
+            "<path d=\"M -1e12 10 L 1e12 10 L 1e12 60 L -1e12 60 Z\" fill=\"red\"/>"
+            "<path d=\"M 20 -1e12 L 40 -1e12 L 40 1e12 L 20 1e12 Z\" fill=\"blue\"/>"
+            "<path d=\"M 70 70 L 1e15 80 L 70 90 Z\" fill=\"green\"/>"
+            "<path d=\"M -1e12 -1e12 L 1e12 1e12\" stroke=\"black\"/>"
+            "</svg>";
+
+        //! Converts a document that must go over a limit.
+        //! @param code The limit it must report.
+        bool expect_limit(const string &root_path, const string &id, const string &svg,
+                          const ConvertOptions &options, LimitCode code)
+        {
+            string svg_file = write_svg(root_path, id, svg);
+            try
+            {
+                convert(svg_file, root_path + "/output/" + id + ".png", options);
+            }
+            catch (const LimitExceeded &e)
+            {
+                if (e.code() == code)
+                {
+                    return true;
+                }
+                cout << "expected " << limit_name(code) << ", got " << limit_name(e.code())
+                     << ": " << e.what() << endl;
+                return false;
+            }
+            cout << "expected " << limit_name(code) << ", but the conversion succeeded" << endl;
+            return false;
+        }
+
+        bool check_limit_depth(const string &root_path)
+        {
+            string svg = "<svg width=\"10\" height=\"10\">";
+            for (int i = 0; i < 5; i++)
+            {
+                svg += "<g>";
+            }
+            svg += "<rect x=\"0\" y=\"0\" width=\"5\" height=\"5\" fill=\"red\"/>";
+            for (int i = 0; i < 5; i++)
+            {
+                svg += "</g>";
+            }
+            svg += "</svg>";
+            ConvertOptions options;
+            options.limits.max_depth = 5;
+            // five groups put the rect at depth 6
+            return expect_limit(root_path, "check_limit_depth", svg, options, LimitCode::Depth);
+        }
+
+        bool check_limit_uses(const string &root_path)
+        {
+            // each use of the group copies the group and its two members
+            const string svg =
+                "<svg width=\"10\" height=\"10\">"
+                "<g id=\"pair\"><circle cx=\"2\" cy=\"2\" r=\"1\" fill=\"red\"/>"
+                "<circle cx=\"6\" cy=\"6\" r=\"1\" fill=\"blue\"/></g>"
+                "<use href=\"#pair\"/><use href=\"#pair\"/><use href=\"#pair\"/></svg>";
+            ConvertOptions options;
+            options.limits.max_use_expansions = 8;
+            return expect_limit(root_path, "check_limit_uses", svg, options, LimitCode::UseExpansions);
+        }
+
+        bool check_limit_canvas(const string &root_path)
+        {
+            const string svg = "<svg width=\"200\" height=\"100\"/>";
+            ConvertOptions options;
+            options.limits.max_canvas_pixels = 19999;
+            if (!expect_limit(root_path, "check_limit_canvas", svg, options, LimitCode::CanvasPixels))
+            {
+                return false;
+            }
+            // the limit applies to the output size, not the document's
+            options.width = 100;
+            convert(write_svg(root_path, "check_limit_canvas", svg), root_path + "/output/check_limit_canvas.png",
+                    options);
+            options.width = 0;
+            options.scale = 2;
+            options.limits.max_canvas_pixels = 79999;
+            return expect_limit(root_path, "check_limit_canvas", svg, options, LimitCode::CanvasPixels);
+        }
+
+        bool check_limit_vertices(const string &root_path)
+        {
+            const string svg =
+                "<svg width=\"10\" height=\"10\">"
+                "<polygon points=\"0,0 9,0 9,9\" fill=\"red\"/>"
+                "<polyline points=\"0,0 1,1 2,2 3,3\" stroke=\"blue\"/></svg>";
+            ConvertOptions options;
+            options.limits.max_vertices = 6;
+            return expect_limit(root_path, "check_limit_vertices", svg, options, LimitCode::Vertices);
+        }
+
+        bool check_limit_elements(const string &root_path)
+        {
+            const string svg =
+                "<svg width=\"10\" height=\"10\"><g>"
+                "<circle cx=\"2\" cy=\"2\" r=\"1\" fill=\"red\"/>"
+                "<circle cx=\"6\" cy=\"6\" r=\"1\" fill=\"blue\"/></g></svg>";
+            ConvertOptions options;
+            options.limits.max_elements = 2;
+            return expect_limit(root_path, "check_limit_elements", svg, options, LimitCode::Elements);
+        }
+
+        bool check_limit_empty_canvas(const string &root_path)
+        {
+            // rejected whatever the limits, even when the output size is set
+            const char *documents[] = {
+                "<svg width=\"-5\" height=\"10\"><rect x=\"0\" y=\"0\" width=\"5\" height=\"5\" fill=\"red\"/></svg>",
+                "<svg width=\"0\" height=\"10\"/>",
+                "<svg width=\"10\" height=\"0\"/>",
+                "<svg/>"};
+            for (const char *svg : documents)
+            {
+                ConvertOptions options;
+                if (!expect_limit(root_path, "check_limit_empty_canvas", svg, options, LimitCode::EmptyCanvas))
+                {
+                    return false;
+                }
+                options.width = 100;
+                options.limits = ResourceLimits::untrusted();
+                if (!expect_limit(root_path, "check_limit_empty_canvas", svg, options, LimitCode::EmptyCanvas))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool check_strips(const string &root_path)
+        {
+            // strip rendering gives the expected image at any strip height
+            for (const string &id : input_ids(root_path))
+            {
+                const string exp_file = root_path + "/expected/" + id + ".png";
+                const int heights[] = {1, 7, PNGImage(exp_file).height()};
+                for (int height : heights)
+                {
+                    ConvertOptions options;
+                    options.strip_height = height;
+                    const string out_file = root_path + "/output/check_strips.png";
+                    convert(root_path + "/input/" + id + ".svg", out_file, options);
+                    if (!same_pixels(exp_file, out_file))
+                    {
+                        cout << id << " drawn in strips of " << height << " rows" << endl;
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        bool check_tiles(const string &root_path)
+        {
+            // each tile holds its part of the full render at the level's
+            // scale, white past the drawing, including shapes far outside
+            // pixel coordinates
+            vector<string> files;
+            for (const string &id : input_ids(root_path))
+            {
+                files.push_back(root_path + "/input/" + id + ".svg");
+            }
+            files.push_back(write_svg(root_path, "check_tiles", OFF_CANVAS_SVG));
+            TilePyramidOptions options;
+            options.tile_size = 64;
+            options.min_zoom = 0;
+            options.max_zoom = 1;
+            options.threads = 2;
+            const string out_dir = root_path + "/output/check_tiles";
+            for (const string &file : files)
+            {
+                render_pyramid(file, out_dir, options);
+                const Point size = Scene(file).dimensions();
+                for (int z = options.min_zoom; z <= options.max_zoom; z++)
+                {
+                    ConvertOptions whole_options;
+                    whole_options.scale = ldexp((double)options.tile_size / max(size.x, size.y), z);
+                    const string whole_file = root_path + "/output/check_tiles.png";
+                    convert(file, whole_file, whole_options);
+                    const PNGImage whole(whole_file);
+                    const int columns = (whole.width() + options.tile_size - 1) / options.tile_size;
+                    const int rows = (whole.height() + options.tile_size - 1) / options.tile_size;
+                    for (int tx = 0; tx < columns; tx++)
+                    {
+                        for (int ty = 0; ty < rows; ty++)
+                        {
+                            const string tile_file = out_dir + "/" + to_string(z) + "/" + to_string(tx) + "/" +
+                                                     to_string(ty) + ".png";
+                            const PNGImage tile(tile_file);
+                            for (int y = 0; y < tile.height(); y++)
+                            {
+                                for (int x = 0; x < tile.width(); x++)
+                                {
+                                    const int wx = tx * options.tile_size + x, wy = ty * options.tile_size + y;
+                                    const Color expected = wx < whole.width() && wy < whole.height()
+                                                               ? whole.at(wx, wy)
+                                                               : Color{255, 255, 255};
+                                    const Color got = tile.at(x, y);
+                                    if (expected.red != got.red || expected.green != got.green ||
+                                        expected.blue != got.blue)
+                                    {
+                                        cout << file << ": tile " << tile_file << " differs at " << x << ' ' << y
+                                             << endl;
+                                        return false;
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+
+        bool check_subpixel_kernels(const string &)
+        {
+            // fixed seed, so that failures reproduce
+            minstd_rand rng(49);
+            auto coord = [&](int range)
+            { return (int)(rng() % (2 * range)) - range / 2; };
+            const Color red = {255, 0, 0}, blue = {0, 0, 255}, black = {0, 0, 0};
+            // whole-pixel geometry draws exactly as the integer kernels
+            for (int i = 0; i < 500; i++)
+            {
+                const Point a = {coord(64), coord(64)}, b = {coord(64), coord(64)};
+                const Point r = {(int)(rng() % 40), (int)(rng() % 40)};
+                const int orientation = (int)(rng() % 360);
+                PNGImage expected(64, 64), got(64, 64);
+                expected.draw_line(a, b, red);
+                expected.draw_ellipse(b, r, blue, orientation);
+                got.draw_line(FixedPoint::from_pixels(a), FixedPoint::from_pixels(b), red);
+                got.draw_ellipse(FixedPoint::from_pixels(b), FixedPoint::from_pixels(r), blue, orientation);
+                if (!same_image(expected, got))
+                {
+                    cout << "whole-pixel shape " << i << endl;
+                    return false;
+                }
+            }
+            // fractional lines have one pixel per column (or row, if steep),
+            // within half a pixel of the line or on an endpoint's pixel
+            for (int i = 0; i < 500; i++)
+            {
+                const FixedPoint a = {coord(64 * SUBPIXEL_ONE), coord(64 * SUBPIXEL_ONE)};
+                const FixedPoint b = {coord(64 * SUBPIXEL_ONE), coord(64 * SUBPIXEL_ONE)};
+                PNGImage img(64, 64);
+                img.draw_line(a, b, black);
+                const bool steep = abs(b.y - a.y) > abs(b.x - a.x);
+                const double m0 = steep ? a.y : a.x, n0 = steep ? a.x : a.y;
+                const double dm = (steep ? b.y : b.x) - m0, dn = (steep ? b.x : b.y) - n0;
+                const int first_m = steep ? min(a.round().y, b.round().y) : min(a.round().x, b.round().x);
+                const int last_m = steep ? max(a.round().y, b.round().y) : max(a.round().x, b.round().x);
+                const int ends[] = {steep ? a.round().x : a.round().y, steep ? b.round().x : b.round().y};
+                for (int m = 0; m < 64; m++)
+                {
+                    int count = 0;
+                    for (int n = 0; n < 64; n++)
+                    {
+                        const Color c = steep ? img.at(n, m) : img.at(m, n);
+                        if (c.red != 0 || c.green != 0 || c.blue != 0)
+                        {
+                            continue;
+                        }
+                        count++;
+                        const double exact = dm == 0 ? n0 : n0 + (m * SUBPIXEL_ONE - m0) * dn / dm;
+                        if (fabs(n * SUBPIXEL_ONE - exact) > SUBPIXEL_ONE / 2 + 1e-6 && n != ends[0] && n != ends[1])
+                        {
+                            cout << "line " << i << " is off at " << m << ' ' << n << endl;
+                            return false;
+                        }
+                    }
+                    const bool inside = m >= first_m && m <= last_m;
+                    const int n_first = min(ends[0], ends[1]), n_last = max(ends[0], ends[1]);
+                    if (count > 1 || (!inside && count != 0) || (inside && n_first >= 0 && n_last < 64 && count != 1))
+                    {
+                        cout << "line " << i << " has " << count << " pixels at " << m << endl;
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        //! Draws a shape with a kernel and with its reference on two images
+        //! of the same size, placed at the same random offset.
+        //! @param same_writes Whether the write counts must match too.
+        //! @return True if the pixels (and write counts) match.
+        bool matches_reference(minstd_rand &rng, int w, int h,
+                               const function<void(PNGImage &)> &kernel,
+                               const function<void(PNGImage &)> &reference,
+                               bool same_writes = true)
+        {
+            const int left = (int)(rng() % 33) - 16, top = (int)(rng() % 33) - 16;
+            PNGImage expected(w, h), got(w, h);
+            expected.set_left(left);
+            expected.set_top(top);
+            got.set_left(left);
+            got.set_top(top);
+            reference(expected);
+            kernel(got);
+            if (same_writes && expected.pixels_written() != got.pixels_written())
+            {
+                cout << "wrote " << got.pixels_written() << " pixels instead of "
+                     << expected.pixels_written() << endl;
+                return false;
+            }
+            return same_image(expected, got);
+        }
+
+        bool check_convex_polygons(const string &)
+        {
+            // outlines that are not strictly convex are rejected
+            const vector<Point> pentagram = {{50, 0}, {79, 90}, {2, 35}, {98, 35}, {21, 90}};
+            const vector<Point> collinear = {{0, 0}, {10, 0}, {20, 0}, {10, 10}};
+            const vector<Point> repeated = {{0, 0}, {10, 0}, {10, 0}, {10, 10}};
+            if (PNGImage::is_convex(pentagram) || PNGImage::is_convex(collinear) || PNGImage::is_convex(repeated))
+            {
+                cout << "a polygon that is not strictly convex was accepted" << endl;
+                return false;
+            }
+            // random convex polygons fill as draw_polygon does, in pixels and
+            // in write counts, with the image placed anywhere
+            minstd_rand rng(41);
+            const Color red = {255, 0, 0};
+            int drawn = 0;
+            for (int i = 0; i < 3000; i++)
+            {
+                const int n = 3 + (int)(rng() % 6);
+                const double cx = (int)(rng() % 104) - 20, cy = (int)(rng() % 104) - 20;
+                const double r = 1 + (int)(rng() % 60);
+                vector<double> angles;
+                for (int k = 0; k < n; k++)
+                {
+                    angles.push_back((rng() % 3600) * M_PI / 1800);
+                }
+                sort(angles.begin(), angles.end());
+                if (rng() % 2 == 0)
+                {
+                    reverse(angles.begin(), angles.end());
+                }
+                vector<Point> points;
+                for (double a : angles)
+                {
+                    points.push_back({(int)lround(cx + r * cos(a)), (int)lround(cy + r * sin(a))});
+                }
+                if (!PNGImage::is_convex(points))
+                {
+                    continue;
+                }
+                drawn++;
+                const auto kernel = [&](PNGImage &img)
+                { img.draw_convex_polygon(points, red); };
+                const auto reference = [&](PNGImage &img)
+                { img.draw_polygon(points, red); };
+                if (!matches_reference(rng, 64, 64, kernel, reference))
+                {
+                    cout << "convex polygon " << i << " differs" << endl;
+                    return false;
+                }
+            }
+            if (drawn < 1000)
+            {
+                cout << "only " << drawn << " random polygons were convex" << endl;
+                return false;
+            }
+            return true;
+        }
+
+        bool check_ellipse_counts(const string &root_path)
+        {
+            // ellipses drawn by another thread meanwhile are not counted
+            const string svg =
+                "<svg width=\"100\" height=\"100\">"
+                "<ellipse cx=\"20\" cy=\"20\" rx=\"9\" ry=\"5\" fill=\"red\"/>"
+                "<ellipse cx=\"50\" cy=\"50\" rx=\"9\" ry=\"5\" fill=\"blue\"/>"
+                "<circle cx=\"70\" cy=\"70\" r=\"6\" fill=\"green\"/>"
+                "</svg>";
+            const string svg_file = write_svg(root_path, "check_ellipse_counts", svg);
+            atomic<bool> done(false);
+            thread other([&]
+                         {
+                             PNGImage img(64, 64);
+                             for (int r = 1; !done; r = r % 30 + 1)
+                             {
+                                 img.draw_ellipse(Point{32, 32}, Point{r, r + 1}, {0, 0, 0});
+                             } });
+            bool ok = true;
+            for (int strip_height : {0, 7})
+            {
+                RenderStats stats;
+                ConvertOptions options;
+                options.stats = &stats;
+                options.strip_height = strip_height;
+                convert(svg_file, root_path + "/output/check_ellipse_counts.png", options);
+                // one lookup per ellipse, or per ellipse and band it crosses
+                const unsigned long long lookups = stats.ellipse_profile_hits + stats.ellipse_profile_misses;
+                const unsigned long long expected = strip_height == 0 ? 3 : 6;
+                if (lookups != expected)
+                {
+                    cout << lookups << " ellipse lookups in strips of " << strip_height
+                         << ", expected " << expected << endl;
+                    ok = false;
+                }
+            }
+            done = true;
+            other.join();
+            return ok;
+        }
+
+        bool check_line_kernels(const string &)
+        {
+            // the span, run and clipped sloped kernels draw and count the
+            // pixels of the plotted loop, which overdraw tracking forces
+            minstd_rand rng(44);
+            const Color green = {0, 128, 0};
+            for (int i = 0; i < 4000; i++)
+            {
+                // every 100th line reaches far outside the image
+                const int range = i % 100 == 0 ? 200000 : 120;
+                const Point a = {(int)(rng() % (2 * range)) - range + 25, (int)(rng() % (2 * range)) - range + 20};
+                Point b = {(int)(rng() % (2 * range)) - range + 25, (int)(rng() % (2 * range)) - range + 20};
+                const int d = b.x - a.x;
+                switch (rng() % 6)
+                {
+                case 0:
+                    b.y = a.y;
+                    break;
+                case 1:
+                    b.x = a.x;
+                    break;
+                case 2:
+                    b.y = a.y + d;
+                    break;
+                case 3:
+                    b.y = a.y - d;
+                    break;
+                default:
+                    break;
+                }
+                const auto kernel = [&](PNGImage &img)
+                { img.draw_line(a, b, green); };
+                const auto reference = [&](PNGImage &img)
+                {
+                    img.track_overdraw();
+                    img.draw_line(a, b, green);
+                };
+                if (!matches_reference(rng, 50, 40, kernel, reference))
+                {
+                    cout << "line " << i << " from " << a.x << "," << a.y << " to " << b.x << "," << b.y
+                         << " differs from the plotted loop" << endl;
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool check_path_numbers(const string &)
+        {
+            // path coordinates read as strtod reads them, in every form the
+            // path grammar allows, and nothing else
+            const char *const numbers[] = {"0.1", "0.7", "-.5", "+3.", "1e-3", "2.5E2", "123456.789", "1e+2"};
+            string d = "M";
+            for (const char *number : numbers)
+            {
+                d += string(" ") + number;
+            }
+            const shared_ptr<const PathGeometry> path = PathGeometry::parse(d.c_str());
+            const vector<PathPoint> &points = path->flatten(1)->points;
+            if (points.size() != 4)
+            {
+                cout << "read " << points.size() << " points" << endl;
+                return false;
+            }
+            for (size_t i = 0; i < 4; i++)
+            {
+                if (points[i].x != strtod(numbers[2 * i], nullptr) || points[i].y != strtod(numbers[2 * i + 1], nullptr))
+                {
+                    cout << "point " << i << " is " << points[i].x << ' ' << points[i].y << endl;
+                    return false;
+                }
+            }
+            // numbers may follow each other without separators
+            if (PathGeometry::parse("M.5.5-1-1")->flatten(1)->points.size() != 2)
+            {
+                cout << "adjacent numbers were not split" << endl;
+                return false;
+            }
+            // paths stop at the first error, before these segments
+            const char *const invalid[] = {"M 0 0 L 5 5 L inf 1", "M 0 0 L 5 5 L nan 1",
+                                           "M 0 0 L 5 5 L 0x10 1", "M 0 0 L 5 5 L . 1"};
+            for (const char *d : invalid)
+            {
+                if (PathGeometry::parse(d)->flatten(1)->points.size() != 2)
+                {
+                    cout << "read a number in " << d << endl;
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool check_pixel_formats(const string &root_path)
+        {
+            // scenes drawn into caller-owned memory, with padded rows, in
+            // every byte order
+            struct Layout
+            {
+                PixelFormat format;
+                int red, green, blue, x; //!< Byte offsets in a pixel.
+            };
+            const Layout layouts[] = {
+                {PixelFormat::RGBX, 0, 1, 2, 3},
+                {PixelFormat::BGRX, 2, 1, 0, 3},
+                {PixelFormat::XRGB, 1, 2, 3, 0},
+                {PixelFormat::XBGR, 3, 2, 1, 0},
+            };
+            const unsigned char padding = 0xA5;
+            for (const string &id : input_ids(root_path))
+            {
+                PNGImage expected(root_path + "/expected/" + id + ".png");
+                Scene scene(root_path + "/input/" + id + ".svg");
+                const int width = expected.width(), height = expected.height();
+                const int stride = 4 * width + 12;
+                for (const Layout &layout : layouts)
+                {
+                    vector<unsigned char> memory((size_t)stride * height, padding);
+                    {
+                        PNGImage img(memory.data(), width, height, stride, layout.format);
+                        img.fill({255, 255, 255});
+                        scene.render(img);
+                    }
+                    for (int y = 0; y < height; y++)
+                    {
+                        const unsigned char *row = &memory[(size_t)y * stride];
+                        for (int x = 0; x < width; x++)
+                        {
+                            const unsigned char *p = row + 4 * x;
+                            const Color c = expected.at(x, y);
+                            if (p[layout.red] != c.red || p[layout.green] != c.green ||
+                                p[layout.blue] != c.blue || p[layout.x] != 0xFF)
+                            {
+                                cout << id << " in format " << (int)layout.format
+                                     << " differs at " << x << ' ' << y << endl;
+                                return false;
+                            }
+                        }
+                        for (int i = 4 * width; i < stride; i++)
+                        {
+                            if (row[i] != padding)
+                            {
+                                cout << id << " in format " << (int)layout.format
+                                     << " wrote padding of row " << y << endl;
+                                return false;
+                            }
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+
+        bool check_spatial_index(const string &root_path)
+        {
+            // index answers match what each shape draws on its own
+            struct Coverage
+            {
+                BoundingBox area;   //!< Pixels drawn over.
+                vector<bool> drawn; //!< Which pixels of area the shape wrote.
+
+                bool at(int x, int y) const
+                {
+                    return x >= area.min.x && x <= area.max.x && y >= area.min.y && y <= area.max.y &&
+                           drawn[(size_t)(y - area.min.y) * (area.max.x - area.min.x + 1) + (x - area.min.x)];
+                }
+            };
+            // the inputs, and shapes far outside pixel coordinates, whose
+            // boxes are clamped
+            vector<string> files;
+            for (const string &id : input_ids(root_path))
+            {
+                files.push_back(root_path + "/input/" + id + ".svg");
+            }
+            const string off_canvas = write_svg(root_path, "check_spatial_index", OFF_CANVAS_SVG);
+            files.push_back(off_canvas);
+            const int margin = 2;
+            for (const string &file : files)
+            {
+                Scene scene(file);
+                const SpatialIndex &index = scene.index();
+                const int width = scene.dimensions().x, height = scene.dimensions().y;
+                // each shape is drawn over its box and a margin, which it
+                // must leave untouched; off-canvas shapes are drawn over the
+                // whole canvas, as their boxes are the ones in doubt
+                vector<Coverage> shapes(index.size());
+                for (size_t i = 0; i < index.size(); i++)
+                {
+                    const BoundingBox &box = index.box(i);
+                    Coverage &c = shapes[i];
+                    c.area = {{max(box.min.x - margin, 0), max(box.min.y - margin, 0)},
+                              {min(box.max.x + margin, width - 1), min(box.max.y + margin, height - 1)}};
+                    if (file == off_canvas)
+                    {
+                        c.area = {{0, 0}, {width - 1, height - 1}};
+                    }
+                    if (c.area.min.x > c.area.max.x || c.area.min.y > c.area.max.y)
+                    {
+                        c.area = {{0, 0}, {-1, -1}};
+                        continue;
+                    }
+                    const int w = c.area.max.x - c.area.min.x + 1, h = c.area.max.y - c.area.min.y + 1;
+                    PNGImage img(w, h);
+                    img.set_left(c.area.min.x);
+                    img.set_top(c.area.min.y);
+                    img.track_overdraw();
+                    index.shape(i)->render(img);
+                    c.drawn.resize((size_t)w * h);
+                    for (int y = 0; y < h; y++)
+                    {
+                        for (int x = 0; x < w; x++)
+                        {
+                            const int cx = c.area.min.x + x, cy = c.area.min.y + y;
+                            c.drawn[(size_t)y * w + x] = img.overdraw(x, y) > 0;
+                            if (c.drawn[(size_t)y * w + x] &&
+                                (cx < box.min.x || cx > box.max.x || cy < box.min.y || cy > box.max.y))
+                            {
+                                cout << file << ": shape " << i << " draws outside its box at "
+                                     << cx << ' ' << cy << endl;
+                                return false;
+                            }
+                        }
+                    }
+                }
+                // regions of 9x9 pixels, and their top-left pixel
+                const int cell = 9;
+                for (int top = 0; top < height; top += cell)
+                {
+                    for (int left = 0; left < width; left += cell)
+                    {
+                        const BoundingBox region = {{left, top},
+                                                    {min(left + cell, width) - 1, min(top + cell, height) - 1}};
+                        vector<const SVGElement *> in_region, at_pixel;
+                        for (size_t i = 0; i < index.size(); i++)
+                        {
+                            const BoundingBox &area = shapes[i].area;
+                            bool hit = false;
+                            for (int y = max(region.min.y, area.min.y); y <= min(region.max.y, area.max.y) && !hit; y++)
+                            {
+                                for (int x = max(region.min.x, area.min.x); x <= min(region.max.x, area.max.x) && !hit; x++)
+                                {
+                                    hit = shapes[i].at(x, y);
+                                }
+                            }
+                            if (hit)
+                            {
+                                in_region.push_back(index.shape(i));
+                            }
+                            if (shapes[i].at(left, top))
+                            {
+                                at_pixel.push_back(index.shape(i));
+                            }
+                        }
+                        const Point p = {left, top};
+                        const SVGElement *top_shape = at_pixel.empty() ? nullptr : at_pixel.back();
+                        if (index.intersecting(region) != in_region || index.at(p) != at_pixel ||
+                            index.top_at(p) != top_shape)
+                        {
+                            cout << file << ": index differs from the shapes' pixels at "
+                                 << left << ' ' << top << endl;
+                            return false;
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+
+        bool check_rect_fill(const string &)
+        {
+            // rectangles, given by any two opposite corners, cover the pixels
+            // of the polygon through their four corners and write each once
+            minstd_rand rng(42);
+            const Color blue = {0, 0, 255};
+            for (int i = 0; i < 3000; i++)
+            {
+                const Point a = {(int)(rng() % 120) - 30, (int)(rng() % 120) - 30};
+                Point b = {(int)(rng() % 120) - 30, (int)(rng() % 120) - 30};
+                switch (rng() % 4)
+                {
+                case 0:
+                    b.x = a.x;
+                    break;
+                case 1:
+                    b.y = a.y;
+                    break;
+                default:
+                    break;
+                }
+                // the kernel also checks that each pixel is written and
+                // counted once, while overdraw is tracked
+                bool once = true;
+                const auto kernel = [&](PNGImage &img)
+                {
+                    img.track_overdraw();
+                    img.draw_rect(a, b, blue);
+                    unsigned long long covered = 0;
+                    for (int y = 0; y < img.height(); y++)
+                    {
+                        for (int x = 0; x < img.width(); x++)
+                        {
+                            once = once && img.overdraw(x, y) <= 1;
+                            covered += img.overdraw(x, y);
+                        }
+                    }
+                    once = once && img.pixels_written() == covered;
+                };
+                const auto reference = [&](PNGImage &img)
+                { img.draw_polygon({a, {b.x, a.y}, b, {a.x, b.y}}, blue); };
+                if (!matches_reference(rng, 60, 60, kernel, reference, false))
+                {
+                    cout << "rectangle " << i << " differs from its polygon" << endl;
+                    return false;
+                }
+                if (!once)
+                {
+                    cout << "rectangle " << i << " did not write each pixel once" << endl;
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool check_render_region(const string &root_path)
+        {
+            // windows drawn from the index hold the pixels of the full
+            // render, including shapes far outside pixel coordinates
+            vector<string> files;
+            for (const string &id : input_ids(root_path))
+            {
+                files.push_back(root_path + "/input/" + id + ".svg");
+            }
+            files.push_back(write_svg(root_path, "check_render_region", OFF_CANVAS_SVG));
+            const int w = 61, h = 47;
+            for (const string &file : files)
+            {
+                Scene scene(file);
+                for (int top = -h / 2; top < scene.dimensions().y; top += h)
+                {
+                    for (int left = -w / 2; left < scene.dimensions().x; left += w)
+                    {
+                        PNGImage expected(w, h), got(w, h);
+                        expected.set_left(left);
+                        expected.set_top(top);
+                        scene.render(expected);
+                        scene.render_region(got, left, top);
+                        if (!same_image(expected, got))
+                        {
+                            cout << file << ": region at " << left << ' ' << top << " differs" << endl;
+                            return false;
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+
+        bool check_snapped_edges(const string &root_path)
+        {
+            // Expected images of fixtures with fractional geometry changed
+            // when shapes stopped snapping to whole pixels before drawing,
+            // and the images they replaced are kept. Snapping moves an edge
+            // by at most a pixel (half for a vertex, or for an ellipse's
+            // center plus half for its radius). So a render may differ from
+            // the snapped image only within two pixels of a shape's outline,
+            // and each outline pixel accounts for at most one changed pixel.
+            const char *const ids[] = {
+                "gradient_1", "group_4", "group_5", "group_7", "path_1", "rotate_circle",
+                "rotate_circle_with_origin", "rotate_ellipse", "rotate_line", "rotate_line_with_origin",
+                "rotate_polygon", "rotate_polygon_with_origin", "rotate_polyline", "rotate_rect",
+                "rotate_rect_with_origin", "subpixel_1", "viewbox_1"};
+            for (const string id : ids)
+            {
+                const string svg_file = root_path + "/input/" + id + ".svg";
+                const string out_file = root_path + "/output/check_snapped_edges.png";
+                convert(svg_file, out_file, ConvertOptions());
+                const PNGImage rendered(out_file);
+                const PNGImage snapped(root_path + "/expected/pixel_snapped/" + id + ".png");
+                const int width = rendered.width(), height = rendered.height();
+                if (snapped.width() != width || snapped.height() != height)
+                {
+                    cout << id << " changed size" << endl;
+                    return false;
+                }
+                // outline pixels: drawn by a shape, next to one it leaves
+                Scene scene(svg_file);
+                const SpatialIndex &index = scene.index();
+                vector<bool> outline((size_t)width * height);
+                for (size_t i = 0; i < index.size(); i++)
+                {
+                    const BoundingBox &box = index.box(i);
+                    const int w = box.max.x - box.min.x + 3, h = box.max.y - box.min.y + 3;
+                    if (w < 3 || h < 3)
+                    {
+                        continue;
+                    }
+                    PNGImage img(w, h);
+                    img.set_left(box.min.x - 1);
+                    img.set_top(box.min.y - 1);
+                    img.track_overdraw();
+                    index.shape(i)->render(img);
+                    for (int y = 1; y < h - 1; y++)
+                    {
+                        for (int x = 1; x < w - 1; x++)
+                        {
+                            const int cx = box.min.x - 1 + x, cy = box.min.y - 1 + y;
+                            if (img.overdraw(x, y) > 0 && cx >= 0 && cx < width && cy >= 0 && cy < height &&
+                                (img.overdraw(x - 1, y) == 0 || img.overdraw(x + 1, y) == 0 ||
+                                 img.overdraw(x, y - 1) == 0 || img.overdraw(x, y + 1) == 0))
+                            {
+                                outline[(size_t)cy * width + cx] = true;
+                            }
+                        }
+                    }
+                }
+                const long bound = (long)count(outline.begin(), outline.end(), true);
+                long changed = 0;
+                for (int y = 0; y < height; y++)
+                {
+                    for (int x = 0; x < width; x++)
+                    {
+                        const Color a = snapped.at(x, y), b = rendered.at(x, y);
+                        if (a.red == b.red && a.green == b.green && a.blue == b.blue)
+                        {
+                            continue;
+                        }
+                        changed++;
+                        bool near = false;
+                        for (int ny = max(y - 2, 0); ny <= min(y + 2, height - 1) && !near; ny++)
+                        {
+                            for (int nx = max(x - 2, 0); nx <= min(x + 2, width - 1) && !near; nx++)
+                            {
+                                near = outline[(size_t)ny * width + nx];
+                            }
+                        }
+                        if (!near)
+                        {
+                            cout << id << " changed away from an outline at " << x << ' ' << y << endl;
+                            return false;
+                        }
+                    }
+                }
+                if (changed > bound)
+                {
+                    cout << id << " changed " << changed << " pixels, more than its " << bound
+                         << " outline pixels" << endl;
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        //! A named check.
+        struct Check
+        {
+            const char *id;                       //!< Test name.
+            bool (*run)(const string &root_path); //!< The check.
+        };
+
+        //! Every check, run after the conversion tests whose names match.
+        const Check CHECKS[] = {
+            {"check_convex_polygons", check_convex_polygons},
+            {"check_ellipse_counts", check_ellipse_counts},
+            {"check_limit_canvas", check_limit_canvas},
+            {"check_limit_depth", check_limit_depth},
+            {"check_limit_elements", check_limit_elements},
+            {"check_limit_empty_canvas", check_limit_empty_canvas},
+            {"check_limit_uses", check_limit_uses},
+            {"check_limit_vertices", check_limit_vertices},
+            {"check_line_kernels", check_line_kernels},
+            {"check_path_numbers", check_path_numbers},
+            {"check_pixel_formats", check_pixel_formats},
+            {"check_rect_fill", check_rect_fill},
+            {"check_render_region", check_render_region},
+            {"check_snapped_edges", check_snapped_edges},
+            {"check_spatial_index", check_spatial_index},
+            {"check_strips", check_strips},
+            {"check_subpixel_kernels", check_subpixel_kernels},
+            {"check_tiles", check_tiles},
+        };
+    }
+
+    class TestDriver
+    {
+    private:
+        string root_path;
+        int total_tests = 0;
+        int passed_tests = 0;
+        int failed_tests = 0;
+        FILE *log_stream;
+
+        bool run_conversion_test(const string &id)
+        {
+            string svg_file = root_path + "/input/" + id + ".svg";
+            string exp_file = root_path + "/expected/" + id + ".png";
+            string out_file = root_path + "/output/" + id + ".png";
+            convert(svg_file, out_file);
+            return same_pixels(exp_file, out_file);
+        }
+
         void onTestBegin(const string &id)
         {
             total_tests++;
@@ -88,7 +1040,7 @@ namespace svg
             }
         }
 
-        void run_test(const string& id)
+        void run_test(const string& id, const function<bool()> &test)
         {
             int log_fd = ::fileno(log_stream);
             onTestBegin(id);
@@ -99,7 +1051,7 @@ namespace svg
             
                 ::dup2(log_fd, 1);
                 ::dup2(log_fd, 2);
-                bool success = run_conversion_test(id);
+                bool success = test();
                 ::exit(success ? 0 : 1);
             }
             else if (pid > 0)
@@ -129,38 +1081,38 @@ namespace svg
 
         void run_tests(const string &spec)
         {
-            string dir_path = root_path + "/input";
-            ::DIR *directory = ::opendir(dir_path.c_str());
-            if (directory == nullptr)
+            vector<string> scripts_to_execute;
+            for (const string &id : input_ids(root_path))
             {
-                cerr << "Unable to open input directory " << dir_path << endl;
-                return;
+                if (id.find(spec) == 0)
+                {
+                    scripts_to_execute.push_back(id);
+                }
             }
-            vector<string> scripts_to_execute;
-            ::dirent *entry;
-            while ((entry = readdir(directory)) != nullptr)
+            vector<const Check *> checks_to_execute;
+            for (const Check &check : CHECKS)
             {
-                if (entry->d_type == DT_REG)
+                if (string(check.id).find(spec) == 0)
                 {
-                    string fname = entry->d_name;
-                    if (fname.find(spec) == 0)
-                    {
-                        scripts_to_execute.push_back(fname.substr(0, fname.find_last_of('.')));
-                    }
+                    checks_to_execute.push_back(&check);
                 }
             }
-            ::closedir(directory);
-            if (scripts_to_execute.empty())
+            if (scripts_to_execute.empty() && checks_to_execute.empty())
             {
                 cout << "No scripts matched the spec: " << spec << endl;
                 return;
             }
-            sort(scripts_to_execute.begin(), scripts_to_execute.end());
 
-            cout << "== " << scripts_to_execute.size() << " tests to execute  ==" << endl;
+            cout << "== " << scripts_to_execute.size() + checks_to_execute.size() << " tests to execute  ==" << endl;
             for (string id : scripts_to_execute)
             {
-                run_test(id);
+                run_test(id, [&]
+                         { return run_conversion_test(id); });
+            }
+            for (const Check *check : checks_to_execute)
+            {
+                run_test(check->id, [&]
+                         { return check->run(root_path); });
             }
 
             cout << "== TEST EXECUTION SUMMARY ==" << endl
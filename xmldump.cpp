@@ -1,8 +1,12 @@
 #include "external/tinyxml2/tinyxml2.h"
+#include "SVGElements.hpp"
+#include "Stats.hpp"
 
 using namespace tinyxml2;
 
+#include <cstdlib>
 #include <iostream>
+#include <string>
 
 void dump(XMLElement *elem, int indentation)
 {
@@ -23,15 +27,92 @@ void dump(XMLElement *elem, int indentation)
 
 int main(int argc, char **argv)
 {
-    XMLDocument doc;
-    if (argc != 2)
+    bool cost = false;
+    bool json = false;
+    svg::ConvertOptions options;
+    std::string file;
+    bool usage_error = false;
+    for (int i = 1; i < argc; i++)
     {
-        std::cout << "Usage: xmldump filename";
+        std::string arg = argv[i];
+        if (arg == "--cost")
+        {
+            cost = true;
+        }
+        else if (arg == "--json")
+        {
+            json = true;
+        }
+        else if (arg == "--width" && i + 1 < argc)
+        {
+            options.width = std::atoi(argv[++i]);
+        }
+        else if (arg == "--height" && i + 1 < argc)
+        {
+            options.height = std::atoi(argv[++i]);
+        }
+        else if (arg == "--scale" && i + 1 < argc)
+        {
+            options.scale = std::atof(argv[++i]);
+        }
+        else if (arg == "--strip-height" && i + 1 < argc)
+        {
+            options.strip_height = std::atoi(argv[++i]);
+        }
+        else if (arg == "--untrusted")
+        {
+            options.limits = svg::ResourceLimits::untrusted();
+        }
+        else if (arg.compare(0, 2, "--") != 0 && file.empty())
+        {
+            file = arg;
+        }
+        else
+        {
+            usage_error = true;
+        }
+    }
+    if (usage_error || file.empty())
+    {
+        std::cout << "Usage: xmldump [options] filename" << std::endl
+                  << "  --cost                  predict the cost of converting the file, without drawing" << std::endl
+                  << "  --json                  print the prediction as JSON" << std::endl
+                  << "  --width W, --height H   output size, as for svgtopng" << std::endl
+                  << "  --scale S               extra output scale factor" << std::endl
+                  << "  --strip-height N        predict memory for drawing N rows at a time" << std::endl
+                  << "  --untrusted             enforce the limits for untrusted input" << std::endl;
+        return 1;
+    }
+    else if (cost)
+    {
+        try
+        {
+            svg::CostEstimate estimate = svg::estimate_cost(file, options);
+            if (json)
+            {
+                estimate.write_json(std::cout);
+            }
+            else
+            {
+                estimate.print(std::cout);
+            }
+        }
+        catch (const svg::LimitExceeded &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 10 + (int)e.code();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 2;
+        }
     }
     else
     {
-        doc.LoadFile(argv[1]);
+        XMLDocument doc;
+        doc.LoadFile(file.c_str());
         dump(doc.RootElement(), 0);
     }
     return 0;
-}
\ No newline at end of file
+}